@@ -0,0 +1,175 @@
+// Builds BVHs over N random spheres for N = 10 .. 1M and reports build time
+// and closest-hit throughput for the serial and parallel SAH builders and the
+// LBVH builder, next to the SAH tree testing its leaves through virtual calls
+// instead of the packed shape store, the SAH tree answering the any-hit
+// occlusion query used for shadows, and a brute-force loop over every shape
+// for the sizes where that is still affordable.
+//
+//   bvhBench [rays per size] [build threads, 0 = all cores]
+
+#include "bvh.hpp"
+#include "shape.hpp"
+#include "world.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace liby;
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+double seconds(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// spheres keep a constant density, so a larger scene is a bigger volume of
+// the same stuff rather than the same volume filled more tightly
+std::vector<std::unique_ptr<raytracer::Shape>> makeSpheres(size_t count,
+                                                           std::mt19937 &rng) {
+  auto side = 4.0F * std::cbrt(static_cast<float>(count));
+  std::uniform_real_distribution<float> position(-side / 2.0F, side / 2.0F);
+  std::uniform_real_distribution<float> radius(0.2F, 0.6F);
+  std::vector<std::unique_ptr<raytracer::Shape>> shapes;
+  shapes.reserve(count);
+  for (size_t i = 0; i < count; i++) {
+    auto transform = math::Transform4D::makeTranslation(
+                         math::Vector3D(position(rng), position(rng),
+                                        position(rng))) *
+                     math::Transform4D::makeScale(radius(rng));
+    shapes.push_back(std::make_unique<raytracer::Sphere>(
+        raytracer::Material(),
+        std::make_unique<math::Transform4D>(transform),
+        std::make_unique<raytracer::SphereManager>()));
+  }
+  return shapes;
+}
+
+// rays start on a sphere around the scene and aim at random points inside it
+std::vector<math::Ray> makeRays(size_t count, const math::Bounds3D &bounds,
+                                std::mt19937 &rng) {
+  auto center = bounds.getCenter();
+  auto extent = bounds.getExtent();
+  auto radius = magnitude(extent);
+  std::normal_distribution<float> gaussian;
+  std::uniform_real_distribution<float> unit(-0.5F, 0.5F);
+  std::vector<math::Ray> rays;
+  rays.reserve(count);
+  for (size_t i = 0; i < count; i++) {
+    auto dir = normalize(math::Vector3D(gaussian(rng), gaussian(rng),
+                                        gaussian(rng)));
+    auto origin = center + dir * radius;
+    math::Point3D target(center.x() + unit(rng) * extent.x(),
+                         center.y() + unit(rng) * extent.y(),
+                         center.z() + unit(rng) * extent.z());
+    rays.emplace_back(origin, normalize(target - origin));
+  }
+  return rays;
+}
+
+struct Result {
+  double buildTime;
+  double rate;
+  size_t hits;
+  double occludedRate;
+  size_t occluded;
+};
+
+Result measure(const std::vector<const raytracer::Shape *> &shapes,
+               const raytracer::BVHSettings &settings,
+               const std::vector<math::Ray> &rays) {
+  auto start = Clock::now();
+  raytracer::BVH bvh(shapes, settings);
+  auto buildTime = seconds(start);
+
+  size_t hits = 0;
+  start = Clock::now();
+  for (const auto &ray : rays) {
+    raytracer::Intersection closest;
+    hits += bvh.closestHit(ray, 0.0F, INFINITY, &closest);
+  }
+  auto rate = static_cast<double>(rays.size()) / seconds(start) / 1e6;
+
+  size_t occluded = 0;
+  start = Clock::now();
+  for (const auto &ray : rays) {
+    occluded += bvh.occluded(ray, 0.0F, INFINITY);
+  }
+  return {buildTime, rate, hits,
+          static_cast<double>(rays.size()) / seconds(start) / 1e6, occluded};
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  size_t rayCount = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+  unsigned int threads =
+      argc > 2 ? static_cast<unsigned int>(std::strtoul(argv[2], nullptr, 10))
+               : 0;
+  std::mt19937 rng(1234);
+
+  std::printf("%9s | %9s %9s %9s | %8s %8s %8s %8s %8s | %8s\n", "spheres",
+              "SAH 1T", "SAH MT", "LBVH MT", "SAH", "any-hit", "virtual",
+              "LBVH", "brute", "hit rate");
+  std::printf("%9s | %29s | %44s |\n", "", "build ms", "Mray/s");
+  for (size_t count = 10; count <= 1000000; count *= 10) {
+    auto shapes = makeSpheres(count, rng);
+    std::vector<const raytracer::Shape *> pointers;
+    pointers.reserve(count);
+    for (const auto &shape : shapes) {
+      pointers.push_back(shape.get());
+    }
+    raytracer::BVH reference(pointers);
+    auto rays = makeRays(rayCount, reference.bounds(), rng);
+
+    raytracer::BVHSettings serial;
+    serial.threads = 1;
+    raytracer::BVHSettings parallel;
+    parallel.threads = threads;
+    raytracer::BVHSettings linear = parallel;
+    linear.method = raytracer::BVHBuildMethod::LBVH;
+    raytracer::BVHSettings unpacked = parallel;
+    unpacked.storage = raytracer::ShapeStorage::Virtual;
+
+    auto sahSerial = measure(pointers, serial, rays);
+    auto sah = measure(pointers, parallel, rays);
+    auto lbvh = measure(pointers, linear, rays);
+    auto virt = measure(pointers, unpacked, rays);
+    // grazing hits that land a rounding error outside a sphere's box can be
+    // found or missed depending on how loose the enclosing node is
+    auto tolerance = rays.size() / 1000;
+    if (sah.hits != sahSerial.hits || virt.hits != sah.hits ||
+        sah.occluded != sah.hits ||
+        std::max(sah.hits, lbvh.hits) - std::min(sah.hits, lbvh.hits) >
+            tolerance) {
+      std::fprintf(stderr, "builders disagree on %zu spheres\n", count);
+      return 1;
+    }
+
+    // brute force is quadratic in spirit; keep it to sizes that finish
+    auto bruteRate = NAN;
+    if (count <= 10000) {
+      auto bruteRays = std::min(rays.size(), 1000000 / count + 1);
+      auto start = Clock::now();
+      for (size_t r = 0; r < bruteRays; r++) {
+        auto tMax = INFINITY;
+        for (auto shape : pointers) {
+          shape->closestHit(rays[r], 0.0F, tMax, &tMax);
+        }
+      }
+      bruteRate = static_cast<double>(bruteRays) / seconds(start) / 1e6;
+    }
+
+    std::printf("%9zu | %9.2f %9.2f %9.2f | %8.3f %8.3f %8.3f %8.3f %8.3f | "
+                "%7.1f%%\n",
+                count, sahSerial.buildTime * 1e3, sah.buildTime * 1e3,
+                lbvh.buildTime * 1e3, sah.rate, sah.occludedRate, virt.rate,
+                lbvh.rate, bruteRate,
+                100.0 * static_cast<double>(sah.hits) / rays.size());
+  }
+  return 0;
+}
@@ -0,0 +1,120 @@
+// Renders a few spheres on a plane lit by a grid of dim lights, with one
+// light drawn per hit so that a few samples per pixel leave the image
+// noisy, then denoises it with the albedo, normal and depth of the first
+// hits as guides. Reports the time of each step and how far the noisy and
+// denoised images are from one with every light shaded.
+//
+//   denoiseBench [width] [samples] [iterations]
+
+#include "denoise.hpp"
+#include "progressive.hpp"
+#include "render.hpp"
+#include "shape.hpp"
+#include "world.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+
+using namespace liby;
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+double seconds(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void buildScene(raytracer::World &world, int lights) {
+  std::mt19937 rng(1234);
+  std::uniform_real_distribution<float> position(-8.0F, 8.0F);
+  std::uniform_real_distribution<float> unit(0.0F, 1.0F);
+  world.addShape(std::make_unique<raytracer::Plane>());
+  for (int i = 0; i < 12; i++) {
+    auto transform = math::Transform4D::makeTranslation(
+        math::Vector3D(position(rng), 1.0F, position(rng)));
+    raytracer::Material material(
+        0.1F, 0.9F, 0.9F, 200.0F, 0.0F, 0.0F, 1.0F,
+        math::RGBA(unit(rng), unit(rng), unit(rng)), nullptr);
+    world.addShape(std::make_unique<raytracer::Sphere>(
+        std::move(material), std::make_unique<math::Transform4D>(transform),
+        std::make_unique<raytracer::SphereManager>()));
+  }
+
+  // a square grid of lights over a 60-unit ceiling, together about as
+  // bright as one white light
+  auto side = static_cast<int>(std::ceil(std::sqrt(lights)));
+  auto intensity = 1.0F / static_cast<float>(lights);
+  for (int i = 0; i < lights; i++) {
+    auto x = (static_cast<float>(i % side) + 0.5F) / side * 60.0F - 30.0F;
+    auto z = (static_cast<float>(i / side) + 0.5F) / side * 60.0F - 30.0F;
+    world.addLight(raytracer::PointLight(
+        math::Point3D(x, 12.0F, z),
+        math::RGBA(intensity * (0.5F + unit(rng)), intensity,
+                   intensity * (0.5F + unit(rng)))));
+  }
+}
+
+// mean over pixels and channels of the absolute difference
+double meanError(const raytracer::Canvas &a, const raytracer::Canvas &b) {
+  double error = 0.0;
+  for (int y = 0; y < a.getHeight(); y++) {
+    for (int x = 0; x < a.getWidth(); x++) {
+      auto p = a.pixelAt(x, y);
+      auto q = b.pixelAt(x, y);
+      error += std::fabs(p.r() - q.r()) + std::fabs(p.g() - q.g()) +
+               std::fabs(p.b() - q.b());
+    }
+  }
+  return error / (3.0 * a.getWidth() * a.getHeight());
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  int width = argc > 1 ? std::atoi(argv[1]) : 320;
+  int samples = argc > 2 ? std::atoi(argv[2]) : 2;
+  int iterations = argc > 3 ? std::atoi(argv[3]) : 5;
+
+  raytracer::World world;
+  buildScene(world, 64);
+  raytracer::Camera camera(
+      width, width / 2, 1.0472F,
+      raytracer::Camera::viewTransform(math::Point3D(0.0F, 5.0F, -16.0F),
+                                       math::Point3D(0.0F, 0.0F, 0.0F),
+                                       math::Vector3D(0.0F, 1.0F, 0.0F)));
+  world.getBVH();
+  auto reference = raytracer::render(camera, world);
+
+  raytracer::LightSettings lights;
+  lights.mode = raytracer::LightSampling::Sampled;
+  lights.samples = 1;
+  world.setLightSettings(lights);
+  raytracer::ProgressiveSettings settings;
+  settings.maxSamples = samples;
+  raytracer::ProgressiveRender progressive(camera, world, settings);
+  auto start = Clock::now();
+  progressive.start();
+  progressive.wait();
+  auto renderTime = seconds(start);
+  auto noisy = progressive.preview();
+
+  start = Clock::now();
+  auto features = raytracer::renderFeatures(camera, world);
+  auto featureTime = seconds(start);
+
+  raytracer::DenoiseSettings denoise;
+  denoise.iterations = iterations;
+  start = Clock::now();
+  auto denoised = raytracer::denoise(noisy, features, denoise);
+  auto denoiseTime = seconds(start);
+
+  std::printf("%dx%d, %d samples per pixel\n", width, width / 2, samples);
+  std::printf("render    %8.1f ms  (mean error %.4f)\n", renderTime * 1e3,
+              meanError(reference, noisy));
+  std::printf("features  %8.1f ms\n", featureTime * 1e3);
+  std::printf("denoise   %8.1f ms  (mean error %.4f)\n", denoiseTime * 1e3,
+              meanError(reference, denoised));
+  return 0;
+}
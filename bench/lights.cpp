@@ -0,0 +1,118 @@
+// Renders a few spheres on a plane lit by a grid of dim lights hung over
+// it, once shading every light, once sampling a few lights per hit from the
+// light tree and once with distant lights clustered, and reports the time
+// of each and how far the approximate images are from the exact one.
+//
+//   lightBench [width] [lights] [samples]
+
+#include "render.hpp"
+#include "shape.hpp"
+#include "world.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+
+using namespace liby;
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+double seconds(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void buildScene(raytracer::World &world, int lights) {
+  std::mt19937 rng(1234);
+  std::uniform_real_distribution<float> position(-8.0F, 8.0F);
+  std::uniform_real_distribution<float> unit(0.0F, 1.0F);
+  world.addShape(std::make_unique<raytracer::Plane>());
+  for (int i = 0; i < 12; i++) {
+    auto transform = math::Transform4D::makeTranslation(
+        math::Vector3D(position(rng), 1.0F, position(rng)));
+    raytracer::Material material(
+        0.1F, 0.9F, 0.9F, 200.0F, 0.0F, 0.0F, 1.0F,
+        math::RGBA(unit(rng), unit(rng), unit(rng)), nullptr);
+    world.addShape(std::make_unique<raytracer::Sphere>(
+        std::move(material), std::make_unique<math::Transform4D>(transform),
+        std::make_unique<raytracer::SphereManager>()));
+  }
+
+  // a square grid of lights over a 60-unit ceiling, together about as
+  // bright as one white light
+  auto side = static_cast<int>(std::ceil(std::sqrt(lights)));
+  auto intensity = 1.0F / static_cast<float>(lights);
+  for (int i = 0; i < lights; i++) {
+    auto x = (static_cast<float>(i % side) + 0.5F) / side * 60.0F - 30.0F;
+    auto z = (static_cast<float>(i / side) + 0.5F) / side * 60.0F - 30.0F;
+    world.addLight(raytracer::PointLight(
+        math::Point3D(x, 12.0F, z),
+        math::RGBA(intensity * (0.5F + unit(rng)), intensity,
+                   intensity * (0.5F + unit(rng)))));
+  }
+}
+
+// mean over pixels and channels of the absolute difference
+double meanError(const raytracer::Canvas &a, const raytracer::Canvas &b) {
+  double error = 0.0;
+  for (int y = 0; y < a.getHeight(); y++) {
+    for (int x = 0; x < a.getWidth(); x++) {
+      auto p = a.pixelAt(x, y);
+      auto q = b.pixelAt(x, y);
+      error += std::fabs(p.r() - q.r()) + std::fabs(p.g() - q.g()) +
+               std::fabs(p.b() - q.b());
+    }
+  }
+  return error / (3.0 * a.getWidth() * a.getHeight());
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  int width = argc > 1 ? std::atoi(argv[1]) : 320;
+  int lights = argc > 2 ? std::atoi(argv[2]) : 1024;
+  int samples = argc > 3 ? std::atoi(argv[3]) : 4;
+
+  raytracer::World world;
+  buildScene(world, lights);
+  raytracer::Camera camera(
+      width, width / 2, 1.0472F,
+      raytracer::Camera::viewTransform(math::Point3D(0.0F, 5.0F, -16.0F),
+                                       math::Point3D(0.0F, 0.0F, 0.0F),
+                                       math::Vector3D(0.0F, 1.0F, 0.0F)));
+  world.getBVH();
+
+  auto start = Clock::now();
+  world.getLightTree();
+  auto buildTime = seconds(start);
+
+  start = Clock::now();
+  auto all = raytracer::render(camera, world);
+  auto allTime = seconds(start);
+
+  raytracer::LightSettings settings;
+  settings.mode = raytracer::LightSampling::Sampled;
+  settings.samples = samples;
+  world.setLightSettings(settings);
+  start = Clock::now();
+  auto sampled = raytracer::render(camera, world);
+  auto sampledTime = seconds(start);
+
+  settings.mode = raytracer::LightSampling::Clustered;
+  world.setLightSettings(settings);
+  start = Clock::now();
+  auto clustered = raytracer::render(camera, world);
+  auto clusteredTime = seconds(start);
+
+  std::printf("%dx%d, %d lights, tree built in %.2f ms\n", width, width / 2,
+              lights, buildTime * 1e3);
+  std::printf("all lights  %8.1f ms\n", allTime * 1e3);
+  std::printf("sampled     %8.1f ms  (%.2fx, mean error %.4f)\n",
+              sampledTime * 1e3, allTime / sampledTime,
+              meanError(all, sampled));
+  std::printf("clustered   %8.1f ms  (%.2fx, mean error %.4f)\n",
+              clusteredTime * 1e3, allTime / clusteredTime,
+              meanError(all, clustered));
+  return 0;
+}
@@ -0,0 +1,151 @@
+// Builds a unit sphere as a subdivided icosahedron and times closest-hit
+// queries against it with the leaf triangles tested one at a time and in
+// SIMD blocks. Also fires rays from inside the mesh at every vertex and
+// edge midpoint, where a test that is not watertight lets rays slip
+// between triangles, and counts the ones that escape.
+//
+//   meshBench [subdivisions] [rays]
+
+#include "triangleMesh.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+
+using namespace liby;
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+double seconds(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+math::Point3D onSphere(float x, float y, float z) {
+  auto n = normalize(math::Vector3D(x, y, z));
+  return math::Point3D(n.x(), n.y(), n.z());
+}
+
+math::Point3D midpoint(const math::Point3D &a, const math::Point3D &b) {
+  return math::Point3D(0.5F * (a.x() + b.x()), 0.5F * (a.y() + b.y()),
+                       0.5F * (a.z() + b.z()));
+}
+
+// each subdivision splits every triangle in four, the new corners shared
+// between the two triangles along each edge and pushed out to the sphere
+void buildSphere(int subdivisions, std::vector<math::Point3D> &vertices,
+                 std::vector<uint32_t> &indices) {
+  auto t = (1.0F + std::sqrt(5.0F)) / 2.0F;
+  const float corners[12][3] = {
+      {-1, t, 0}, {1, t, 0}, {-1, -t, 0}, {1, -t, 0},
+      {0, -1, t}, {0, 1, t}, {0, -1, -t}, {0, 1, -t},
+      {t, 0, -1}, {t, 0, 1}, {-t, 0, -1}, {-t, 0, 1}};
+  vertices.clear();
+  for (const auto &c : corners) {
+    vertices.push_back(onSphere(c[0], c[1], c[2]));
+  }
+  indices = {0, 11, 5, 0, 5,  1,  0,  1, 7, 0, 7,  10, 0, 10, 11,
+             1, 5,  9, 5, 11, 4,  11, 10, 2, 10, 7, 6,  7, 1,  8,
+             3, 9,  4, 3, 4,  2,  3,  2, 6, 3, 6,  8,  3, 8,  9,
+             4, 9,  5, 2, 4,  11, 6,  2, 10, 8, 6, 7,  9, 8,  1};
+  for (int s = 0; s < subdivisions; s++) {
+    std::map<std::pair<uint32_t, uint32_t>, uint32_t> middles;
+    auto middle = [&](uint32_t a, uint32_t b) {
+      auto key = std::make_pair(std::min(a, b), std::max(a, b));
+      auto found = middles.find(key);
+      if (found != middles.end()) {
+        return found->second;
+      }
+      auto m = midpoint(vertices[a], vertices[b]);
+      vertices.push_back(onSphere(m.x(), m.y(), m.z()));
+      auto index = static_cast<uint32_t>(vertices.size() - 1);
+      middles[key] = index;
+      return index;
+    };
+    std::vector<uint32_t> split;
+    for (size_t i = 0; i < indices.size(); i += 3) {
+      auto a = indices[i];
+      auto b = indices[i + 1];
+      auto c = indices[i + 2];
+      auto ab = middle(a, b);
+      auto bc = middle(b, c);
+      auto ca = middle(c, a);
+      split.insert(split.end(), {a, ab, ca, b, bc, ab, c, ca, bc, ab, bc, ca});
+    }
+    indices = std::move(split);
+  }
+}
+
+std::unique_ptr<raytracer::TriangleMesh>
+makeMesh(const std::vector<math::Point3D> &vertices,
+         const std::vector<uint32_t> &indices, bool simd) {
+  raytracer::MeshSettings settings;
+  settings.simd = simd;
+  return std::make_unique<raytracer::TriangleMesh>(
+      raytracer::Material(),
+      std::make_unique<math::Transform4D>(math::Matrix4D::identity()),
+      std::make_unique<raytracer::TriangleMeshManager>(), vertices, indices,
+      settings);
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  int subdivisions = argc > 1 ? std::atoi(argv[1]) : 6;
+  int rays = argc > 2 ? std::atoi(argv[2]) : 1000000;
+
+  std::vector<math::Point3D> vertices;
+  std::vector<uint32_t> indices;
+  buildSphere(subdivisions, vertices, indices);
+  std::printf("%zu triangles, %zu vertices, %d rays\n", indices.size() / 3,
+              vertices.size(), rays);
+
+  // camera-like rays from one side, most of them hitting the sphere
+  std::mt19937 rng(1234);
+  std::normal_distribution<float> spread(0.0F, 0.5F);
+  std::vector<math::Ray> queries;
+  queries.reserve(static_cast<size_t>(rays));
+  for (int i = 0; i < rays; i++) {
+    queries.emplace_back(math::Point3D(spread(rng), spread(rng), -5.0F),
+                         math::Vector3D(0.1F * spread(rng),
+                                        0.1F * spread(rng), 1.0F));
+  }
+
+  // aimed from near the center straight at the places two or more
+  // triangles meet
+  math::Point3D inside(0.01F, -0.02F, 0.03F);
+  std::vector<math::Point3D> targets(vertices);
+  for (size_t i = 0; i < indices.size(); i += 3) {
+    for (int e = 0; e < 3; e++) {
+      targets.push_back(midpoint(vertices[indices[i + e]],
+                                 vertices[indices[i + (e + 1) % 3]]));
+    }
+  }
+
+  for (auto simd : {false, true}) {
+    auto mesh = makeMesh(vertices, indices, simd);
+    auto start = Clock::now();
+    auto hits = 0;
+    for (const auto &ray : queries) {
+      float t;
+      hits += mesh->closestHit(ray, 0.0F, INFINITY, &t) ? 1 : 0;
+    }
+    auto elapsed = seconds(start);
+
+    auto escaped = 0;
+    for (const auto &target : targets) {
+      float t;
+      math::Ray ray(inside, target - inside);
+      escaped += mesh->closestHit(ray, 0.0F, INFINITY, &t) ? 0 : 1;
+    }
+    std::printf("%s  %8.1f ms  %6.1f Mrays/s  hits %d  escaped %d of %zu\n",
+                simd ? "simd  " : "scalar", elapsed * 1e3,
+                rays / elapsed * 1e-6, hits, escaped, targets.size());
+  }
+  return 0;
+}
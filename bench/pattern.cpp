@@ -0,0 +1,135 @@
+// Evaluates a nested pattern (checkers of stripes and rings, blended with a
+// gradient) at random points through the virtual Pattern::at(), through its
+// compiled PatternProgram one point at a time, and through the program in
+// SIMD batches, and reports the time of each along with whether the colors
+// match exactly. Then reads the same points from a baked copy, once while
+// it fills and once more, and reports the mean error of the bake.
+//
+//   patternBench [points]
+
+#include "patternBake.hpp"
+#include "patternProgram.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace liby;
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+double seconds(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+std::unique_ptr<raytracer::Pattern>
+colors(float r, float g, float b,
+       std::unique_ptr<raytracer::PatternManager> manager) {
+  return std::make_unique<raytracer::Pattern>(
+      math::RGBA(r, g, b), math::RGBA(b, r, g), std::move(manager));
+}
+
+std::unique_ptr<raytracer::Pattern> buildPattern(void) {
+  auto stripes =
+      colors(0.9F, 0.2F, 0.1F, std::make_unique<raytracer::StripeManager>());
+  stripes->setTransform(math::Transform4D::makeRotationY(0.6F) *
+                        math::Transform4D::makeScale(0.25F));
+  auto rings =
+      colors(0.1F, 0.8F, 0.3F, std::make_unique<raytracer::RingManager>());
+  rings->setTransform(math::Transform4D::makeScale(0.3F));
+  auto checkers = std::make_unique<raytracer::Pattern>(
+      std::move(stripes), std::move(rings),
+      std::make_unique<raytracer::CheckerManager>());
+  auto gradient =
+      colors(0.2F, 0.4F, 1.0F, std::make_unique<raytracer::GradientManager>());
+  gradient->setTransform(math::Transform4D::makeScale(4.0F));
+  return std::make_unique<raytracer::Pattern>(
+      std::move(checkers), std::move(gradient),
+      std::make_unique<raytracer::BlendManager>());
+}
+
+bool same(const math::RGBA &a, const math::RGBA &b) {
+  return std::memcmp(&a, &b, sizeof(a)) == 0;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+
+  auto pattern = buildPattern();
+  raytracer::PatternProgram program(*pattern);
+
+  std::mt19937 rng(1234);
+  std::uniform_real_distribution<float> coordinate(-10.0F, 10.0F);
+  std::vector<math::Point3D> points;
+  points.reserve(count);
+  for (size_t i = 0; i < count; i++) {
+    points.emplace_back(coordinate(rng), coordinate(rng), coordinate(rng));
+  }
+  std::vector<math::RGBA> virtualColors(count);
+  std::vector<math::RGBA> scalarColors(count);
+  std::vector<math::RGBA> batchColors(count);
+
+  auto start = Clock::now();
+  for (size_t i = 0; i < count; i++) {
+    virtualColors[i] = pattern->at(points[i]);
+  }
+  auto virtualTime = seconds(start);
+
+  start = Clock::now();
+  for (size_t i = 0; i < count; i++) {
+    scalarColors[i] = program.at(points[i]);
+  }
+  auto scalarTime = seconds(start);
+
+  start = Clock::now();
+  program.at(points.data(), count, batchColors.data());
+  auto batchTime = seconds(start);
+
+  std::printf("%zu points, %zu nodes\n", count, program.size());
+  std::printf("virtual   %8.1f ms\n", virtualTime * 1e3);
+  std::printf("compiled  %8.1f ms  (%.2fx)\n", scalarTime * 1e3,
+              virtualTime / scalarTime);
+  std::printf("batch     %8.1f ms  (%.2fx)\n", batchTime * 1e3,
+              virtualTime / batchTime);
+  for (size_t i = 0; i < count; i++) {
+    if (!same(virtualColors[i], scalarColors[i]) ||
+        !same(virtualColors[i], batchColors[i])) {
+      std::fprintf(stderr, "colors differ at point %zu\n", i);
+      return 1;
+    }
+  }
+
+  // coarse enough that the 20-unit cube the points span bakes in ~14 MB
+  raytracer::BakeSettings bake;
+  bake.resolution = 4.0F;
+  raytracer::BakedPattern baked(buildPattern(), bake);
+  std::vector<math::RGBA> bakedColors(count);
+  start = Clock::now();
+  for (size_t i = 0; i < count; i++) {
+    bakedColors[i] = baked.at(points[i]);
+  }
+  auto coldTime = seconds(start);
+  start = Clock::now();
+  for (size_t i = 0; i < count; i++) {
+    bakedColors[i] = baked.at(points[i]);
+  }
+  auto warmTime = seconds(start);
+  double error = 0.0;
+  for (size_t i = 0; i < count; i++) {
+    const auto &a = virtualColors[i];
+    const auto &b = bakedColors[i];
+    error += std::fabs(a.r() - b.r()) + std::fabs(a.g() - b.g()) +
+             std::fabs(a.b() - b.b());
+  }
+  std::printf("baking    %8.1f ms  (%zu bricks)\n", coldTime * 1e3,
+              baked.getCache().brickCount());
+  std::printf("baked     %8.1f ms  (%.2fx, mean error %.4f)\n",
+              warmTime * 1e3, virtualTime / warmTime, error / (3.0 * count));
+  return 0;
+}
@@ -0,0 +1,124 @@
+// Renders a field of spheres on a plane under one light, tracing camera and
+// shadow rays one at a time, then in SIMD packets, again with the tiles
+// taken row by row instead of along a Hilbert curve, then in packet waves,
+// and reports the time of each along with whether the images match.
+//
+//   renderBench [width] [spheres] [threads, 0 = all cores]
+
+#include "render.hpp"
+#include "shape.hpp"
+#include "world.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+
+using namespace liby;
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+double seconds(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void buildScene(raytracer::World &world, size_t count) {
+  std::mt19937 rng(1234);
+  std::uniform_real_distribution<float> position(-20.0F, 20.0F);
+  std::uniform_real_distribution<float> radius(0.2F, 0.8F);
+  std::uniform_real_distribution<float> unit(0.0F, 1.0F);
+  world.addShape(std::make_unique<raytracer::Plane>());
+  for (size_t i = 0; i < count; i++) {
+    auto r = radius(rng);
+    auto transform = math::Transform4D::makeTranslation(
+                         math::Vector3D(position(rng), r, position(rng))) *
+                     math::Transform4D::makeScale(r);
+    raytracer::Material material(
+        0.1F, 0.9F, 0.9F, 200.0F, 0.0F, 0.0F, 1.0F,
+        math::RGBA(unit(rng), unit(rng), unit(rng)), nullptr);
+    world.addShape(std::make_unique<raytracer::Sphere>(
+        std::move(material), std::make_unique<math::Transform4D>(transform),
+        std::make_unique<raytracer::SphereManager>()));
+  }
+  world.addLight(raytracer::PointLight(math::Point3D(-10.0F, 20.0F, -10.0F),
+                                       math::RGBA(1.0F, 1.0F, 1.0F)));
+}
+
+bool sameImage(const raytracer::Canvas &a, const raytracer::Canvas &b) {
+  for (int y = 0; y < a.getHeight(); y++) {
+    for (int x = 0; x < a.getWidth(); x++) {
+      auto p = a.pixelAt(x, y);
+      auto q = b.pixelAt(x, y);
+      if (p.r() != q.r() || p.g() != q.g() || p.b() != q.b()) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  int width = argc > 1 ? std::atoi(argv[1]) : 640;
+  size_t count = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 2000;
+  unsigned int threads =
+      argc > 3 ? static_cast<unsigned int>(std::strtoul(argv[3], nullptr, 10))
+               : 0;
+
+  raytracer::World world;
+  buildScene(world, count);
+  raytracer::Camera camera(
+      width, width / 2, 1.0472F,
+      raytracer::Camera::viewTransform(math::Point3D(0.0F, 6.0F, -28.0F),
+                                       math::Point3D(0.0F, 0.0F, 0.0F),
+                                       math::Vector3D(0.0F, 1.0F, 0.0F)));
+  world.getBVH();
+
+  raytracer::RenderSettings settings;
+  settings.threads = threads;
+  settings.packets = false;
+  auto start = Clock::now();
+  auto single = raytracer::render(camera, world, settings);
+  auto singleTime = seconds(start);
+
+  settings.packets = true;
+  start = Clock::now();
+  auto packets = raytracer::render(camera, world, settings);
+  auto packetTime = seconds(start);
+
+  settings.tileOrder = raytracer::TileOrder::Scanline;
+  start = Clock::now();
+  auto scanline = raytracer::render(camera, world, settings);
+  auto scanlineTime = seconds(start);
+  settings.tileOrder = raytracer::TileOrder::Hilbert;
+
+  settings.mode = raytracer::RenderMode::Wavefront;
+  start = Clock::now();
+  auto wavefront = raytracer::render(camera, world, settings);
+  auto wavefrontTime = seconds(start);
+
+  std::printf("%dx%d, %zu spheres\n", width, width / 2, count);
+  std::printf("single rays %8.1f ms\n", singleTime * 1e3);
+  std::printf("packets     %8.1f ms  (%.2fx)\n", packetTime * 1e3,
+              singleTime / packetTime);
+  std::printf("  scanline  %8.1f ms  (%.2fx)\n", scanlineTime * 1e3,
+              singleTime / scanlineTime);
+  std::printf("wavefront   %8.1f ms  (%.2fx)\n", wavefrontTime * 1e3,
+              singleTime / wavefrontTime);
+  if (!sameImage(single, packets)) {
+    std::fprintf(stderr, "packet image differs\n");
+    return 1;
+  }
+  if (!sameImage(packets, scanline)) {
+    std::fprintf(stderr, "scanline image differs\n");
+    return 1;
+  }
+  // nothing in the scene reflects, so summing bounces in a different order
+  // cannot show up here
+  if (!sameImage(single, wavefront)) {
+    std::fprintf(stderr, "wavefront image differs\n");
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,139 @@
+#include "bounds3D.hpp"
+#include <algorithm>
+
+namespace liby {
+namespace math {
+Bounds3D::Bounds3D() {
+  for (int i = 0; i < 3; i++) {
+    lo[i] = INFINITY;
+    hi[i] = -INFINITY;
+  }
+}
+
+Bounds3D::Bounds3D(const Point3D &lo, const Point3D &hi) {
+  for (int i = 0; i < 3; i++) {
+    this->lo[i] = std::min(lo[i], hi[i]);
+    this->hi[i] = std::max(lo[i], hi[i]);
+  }
+}
+
+Point3D Bounds3D::getMin(void) const { return Point3D(lo[0], lo[1], lo[2]); }
+Point3D Bounds3D::getMax(void) const { return Point3D(hi[0], hi[1], hi[2]); }
+
+Point3D Bounds3D::getCenter(void) const {
+  return Point3D(0.5F * (lo[0] + hi[0]), 0.5F * (lo[1] + hi[1]),
+                 0.5F * (lo[2] + hi[2]));
+}
+
+Vector3D Bounds3D::getExtent(void) const {
+  return Vector3D(hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2]);
+}
+
+bool Bounds3D::isEmpty(void) const {
+  return lo[0] > hi[0] || lo[1] > hi[1] || lo[2] > hi[2];
+}
+
+bool Bounds3D::isFinite(void) const {
+  for (int i = 0; i < 3; i++) {
+    if (!std::isfinite(lo[i]) || !std::isfinite(hi[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+float Bounds3D::surfaceArea(void) const {
+  if (isEmpty()) {
+    return 0.0F;
+  }
+  auto dx = hi[0] - lo[0];
+  auto dy = hi[1] - lo[1];
+  auto dz = hi[2] - lo[2];
+  return 2.0F * (dx * dy + dy * dz + dz * dx);
+}
+
+int Bounds3D::getLongestAxis(void) const {
+  auto dx = hi[0] - lo[0];
+  auto dy = hi[1] - lo[1];
+  auto dz = hi[2] - lo[2];
+  if (dx >= dy && dx >= dz) {
+    return 0;
+  }
+  return dy >= dz ? 1 : 2;
+}
+
+void Bounds3D::expand(const Point3D &p) {
+  for (int i = 0; i < 3; i++) {
+    lo[i] = std::min(lo[i], p[i]);
+    hi[i] = std::max(hi[i], p[i]);
+  }
+}
+
+void Bounds3D::expand(const Bounds3D &b) {
+  for (int i = 0; i < 3; i++) {
+    lo[i] = std::min(lo[i], b.lo[i]);
+    hi[i] = std::max(hi[i], b.hi[i]);
+  }
+}
+
+bool Bounds3D::intersect(const Ray &ray, const Vector3D &invDirection,
+                         float tMin, float tMax, float *tNear) const {
+  const auto &o = ray.getOrigin();
+  for (int i = 0; i < 3; i++) {
+    auto t0 = (lo[i] - o[i]) * invDirection[i];
+    auto t1 = (hi[i] - o[i]) * invDirection[i];
+    if (t0 > t1) {
+      std::swap(t0, t1);
+    }
+    // written so that a NaN from 0 * inf leaves the interval unchanged
+    tMin = t0 > tMin ? t0 : tMin;
+    tMax = t1 < tMax ? t1 : tMax;
+    if (tMin > tMax) {
+      return false;
+    }
+  }
+  if (tNear) {
+    *tNear = tMin;
+  }
+  return true;
+}
+
+Bounds3D Bounds3D::infinite(void) {
+  return Bounds3D(Point3D(-INFINITY, -INFINITY, -INFINITY),
+                  Point3D(INFINITY, INFINITY, INFINITY));
+}
+
+Bounds3D merge(const Bounds3D &a, const Bounds3D &b) {
+  auto result = a;
+  result.expand(b);
+  return result;
+}
+
+Bounds3D transform(const Bounds3D &b, const Transform4D &h) {
+  return transform(b, Transform3x4(h));
+}
+
+Bounds3D transform(const Bounds3D &b, const Transform3x4 &h) {
+  if (b.isEmpty()) {
+    return b;
+  }
+  if (!b.isFinite()) {
+    return Bounds3D::infinite();
+  }
+
+  // Arvo: each output extent is the translation plus, per input axis, the
+  // smaller (or larger) of the two scaled corners
+  Bounds3D result;
+  for (int i = 0; i < 3; i++) {
+    result.lo[i] = result.hi[i] = h(i, 3);
+    for (int j = 0; j < 3; j++) {
+      auto a = h(i, j) * b.lo[j];
+      auto c = h(i, j) * b.hi[j];
+      result.lo[i] += std::min(a, c);
+      result.hi[i] += std::max(a, c);
+    }
+  }
+  return result;
+}
+} // namespace math
+} // namespace liby
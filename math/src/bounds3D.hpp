@@ -0,0 +1,83 @@
+#pragma once
+
+#include "ray.hpp"
+#include "transform4D.hpp"
+#include "vector3D.hpp"
+
+namespace liby {
+namespace math {
+/**
+ * @brief Axis-aligned bounding box. A default-constructed box is empty
+ * (lo = +inf, hi = -inf) so that expanding it by anything yields that thing.
+ * The corners are plain arrays so that traversal loops can read them without
+ * going through Vector3D accessors.
+ */
+class Bounds3D {
+public:
+  Bounds3D();
+  Bounds3D(const Point3D &lo, const Point3D &hi);
+
+  Point3D getMin(void) const;
+  Point3D getMax(void) const;
+  Point3D getCenter(void) const;
+  Vector3D getExtent(void) const;
+  bool isEmpty(void) const;
+  bool isFinite(void) const;
+  float surfaceArea(void) const;
+
+  /**
+   * @brief Returns the axis (0, 1 or 2) along which the box is longest.
+   */
+  int getLongestAxis(void) const;
+
+  void expand(const Point3D &);
+  void expand(const Bounds3D &);
+
+  /**
+   * @brief Slab test against the segment [tMin, tMax] of ray. invDirection
+   * holds the reciprocals of the ray direction. On a hit, the entry distance
+   * is written to tNear when it is non-null.
+   */
+  bool intersect(const Ray &ray, const Vector3D &invDirection, float tMin,
+                 float tMax, float *tNear = nullptr) const;
+
+  /**
+   * @brief Box that contains everything; used for unbounded shapes.
+   */
+  static Bounds3D infinite(void);
+
+  friend Bounds3D merge(const Bounds3D &, const Bounds3D &);
+
+  /**
+   * @brief Returns the bounds of the box after transformation by h. Infinite
+   * boxes stay infinite.
+   */
+  friend Bounds3D transform(const Bounds3D &, const Transform4D &);
+  friend Bounds3D transform(const Bounds3D &, const Transform3x4 &);
+
+  float lo[3];
+  float hi[3];
+};
+
+/**
+ * @brief Slab test of b against the segment [tMin, tMax] of the ray with the
+ * given origin and reciprocal direction, on raw floats for traversal loops.
+ * Operand order keeps a NaN from 0 * inf from widening the interval.
+ */
+inline bool slabTest(const Bounds3D &b, const float *origin,
+                     const float *invDirection, float tMin, float tMax) {
+  for (int i = 0; i < 3; i++) {
+    auto t0 = (b.lo[i] - origin[i]) * invDirection[i];
+    auto t1 = (b.hi[i] - origin[i]) * invDirection[i];
+    if (t0 > t1) {
+      auto t = t0;
+      t0 = t1;
+      t1 = t;
+    }
+    tMin = t0 > tMin ? t0 : tMin;
+    tMax = t1 < tMax ? t1 : tMax;
+  }
+  return tMin <= tMax;
+}
+} // namespace math
+} // namespace liby
@@ -0,0 +1,223 @@
+#include "encoding.hpp"
+#include "simd.hpp"
+#include <algorithm>
+
+namespace liby {
+namespace math {
+namespace {
+constexpr float Snorm16Max = 32767.0F;
+constexpr float Snorm8Max = 127.0F;
+
+float signNotZero(float x) { return std::copysign(1.0F, x); }
+
+int32_t quantise(float x, float scale) {
+  return static_cast<int32_t>(
+      std::nearbyint(std::min(std::max(x, -1.0F), 1.0F) * scale));
+}
+
+float dequantise(int32_t q, float scale) {
+  return std::max(static_cast<float>(q) / scale, -1.0F);
+}
+
+// projects v onto the octahedron |x| + |y| + |z| = 1 and unfolds the lower
+// hemisphere over the diagonals
+void octahedralEncode(const Vector3D &v, float scale, int32_t *u,
+                      int32_t *w) {
+  auto l1 = std::max(std::fabs(v.x()) + std::fabs(v.y()) + std::fabs(v.z()),
+                     1e-30F);
+  auto inv = 1.0F / l1;
+  auto px = v.x() * inv;
+  auto py = v.y() * inv;
+  if (v.z() < 0.0F) {
+    auto fx = (1.0F - std::fabs(py)) * signNotZero(px);
+    auto fy = (1.0F - std::fabs(px)) * signNotZero(py);
+    px = fx;
+    py = fy;
+  }
+  *u = quantise(px, scale);
+  *w = quantise(py, scale);
+}
+
+Vector3D octahedralDecode(int32_t u, int32_t w, float scale) {
+  auto px = dequantise(u, scale);
+  auto py = dequantise(w, scale);
+  auto pz = 1.0F - std::fabs(px) - std::fabs(py);
+  auto t = std::max(-pz, 0.0F);
+  px += px >= 0.0F ? -t : t;
+  py += py >= 0.0F ? -t : t;
+  auto inv = 1.0F / std::sqrt(px * px + py * py + pz * pz);
+  return Vector3D(px * inv, py * inv, pz * inv);
+}
+
+// SIMD kernels operate on four vectors split into x, y and z lanes
+void octahedralEncode4(const Vector3D *v, float scale, int32_t *u,
+                       int32_t *w) {
+  using namespace simd;
+  auto x = Float4(v[0].x(), v[1].x(), v[2].x(), v[3].x());
+  auto y = Float4(v[0].y(), v[1].y(), v[2].y(), v[3].y());
+  auto z = Float4(v[0].z(), v[1].z(), v[2].z(), v[3].z());
+  auto l1 = max(abs(x) + abs(y) + abs(z), Float4(1e-30F));
+  auto inv = Float4(1.0F) / l1;
+  auto px = x * inv;
+  auto py = y * inv;
+  auto lower = z < Float4(0.0F);
+  auto fx = (Float4(1.0F) - abs(py)) * signNotZero(px);
+  auto fy = (Float4(1.0F) - abs(px)) * signNotZero(py);
+  px = min(max(select(lower, fx, px), Float4(-1.0F)), Float4(1.0F));
+  py = min(max(select(lower, fy, py), Float4(-1.0F)), Float4(1.0F));
+  roundToInt(px * Float4(scale)).store(u);
+  roundToInt(py * Float4(scale)).store(w);
+}
+
+void octahedralDecode4(const int32_t *u, const int32_t *w, float scale,
+                       Vector3D *v) {
+  using namespace simd;
+  auto px = max(toFloat(Int4::load(u)) / Float4(scale), Float4(-1.0F));
+  auto py = max(toFloat(Int4::load(w)) / Float4(scale), Float4(-1.0F));
+  auto pz = Float4(1.0F) - abs(px) - abs(py);
+  auto t = max(-pz, Float4(0.0F));
+  px = px + select(px >= Float4(0.0F), -t, t);
+  py = py + select(py >= Float4(0.0F), -t, t);
+  auto inv = Float4(1.0F) / sqrt(px * px + py * py + pz * pz);
+  px = px * inv;
+  py = py * inv;
+  pz = pz * inv;
+  for (int i = 0; i < 4; i++) {
+    v[i] = Vector3D(px[i], py[i], pz[i]);
+  }
+}
+} // namespace
+
+uint32_t encodeOctahedral32(const Vector3D &v) {
+  int32_t u, w;
+  octahedralEncode(v, Snorm16Max, &u, &w);
+  return static_cast<uint16_t>(u) |
+         static_cast<uint32_t>(static_cast<uint16_t>(w)) << 16;
+}
+
+Vector3D decodeOctahedral32(uint32_t e) {
+  return octahedralDecode(static_cast<int16_t>(e & 0xFFFF),
+                          static_cast<int16_t>(e >> 16), Snorm16Max);
+}
+
+uint16_t encodeOctahedral16(const Vector3D &v) {
+  int32_t u, w;
+  octahedralEncode(v, Snorm8Max, &u, &w);
+  return static_cast<uint16_t>(static_cast<uint8_t>(u) |
+                               static_cast<uint8_t>(w) << 8);
+}
+
+Vector3D decodeOctahedral16(uint16_t e) {
+  return octahedralDecode(static_cast<int8_t>(e & 0xFF),
+                          static_cast<int8_t>(e >> 8), Snorm8Max);
+}
+
+Snorm16x3 encodeSnorm16x3(const Vector3D &v) {
+  return Snorm16x3{static_cast<int16_t>(quantise(v.x(), Snorm16Max)),
+                   static_cast<int16_t>(quantise(v.y(), Snorm16Max)),
+                   static_cast<int16_t>(quantise(v.z(), Snorm16Max))};
+}
+
+Vector3D decodeSnorm16x3(const Snorm16x3 &e) {
+  return Vector3D(dequantise(e.x, Snorm16Max), dequantise(e.y, Snorm16Max),
+                  dequantise(e.z, Snorm16Max));
+}
+
+void encodeOctahedral32(const Vector3D *v, uint32_t *e, size_t count) {
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    int32_t u[4], w[4];
+    octahedralEncode4(v + i, Snorm16Max, u, w);
+    for (int k = 0; k < 4; k++) {
+      e[i + k] = static_cast<uint16_t>(u[k]) |
+                 static_cast<uint32_t>(static_cast<uint16_t>(w[k])) << 16;
+    }
+  }
+  for (; i < count; i++) {
+    e[i] = encodeOctahedral32(v[i]);
+  }
+}
+
+void decodeOctahedral32(const uint32_t *e, Vector3D *v, size_t count) {
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    int32_t u[4], w[4];
+    for (int k = 0; k < 4; k++) {
+      u[k] = static_cast<int16_t>(e[i + k] & 0xFFFF);
+      w[k] = static_cast<int16_t>(e[i + k] >> 16);
+    }
+    octahedralDecode4(u, w, Snorm16Max, v + i);
+  }
+  for (; i < count; i++) {
+    v[i] = decodeOctahedral32(e[i]);
+  }
+}
+
+void encodeOctahedral16(const Vector3D *v, uint16_t *e, size_t count) {
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    int32_t u[4], w[4];
+    octahedralEncode4(v + i, Snorm8Max, u, w);
+    for (int k = 0; k < 4; k++) {
+      e[i + k] = static_cast<uint16_t>(static_cast<uint8_t>(u[k]) |
+                                       static_cast<uint8_t>(w[k]) << 8);
+    }
+  }
+  for (; i < count; i++) {
+    e[i] = encodeOctahedral16(v[i]);
+  }
+}
+
+void decodeOctahedral16(const uint16_t *e, Vector3D *v, size_t count) {
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    int32_t u[4], w[4];
+    for (int k = 0; k < 4; k++) {
+      u[k] = static_cast<int8_t>(e[i + k] & 0xFF);
+      w[k] = static_cast<int8_t>(e[i + k] >> 8);
+    }
+    octahedralDecode4(u, w, Snorm8Max, v + i);
+  }
+  for (; i < count; i++) {
+    v[i] = decodeOctahedral16(e[i]);
+  }
+}
+
+// Vector3D is three tightly packed floats, so the batch snorm paths treat the
+// input as one flat float stream and quantise four components at a time
+void encodeSnorm16x3(const Vector3D *v, Snorm16x3 *e, size_t count) {
+  using namespace simd;
+  auto src = reinterpret_cast<const float *>(v);
+  auto dst = reinterpret_cast<int16_t *>(e);
+  auto n = count * 3;
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    auto x = min(max(Float4::load(src + i), Float4(-1.0F)), Float4(1.0F));
+    int32_t q[4];
+    roundToInt(x * Float4(Snorm16Max)).store(q);
+    for (int k = 0; k < 4; k++) {
+      dst[i + k] = static_cast<int16_t>(q[k]);
+    }
+  }
+  for (; i < n; i++) {
+    dst[i] = static_cast<int16_t>(quantise(src[i], Snorm16Max));
+  }
+}
+
+void decodeSnorm16x3(const Snorm16x3 *e, Vector3D *v, size_t count) {
+  using namespace simd;
+  auto src = reinterpret_cast<const int16_t *>(e);
+  auto dst = reinterpret_cast<float *>(v);
+  auto n = count * 3;
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    int32_t q[4] = {src[i], src[i + 1], src[i + 2], src[i + 3]};
+    max(toFloat(Int4::load(q)) / Float4(Snorm16Max), Float4(-1.0F))
+        .store(dst + i);
+  }
+  for (; i < n; i++) {
+    dst[i] = dequantise(src[i], Snorm16Max);
+  }
+}
+} // namespace math
+} // namespace liby
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "vector3D.hpp"
+#include <cstddef>
+#include <cstdint>
+
+namespace liby {
+namespace math {
+/**
+ * @brief Three signed-normalised 16-bit components, one per axis.
+ */
+struct Snorm16x3 {
+  int16_t x;
+  int16_t y;
+  int16_t z;
+};
+
+/**
+ * @brief Encodes a unit vector with the octahedral mapping into two snorm16
+ * values packed as u | v << 16.
+ *
+ * Round trip error over the unit sphere is at most 0.004 degrees
+ * (about 6.5e-5 radians), well below anything visible in shading.
+ *
+ * @param v unit Vector3D
+ *
+ * @return uint32_t
+ */
+uint32_t encodeOctahedral32(const Vector3D &v);
+Vector3D decodeOctahedral32(uint32_t e);
+
+/**
+ * @brief Encodes a unit vector with the octahedral mapping into two snorm8
+ * values packed as u | v << 8.
+ *
+ * Round trip error over the unit sphere is at most 0.96 degrees, which is
+ * enough for tangents and normals of rough surfaces but shows as banding on
+ * smooth highlights.
+ *
+ * @param v unit Vector3D
+ *
+ * @return uint16_t
+ */
+uint16_t encodeOctahedral16(const Vector3D &v);
+Vector3D decodeOctahedral16(uint16_t e);
+
+/**
+ * @brief Quantises every component of v, which must lie in [-1, 1], to a
+ * snorm16. The per-component error is about 1.5e-5 (half a quantisation step);
+ * the decoded vector is not renormalised.
+ *
+ * @param v Vector3D
+ *
+ * @return Snorm16x3
+ */
+Snorm16x3 encodeSnorm16x3(const Vector3D &v);
+Vector3D decodeSnorm16x3(const Snorm16x3 &e);
+
+// batch forms of the above, processing four vectors per SIMD iteration
+void encodeOctahedral32(const Vector3D *v, uint32_t *e, size_t count);
+void decodeOctahedral32(const uint32_t *e, Vector3D *v, size_t count);
+void encodeOctahedral16(const Vector3D *v, uint16_t *e, size_t count);
+void decodeOctahedral16(const uint16_t *e, Vector3D *v, size_t count);
+void encodeSnorm16x3(const Vector3D *v, Snorm16x3 *e, size_t count);
+void decodeSnorm16x3(const Snorm16x3 *e, Vector3D *v, size_t count);
+} // namespace math
+} // namespace liby
@@ -72,38 +72,7 @@ const float &Matrix4D::operator()(int i, int j) const {
 }
 
 Matrix4D &Matrix4D::operator*=(const Matrix4D &m) {
-  n[0][0] = n[0][0] * m.n[0][0] + n[1][0] * m.n[0][1] + n[2][0] * m.n[0][2] +
-            n[3][0] * m.n[0][3];
-  n[0][1] = n[0][0] * m.n[1][0] + n[1][0] * m.n[1][1] + n[2][0] * m.n[1][2] +
-            n[3][0] * m.n[1][3];
-  n[0][2] = n[0][0] * m.n[1][0] + n[1][0] * m.n[1][1] + n[2][0] * m.n[2][2] +
-            n[3][0] * m.n[2][3];
-  n[0][3] = n[0][0] * m.n[1][0] + n[1][0] * m.n[1][1] + n[2][0] * m.n[2][2] +
-            n[3][0] * m.n[3][3];
-  n[1][0] = n[0][1] * m.n[0][0] + n[1][1] * m.n[0][1] + n[2][1] * m.n[0][2] +
-            n[3][1] * m.n[0][3];
-  n[1][1] = n[0][1] * m.n[0][1] + n[1][1] * m.n[1][1] + n[2][1] * m.n[1][2] +
-            n[3][1] * m.n[1][3];
-  n[1][2] = n[0][1] * m.n[0][1] + n[1][1] * m.n[1][1] + n[2][1] * m.n[2][2] +
-            n[3][1] * m.n[2][3];
-  n[1][3] = n[0][1] * m.n[0][1] + n[1][1] * m.n[1][1] + n[2][1] * m.n[2][2] +
-            n[3][1] * m.n[3][3];
-  n[2][0] = n[0][1] * m.n[0][0] + n[1][1] * m.n[0][1] + n[2][2] * m.n[0][2] +
-            n[3][2] * m.n[0][3];
-  n[2][1] = n[0][1] * m.n[0][1] + n[1][1] * m.n[1][1] + n[2][2] * m.n[1][2] +
-            n[3][2] * m.n[1][3];
-  n[2][2] = n[0][1] * m.n[0][1] + n[1][1] * m.n[1][1] + n[2][2] * m.n[2][2] +
-            n[3][2] * m.n[2][3];
-  n[2][3] = n[0][1] * m.n[0][1] + n[1][1] * m.n[1][1] + n[2][2] * m.n[2][2] +
-            n[3][2] * m.n[3][3];
-  n[3][0] = n[0][1] * m.n[0][0] + n[1][1] * m.n[0][1] + n[2][2] * m.n[0][2] +
-            n[3][3] * m.n[0][3];
-  n[3][1] = n[0][1] * m.n[0][1] + n[1][1] * m.n[1][1] + n[2][2] * m.n[1][2] +
-            n[3][3] * m.n[1][3];
-  n[3][2] = n[0][1] * m.n[0][1] + n[1][1] * m.n[1][1] + n[2][2] * m.n[2][2] +
-            n[3][3] * m.n[2][3];
-  n[3][3] = n[0][1] * m.n[0][1] + n[1][1] * m.n[1][1] + n[2][2] * m.n[2][2] +
-            n[3][3] * m.n[3][3];
+  *this = *this * m;
   return *this;
 }
 
@@ -132,34 +101,34 @@ Matrix4D operator*(const Matrix4D &m, const Matrix4D &q) {
                       m.n[2][0] * q.n[0][2] + m.n[3][0] * q.n[0][3],
                   m.n[0][0] * q.n[1][0] + m.n[1][0] * q.n[1][1] +
                       m.n[2][0] * q.n[1][2] + m.n[3][0] * q.n[1][3],
-                  m.n[0][0] * q.n[1][0] + m.n[1][0] * q.n[1][1] +
+                  m.n[0][0] * q.n[2][0] + m.n[1][0] * q.n[2][1] +
                       m.n[2][0] * q.n[2][2] + m.n[3][0] * q.n[2][3],
-                  m.n[0][0] * q.n[1][0] + m.n[1][0] * q.n[1][1] +
-                      m.n[2][0] * q.n[2][2] + m.n[3][0] * q.n[3][3],
+                  m.n[0][0] * q.n[3][0] + m.n[1][0] * q.n[3][1] +
+                      m.n[2][0] * q.n[3][2] + m.n[3][0] * q.n[3][3],
                   m.n[0][1] * q.n[0][0] + m.n[1][1] * q.n[0][1] +
                       m.n[2][1] * q.n[0][2] + m.n[3][1] * q.n[0][3],
-                  m.n[0][1] * q.n[0][1] + m.n[1][1] * q.n[1][1] +
+                  m.n[0][1] * q.n[1][0] + m.n[1][1] * q.n[1][1] +
                       m.n[2][1] * q.n[1][2] + m.n[3][1] * q.n[1][3],
-                  m.n[0][1] * q.n[0][1] + m.n[1][1] * q.n[1][1] +
+                  m.n[0][1] * q.n[2][0] + m.n[1][1] * q.n[2][1] +
                       m.n[2][1] * q.n[2][2] + m.n[3][1] * q.n[2][3],
-                  m.n[0][1] * q.n[0][1] + m.n[1][1] * q.n[1][1] +
-                      m.n[2][1] * q.n[2][2] + m.n[3][1] * q.n[3][3],
-                  m.n[0][1] * q.n[0][0] + m.n[1][1] * q.n[0][1] +
+                  m.n[0][1] * q.n[3][0] + m.n[1][1] * q.n[3][1] +
+                      m.n[2][1] * q.n[3][2] + m.n[3][1] * q.n[3][3],
+                  m.n[0][2] * q.n[0][0] + m.n[1][2] * q.n[0][1] +
                       m.n[2][2] * q.n[0][2] + m.n[3][2] * q.n[0][3],
-                  m.n[0][1] * q.n[0][1] + m.n[1][1] * q.n[1][1] +
+                  m.n[0][2] * q.n[1][0] + m.n[1][2] * q.n[1][1] +
                       m.n[2][2] * q.n[1][2] + m.n[3][2] * q.n[1][3],
-                  m.n[0][1] * q.n[0][1] + m.n[1][1] * q.n[1][1] +
+                  m.n[0][2] * q.n[2][0] + m.n[1][2] * q.n[2][1] +
                       m.n[2][2] * q.n[2][2] + m.n[3][2] * q.n[2][3],
-                  m.n[0][1] * q.n[0][1] + m.n[1][1] * q.n[1][1] +
-                      m.n[2][2] * q.n[2][2] + m.n[3][2] * q.n[3][3],
-                  m.n[0][1] * q.n[0][0] + m.n[1][1] * q.n[0][1] +
-                      m.n[2][2] * q.n[0][2] + m.n[3][3] * q.n[0][3],
-                  m.n[0][1] * q.n[0][1] + m.n[1][1] * q.n[1][1] +
-                      m.n[2][2] * q.n[1][2] + m.n[3][3] * q.n[1][3],
-                  m.n[0][1] * q.n[0][1] + m.n[1][1] * q.n[1][1] +
-                      m.n[2][2] * q.n[2][2] + m.n[3][3] * q.n[2][3],
-                  m.n[0][1] * q.n[0][1] + m.n[1][1] * q.n[1][1] +
-                      m.n[2][2] * q.n[2][2] + m.n[3][3] * q.n[3][3]);
+                  m.n[0][2] * q.n[3][0] + m.n[1][2] * q.n[3][1] +
+                      m.n[2][2] * q.n[3][2] + m.n[3][2] * q.n[3][3],
+                  m.n[0][3] * q.n[0][0] + m.n[1][3] * q.n[0][1] +
+                      m.n[2][3] * q.n[0][2] + m.n[3][3] * q.n[0][3],
+                  m.n[0][3] * q.n[1][0] + m.n[1][3] * q.n[1][1] +
+                      m.n[2][3] * q.n[1][2] + m.n[3][3] * q.n[1][3],
+                  m.n[0][3] * q.n[2][0] + m.n[1][3] * q.n[2][1] +
+                      m.n[2][3] * q.n[2][2] + m.n[3][3] * q.n[2][3],
+                  m.n[0][3] * q.n[3][0] + m.n[1][3] * q.n[3][1] +
+                      m.n[2][3] * q.n[3][2] + m.n[3][3] * q.n[3][3]);
 }
 
 Vector4D operator*(const Matrix4D &m, const Vector3D &v) {
@@ -0,0 +1,18 @@
+#include "morton.hpp"
+
+namespace liby {
+namespace math {
+uint32_t expandBits3(uint32_t v) {
+  v &= 0x3FFU;
+  v = (v | (v << 16)) & 0x030000FFU;
+  v = (v | (v << 8)) & 0x0300F00FU;
+  v = (v | (v << 4)) & 0x030C30C3U;
+  v = (v | (v << 2)) & 0x09249249U;
+  return v;
+}
+
+uint32_t encodeMorton3(uint32_t x, uint32_t y, uint32_t z) {
+  return (expandBits3(x) << 2) | (expandBits3(y) << 1) | expandBits3(z);
+}
+} // namespace math
+} // namespace liby
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+
+namespace liby {
+namespace math {
+/**
+ * @brief Spreads the low 10 bits of v so that two zero bits separate each of
+ * them.
+ */
+uint32_t expandBits3(uint32_t v);
+
+/**
+ * @brief Interleaves the low 10 bits of x, y and z into a 30-bit Morton code,
+ * x in the most significant position of every triple.
+ */
+uint32_t encodeMorton3(uint32_t x, uint32_t y, uint32_t z);
+} // namespace math
+} // namespace liby
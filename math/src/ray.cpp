@@ -0,0 +1,21 @@
+#include "ray.hpp"
+
+namespace liby {
+namespace math {
+Ray::Ray(const Point3D &origin, const Vector3D &direction)
+    : origin_(origin), direction_(direction) {}
+
+const Point3D &Ray::getOrigin(void) const { return origin_; }
+const Vector3D &Ray::getDirection(void) const { return direction_; }
+
+Point3D Ray::position(float t) const { return origin_ + direction_ * t; }
+
+Ray transform(const Ray &r, const Transform4D &h) {
+  return Ray(h * r.origin_, h * r.direction_);
+}
+
+Ray transform(const Ray &r, const Transform3x4 &h) {
+  return Ray(h * r.origin_, h * r.direction_);
+}
+} // namespace math
+} // namespace liby
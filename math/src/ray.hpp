@@ -0,0 +1,41 @@
+#pragma once
+
+#include "transform3x4.hpp"
+#include "transform4D.hpp"
+#include "vector3D.hpp"
+
+namespace liby {
+namespace math {
+/**
+ * @brief Half-line starting at origin and running along direction. Unlike
+ * Line, which is an infinite Plucker line, a Ray has a start point so that
+ * distances along it are signed.
+ */
+class Ray {
+public:
+  Ray() = default;
+  Ray(const Point3D &origin, const Vector3D &direction);
+
+  const Point3D &getOrigin(void) const;
+  const Vector3D &getDirection(void) const;
+
+  /**
+   * @brief Returns the point at distance t along the ray, measured in units
+   * of the direction vector.
+   */
+  Point3D position(float t) const;
+
+  /**
+   * @brief Transforms the origin as a point and the direction as a vector.
+   * The direction is not renormalised, so distances along the transformed ray
+   * match distances along the original one.
+   */
+  friend Ray transform(const Ray &, const Transform4D &);
+  friend Ray transform(const Ray &, const Transform3x4 &);
+
+private:
+  Point3D origin_;
+  Vector3D direction_;
+};
+} // namespace math
+} // namespace liby
@@ -0,0 +1,194 @@
+#pragma once
+
+#include "bounds3D.hpp"
+#include "simd.hpp"
+#include "transform4D.hpp"
+#include "vector3D.hpp"
+#include <limits>
+
+namespace liby {
+namespace math {
+/**
+ * @brief A bundle of Width rays stored structure-of-arrays, one SIMD register
+ * per component, so that every operation below handles all lanes at once.
+ *
+ * Directions are not required to be unit length; the inverse direction is
+ * cached for slab tests and must be refreshed with updateInverse() whenever
+ * the directions are edited by hand.
+ */
+template <typename FloatT> struct RayPacket {
+  using Float = FloatT;
+  using Mask = typename FloatT::Mask;
+  static constexpr int Width = FloatT::Width;
+
+  Float ox, oy, oz;
+  Float dx, dy, dz;
+  Float idx, idy, idz;
+  Float tMin, tMax;
+
+  RayPacket() = default;
+
+  /**
+   * @brief Builds a packet from count rays (count <= Width). Unused lanes
+   * repeat the last ray with an empty t-range so they never report hits.
+   */
+  static RayPacket
+  fromRays(const Point3D *origins, const Vector3D *directions, int count,
+           float tMin = 0.0F,
+           float tMax = std::numeric_limits<float>::infinity()) {
+    alignas(32) float o[3][Width];
+    alignas(32) float d[3][Width];
+    alignas(32) float t0[Width];
+    alignas(32) float t1[Width];
+    for (int i = 0; i < Width; i++) {
+      auto k = i < count ? i : count - 1;
+      for (int a = 0; a < 3; a++) {
+        o[a][i] = origins[k][a];
+        d[a][i] = directions[k][a];
+      }
+      t0[i] = i < count ? tMin : 1.0F;
+      t1[i] = i < count ? tMax : 0.0F;
+    }
+    RayPacket p;
+    p.ox = Float::load(o[0]);
+    p.oy = Float::load(o[1]);
+    p.oz = Float::load(o[2]);
+    p.dx = Float::load(d[0]);
+    p.dy = Float::load(d[1]);
+    p.dz = Float::load(d[2]);
+    p.tMin = Float::load(t0);
+    p.tMax = Float::load(t1);
+    p.updateInverse();
+    return p;
+  }
+
+  void updateInverse(void) {
+    idx = Float(1.0F) / dx;
+    idy = Float(1.0F) / dy;
+    idz = Float(1.0F) / dz;
+  }
+
+  /**
+   * @brief Lanes whose t-range is not empty.
+   */
+  Mask valid(void) const { return tMin <= tMax; }
+
+  Point3D origin(int lane) const {
+    return Point3D(ox[lane], oy[lane], oz[lane]);
+  }
+
+  Vector3D direction(int lane) const {
+    return Vector3D(dx[lane], dy[lane], dz[lane]);
+  }
+};
+
+using RayPacket4 = RayPacket<simd::Float4>;
+using RayPacket8 = RayPacket<simd::Float8>;
+
+/**
+ * @brief Returns a mask with the first count lanes set.
+ */
+template <typename FloatT> typename FloatT::Mask firstLanes(int count) {
+  alignas(32) float lane[FloatT::Width];
+  for (int i = 0; i < FloatT::Width; i++) {
+    lane[i] = static_cast<float>(i);
+  }
+  return FloatT::load(lane) < FloatT(static_cast<float>(count));
+}
+
+/**
+ * @brief Returns a mask with lane i set where bit i of bits is.
+ */
+template <typename FloatT> typename FloatT::Mask lanesFromBits(int bits) {
+  alignas(32) float lane[FloatT::Width];
+  for (int i = 0; i < FloatT::Width; i++) {
+    lane[i] = (bits >> i) & 1 ? 1.0F : 0.0F;
+  }
+  return FloatT::load(lane) > FloatT(0.0F);
+}
+
+/**
+ * @brief Maps every ray of the packet through h. Origins are transformed as
+ * points and directions as vectors without renormalising, so t values keep
+ * their meaning in the new space.
+ */
+template <typename FloatT>
+RayPacket<FloatT> transform(const RayPacket<FloatT> &r, const Transform4D &h) {
+  using F = FloatT;
+  F m00(h(0, 0)), m01(h(0, 1)), m02(h(0, 2)), m03(h(0, 3));
+  F m10(h(1, 0)), m11(h(1, 1)), m12(h(1, 2)), m13(h(1, 3));
+  F m20(h(2, 0)), m21(h(2, 1)), m22(h(2, 2)), m23(h(2, 3));
+
+  RayPacket<FloatT> p;
+  p.ox = m00 * r.ox + m01 * r.oy + m02 * r.oz + m03;
+  p.oy = m10 * r.ox + m11 * r.oy + m12 * r.oz + m13;
+  p.oz = m20 * r.ox + m21 * r.oy + m22 * r.oz + m23;
+  p.dx = m00 * r.dx + m01 * r.dy + m02 * r.dz;
+  p.dy = m10 * r.dx + m11 * r.dy + m12 * r.dz;
+  p.dz = m20 * r.dx + m21 * r.dy + m22 * r.dz;
+  p.tMin = r.tMin;
+  p.tMax = r.tMax;
+  p.updateInverse();
+  return p;
+}
+
+/**
+ * @brief Slab test of every active lane against the axis-aligned box
+ * [lo, hi]. Returns the lanes whose [tMin, tMax] range overlaps the box and
+ * writes the entry distance of each lane to tNear.
+ *
+ * @param r RayPacket
+ * @param lo Point3D minimum corner
+ * @param hi Point3D maximum corner
+ * @param active lanes to test
+ * @param tNear entry distance per lane, only meaningful for returned lanes
+ *
+ * @return Mask
+ */
+template <typename FloatT>
+typename FloatT::Mask
+intersectBox(const RayPacket<FloatT> &r, const Point3D &lo, const Point3D &hi,
+             typename FloatT::Mask active, FloatT *tNear) {
+  using F = FloatT;
+  auto tx0 = (F(lo.x()) - r.ox) * r.idx;
+  auto tx1 = (F(hi.x()) - r.ox) * r.idx;
+  auto ty0 = (F(lo.y()) - r.oy) * r.idy;
+  auto ty1 = (F(hi.y()) - r.oy) * r.idy;
+  auto tz0 = (F(lo.z()) - r.oz) * r.idz;
+  auto tz1 = (F(hi.z()) - r.oz) * r.idz;
+
+  // min/max return their second operand when the first is NaN, which happens
+  // for an axis-parallel ray starting exactly on a slab plane; keeping tMin
+  // and tMax as second operands stops the NaN from reaching the result
+  auto enter =
+      max(max(min(tx0, tx1), min(ty0, ty1)), max(min(tz0, tz1), r.tMin));
+  auto leave =
+      min(min(max(tx0, tx1), max(ty0, ty1)), min(max(tz0, tz1), r.tMax));
+  *tNear = enter;
+  return active & (enter <= leave);
+}
+/**
+ * @brief Same test against a Bounds3D, reading its corners directly; this is
+ * the form BVH traversal uses once per visited node.
+ */
+template <typename FloatT>
+typename FloatT::Mask intersectBox(const RayPacket<FloatT> &r,
+                                   const Bounds3D &box,
+                                   typename FloatT::Mask active,
+                                   FloatT *tNear) {
+  using F = FloatT;
+  auto tx0 = (F(box.lo[0]) - r.ox) * r.idx;
+  auto tx1 = (F(box.hi[0]) - r.ox) * r.idx;
+  auto ty0 = (F(box.lo[1]) - r.oy) * r.idy;
+  auto ty1 = (F(box.hi[1]) - r.oy) * r.idy;
+  auto tz0 = (F(box.lo[2]) - r.oz) * r.idz;
+  auto tz1 = (F(box.hi[2]) - r.oz) * r.idz;
+  auto enter =
+      max(max(min(tx0, tx1), min(ty0, ty1)), max(min(tz0, tz1), r.tMin));
+  auto leave =
+      min(min(max(tx0, tx1), max(ty0, ty1)), min(max(tz0, tz1), r.tMax));
+  *tNear = enter;
+  return active & (enter <= leave);
+}
+} // namespace math
+} // namespace liby
@@ -5,6 +5,11 @@ namespace math {
 RGBA::RGBA(float r, float g, float b, float a)
     : red(r), green(g), blue(b), alpha(a) {}
 
+const float &RGBA::r() const { return red; }
+const float &RGBA::g() const { return green; }
+const float &RGBA::b() const { return blue; }
+const float &RGBA::a() const { return alpha; }
+
 RGBA &RGBA::operator*=(float s) {
   red *= s;
   green *= s;
@@ -50,6 +55,8 @@ RGBA operator*(const RGBA &c, float s) {
   return RGBA(c.red * s, c.green * s, c.blue * s, c.alpha * s);
 }
 
+RGBA operator*(float s, const RGBA &c) { return c * s; }
+
 RGBA operator/(const RGBA &c, float s) {
   s = 1.0F / s;
   return RGBA(c.red * s, c.green * s, c.blue * s, c.alpha * s);
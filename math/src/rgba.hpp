@@ -3,6 +3,7 @@
 namespace liby {
 namespace math {
 class RGBA {
+public:
   RGBA() = default;
   RGBA(float r, float g, float b, float a = 1.0F);
   RGBA &operator*=(float s);
@@ -10,8 +11,13 @@ class RGBA {
   RGBA &operator+=(const RGBA &);
   RGBA &operator-=(const RGBA &);
   RGBA &operator*=(const RGBA &);
+  const float &r() const;
+  const float &g() const;
+  const float &b() const;
+  const float &a() const;
 
   friend RGBA operator*(const RGBA &, float);
+  friend RGBA operator*(float, const RGBA &);
   friend RGBA operator/(const RGBA &, float);
   friend RGBA operator*(const RGBA &, const RGBA &);
   friend RGBA operator/(const RGBA &, const RGBA &);
@@ -0,0 +1,408 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define LIBY_SIMD_SSE 1
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX__)
+#define LIBY_SIMD_AVX 1
+#include <immintrin.h>
+#endif
+
+namespace liby {
+namespace math {
+namespace simd {
+/**
+ * @brief Per-lane boolean produced by comparisons on Float4.
+ */
+struct Mask4 {
+#ifdef LIBY_SIMD_SSE
+  __m128 v;
+  Mask4() = default;
+  Mask4(__m128 x) : v(x) {}
+  explicit Mask4(bool b) : v(_mm_castsi128_ps(_mm_set1_epi32(b ? -1 : 0))) {}
+  int bits(void) const { return _mm_movemask_ps(v); }
+#else
+  int v;
+  Mask4() = default;
+  explicit Mask4(bool b) : v(b ? 0xF : 0) {}
+  static Mask4 fromBits(int b) {
+    Mask4 m;
+    m.v = b & 0xF;
+    return m;
+  }
+  int bits(void) const { return v; }
+#endif
+  bool operator[](int i) const { return (bits() >> i) & 1; }
+};
+
+/**
+ * @brief Four packed floats. Maps to an SSE register when available and to a
+ * plain array otherwise, so code written against it stays portable.
+ */
+struct Float4 {
+  using Mask = Mask4;
+  static constexpr int Width = 4;
+#ifdef LIBY_SIMD_SSE
+  __m128 v;
+  Float4() = default;
+  Float4(__m128 x) : v(x) {}
+  Float4(float s) : v(_mm_set1_ps(s)) {}
+  Float4(float a, float b, float c, float d) : v(_mm_setr_ps(a, b, c, d)) {}
+  static Float4 load(const float *p) { return _mm_loadu_ps(p); }
+  void store(float *p) const { _mm_storeu_ps(p, v); }
+  float operator[](int i) const {
+    alignas(16) float f[4];
+    _mm_store_ps(f, v);
+    return f[i];
+  }
+#else
+  float v[4];
+  Float4() = default;
+  Float4(float s) : v{s, s, s, s} {}
+  Float4(float a, float b, float c, float d) : v{a, b, c, d} {}
+  static Float4 load(const float *p) { return Float4(p[0], p[1], p[2], p[3]); }
+  void store(float *p) const {
+    for (int i = 0; i < 4; i++) {
+      p[i] = v[i];
+    }
+  }
+  float operator[](int i) const { return v[i]; }
+#endif
+};
+
+/**
+ * @brief Four packed 32-bit integers, used for quantisation and bit tricks.
+ */
+struct Int4 {
+#ifdef LIBY_SIMD_SSE
+  __m128i v;
+  Int4() = default;
+  Int4(__m128i x) : v(x) {}
+  Int4(int32_t s) : v(_mm_set1_epi32(s)) {}
+  static Int4 load(const int32_t *p) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+  }
+  void store(int32_t *p) const {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(p), v);
+  }
+#else
+  int32_t v[4];
+  Int4() = default;
+  Int4(int32_t s) : v{s, s, s, s} {}
+  static Int4 load(const int32_t *p) {
+    Int4 r;
+    for (int i = 0; i < 4; i++) {
+      r.v[i] = p[i];
+    }
+    return r;
+  }
+  void store(int32_t *p) const {
+    for (int i = 0; i < 4; i++) {
+      p[i] = v[i];
+    }
+  }
+#endif
+};
+
+#ifdef LIBY_SIMD_SSE
+inline Mask4 operator&(Mask4 a, Mask4 b) { return _mm_and_ps(a.v, b.v); }
+inline Mask4 operator|(Mask4 a, Mask4 b) { return _mm_or_ps(a.v, b.v); }
+inline Mask4 operator^(Mask4 a, Mask4 b) { return _mm_xor_ps(a.v, b.v); }
+inline Mask4 operator~(Mask4 a) { return a ^ Mask4(true); }
+
+/**
+ * @brief Lanes set in a but not in b.
+ */
+inline Mask4 andNot(Mask4 a, Mask4 b) { return _mm_andnot_ps(b.v, a.v); }
+
+inline Float4 operator+(Float4 a, Float4 b) { return _mm_add_ps(a.v, b.v); }
+inline Float4 operator-(Float4 a, Float4 b) { return _mm_sub_ps(a.v, b.v); }
+inline Float4 operator*(Float4 a, Float4 b) { return _mm_mul_ps(a.v, b.v); }
+inline Float4 operator/(Float4 a, Float4 b) { return _mm_div_ps(a.v, b.v); }
+inline Float4 operator-(Float4 a) {
+  return _mm_xor_ps(a.v, _mm_set1_ps(-0.0F));
+}
+inline Float4 min(Float4 a, Float4 b) { return _mm_min_ps(a.v, b.v); }
+inline Float4 max(Float4 a, Float4 b) { return _mm_max_ps(a.v, b.v); }
+inline Float4 abs(Float4 a) { return _mm_andnot_ps(_mm_set1_ps(-0.0F), a.v); }
+inline Float4 sqrt(Float4 a) { return _mm_sqrt_ps(a.v); }
+
+inline Mask4 operator<(Float4 a, Float4 b) { return _mm_cmplt_ps(a.v, b.v); }
+inline Mask4 operator<=(Float4 a, Float4 b) { return _mm_cmple_ps(a.v, b.v); }
+inline Mask4 operator>(Float4 a, Float4 b) { return _mm_cmpgt_ps(a.v, b.v); }
+inline Mask4 operator>=(Float4 a, Float4 b) { return _mm_cmpge_ps(a.v, b.v); }
+
+/**
+ * @brief Picks a where mask is set and b elsewhere.
+ */
+inline Float4 select(Mask4 mask, Float4 a, Float4 b) {
+  return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v));
+}
+
+/**
+ * @brief Returns +1 or -1 with the sign of a; zero counts as positive.
+ */
+inline Float4 signNotZero(Float4 a) {
+  return _mm_or_ps(_mm_and_ps(a.v, _mm_set1_ps(-0.0F)), _mm_set1_ps(1.0F));
+}
+
+/**
+ * @brief Converts with round-to-nearest-even.
+ */
+inline Int4 roundToInt(Float4 a) { return _mm_cvtps_epi32(a.v); }
+inline Float4 toFloat(Int4 a) { return _mm_cvtepi32_ps(a.v); }
+
+/**
+ * @brief Rounds towards negative infinity, matching std::floor bit for bit.
+ */
+inline Float4 floor(Float4 a) {
+  auto r = toFloat(roundToInt(a));
+  r = r - select(r > a, Float4(1.0F), Float4(0.0F));
+  // keeps the sign of -0; negative results already have it set
+  r = _mm_or_ps(r.v, _mm_and_ps(a.v, _mm_set1_ps(-0.0F)));
+  // from 2^23 up every float is whole, and the conversion would overflow
+  return select(abs(a) < Float4(8388608.0F), r, a);
+}
+#else
+inline Mask4 operator&(Mask4 a, Mask4 b) { return Mask4::fromBits(a.v & b.v); }
+inline Mask4 operator|(Mask4 a, Mask4 b) { return Mask4::fromBits(a.v | b.v); }
+inline Mask4 operator^(Mask4 a, Mask4 b) { return Mask4::fromBits(a.v ^ b.v); }
+inline Mask4 operator~(Mask4 a) { return Mask4::fromBits(~a.v); }
+inline Mask4 andNot(Mask4 a, Mask4 b) { return Mask4::fromBits(a.v & ~b.v); }
+
+#define LIBY_FLOAT4_BINARY(op, expr)                                           \
+  inline Float4 op(Float4 a, Float4 b) {                                       \
+    Float4 r;                                                                  \
+    for (int i = 0; i < 4; i++) {                                              \
+      float x = a.v[i];                                                        \
+      float y = b.v[i];                                                        \
+      r.v[i] = (expr);                                                         \
+    }                                                                          \
+    return r;                                                                  \
+  }
+#define LIBY_FLOAT4_COMPARE(op, cmp)                                           \
+  inline Mask4 op(Float4 a, Float4 b) {                                        \
+    int bits = 0;                                                              \
+    for (int i = 0; i < 4; i++) {                                              \
+      bits |= (a.v[i] cmp b.v[i]) << i;                                        \
+    }                                                                          \
+    return Mask4::fromBits(bits);                                              \
+  }
+LIBY_FLOAT4_BINARY(operator+, x + y)
+LIBY_FLOAT4_BINARY(operator-, x - y)
+LIBY_FLOAT4_BINARY(operator*, x * y)
+LIBY_FLOAT4_BINARY(operator/, x / y)
+LIBY_FLOAT4_BINARY(min, x < y ? x : y)
+LIBY_FLOAT4_BINARY(max, x > y ? x : y)
+LIBY_FLOAT4_COMPARE(operator<, <)
+LIBY_FLOAT4_COMPARE(operator<=, <=)
+LIBY_FLOAT4_COMPARE(operator>, >)
+LIBY_FLOAT4_COMPARE(operator>=, >=)
+#undef LIBY_FLOAT4_BINARY
+#undef LIBY_FLOAT4_COMPARE
+
+inline Float4 operator-(Float4 a) { return Float4(0.0F) - a; }
+inline Float4 abs(Float4 a) {
+  return Float4(std::fabs(a.v[0]), std::fabs(a.v[1]), std::fabs(a.v[2]),
+                std::fabs(a.v[3]));
+}
+inline Float4 sqrt(Float4 a) {
+  return Float4(std::sqrt(a.v[0]), std::sqrt(a.v[1]), std::sqrt(a.v[2]),
+                std::sqrt(a.v[3]));
+}
+inline Float4 select(Mask4 mask, Float4 a, Float4 b) {
+  Float4 r;
+  for (int i = 0; i < 4; i++) {
+    r.v[i] = mask[i] ? a.v[i] : b.v[i];
+  }
+  return r;
+}
+inline Float4 signNotZero(Float4 a) {
+  return Float4(std::copysign(1.0F, a.v[0]), std::copysign(1.0F, a.v[1]),
+                std::copysign(1.0F, a.v[2]), std::copysign(1.0F, a.v[3]));
+}
+inline Int4 roundToInt(Float4 a) {
+  Int4 r;
+  for (int i = 0; i < 4; i++) {
+    r.v[i] = static_cast<int32_t>(std::nearbyint(a.v[i]));
+  }
+  return r;
+}
+inline Float4 toFloat(Int4 a) {
+  return Float4(static_cast<float>(a.v[0]), static_cast<float>(a.v[1]),
+                static_cast<float>(a.v[2]), static_cast<float>(a.v[3]));
+}
+inline Float4 floor(Float4 a) {
+  return Float4(std::floor(a.v[0]), std::floor(a.v[1]), std::floor(a.v[2]),
+                std::floor(a.v[3]));
+}
+#endif
+
+/**
+ * @brief Per-lane boolean produced by comparisons on Float8.
+ */
+struct Mask8 {
+#ifdef LIBY_SIMD_AVX
+  __m256 v;
+  Mask8() = default;
+  Mask8(__m256 x) : v(x) {}
+  explicit Mask8(bool b)
+      : v(_mm256_castsi256_ps(_mm256_set1_epi32(b ? -1 : 0))) {}
+  int bits(void) const { return _mm256_movemask_ps(v); }
+#else
+  Mask4 lo;
+  Mask4 hi;
+  Mask8() = default;
+  Mask8(Mask4 l, Mask4 h) : lo(l), hi(h) {}
+  explicit Mask8(bool b) : lo(b), hi(b) {}
+  int bits(void) const { return lo.bits() | hi.bits() << 4; }
+#endif
+  bool operator[](int i) const { return (bits() >> i) & 1; }
+};
+
+/**
+ * @brief Eight packed floats. Uses an AVX register when the build enables AVX
+ * and a pair of Float4 otherwise.
+ */
+struct Float8 {
+  using Mask = Mask8;
+  static constexpr int Width = 8;
+#ifdef LIBY_SIMD_AVX
+  __m256 v;
+  Float8() = default;
+  Float8(__m256 x) : v(x) {}
+  Float8(float s) : v(_mm256_set1_ps(s)) {}
+  Float8(float a, float b, float c, float d, float e, float f, float g,
+         float h)
+      : v(_mm256_setr_ps(a, b, c, d, e, f, g, h)) {}
+  static Float8 load(const float *p) { return _mm256_loadu_ps(p); }
+  void store(float *p) const { _mm256_storeu_ps(p, v); }
+  float operator[](int i) const {
+    alignas(32) float f[8];
+    _mm256_store_ps(f, v);
+    return f[i];
+  }
+#else
+  Float4 lo;
+  Float4 hi;
+  Float8() = default;
+  Float8(Float4 l, Float4 h) : lo(l), hi(h) {}
+  Float8(float s) : lo(s), hi(s) {}
+  Float8(float a, float b, float c, float d, float e, float f, float g,
+         float h)
+      : lo(a, b, c, d), hi(e, f, g, h) {}
+  static Float8 load(const float *p) {
+    return Float8(Float4::load(p), Float4::load(p + 4));
+  }
+  void store(float *p) const {
+    lo.store(p);
+    hi.store(p + 4);
+  }
+  float operator[](int i) const { return i < 4 ? lo[i] : hi[i - 4]; }
+#endif
+};
+
+#ifdef LIBY_SIMD_AVX
+inline Mask8 operator&(Mask8 a, Mask8 b) { return _mm256_and_ps(a.v, b.v); }
+inline Mask8 operator|(Mask8 a, Mask8 b) { return _mm256_or_ps(a.v, b.v); }
+inline Mask8 operator^(Mask8 a, Mask8 b) { return _mm256_xor_ps(a.v, b.v); }
+inline Mask8 operator~(Mask8 a) { return a ^ Mask8(true); }
+inline Mask8 andNot(Mask8 a, Mask8 b) { return _mm256_andnot_ps(b.v, a.v); }
+
+inline Float8 operator+(Float8 a, Float8 b) { return _mm256_add_ps(a.v, b.v); }
+inline Float8 operator-(Float8 a, Float8 b) { return _mm256_sub_ps(a.v, b.v); }
+inline Float8 operator*(Float8 a, Float8 b) { return _mm256_mul_ps(a.v, b.v); }
+inline Float8 operator/(Float8 a, Float8 b) { return _mm256_div_ps(a.v, b.v); }
+inline Float8 operator-(Float8 a) {
+  return _mm256_xor_ps(a.v, _mm256_set1_ps(-0.0F));
+}
+inline Float8 min(Float8 a, Float8 b) { return _mm256_min_ps(a.v, b.v); }
+inline Float8 max(Float8 a, Float8 b) { return _mm256_max_ps(a.v, b.v); }
+inline Float8 abs(Float8 a) {
+  return _mm256_andnot_ps(_mm256_set1_ps(-0.0F), a.v);
+}
+inline Float8 sqrt(Float8 a) { return _mm256_sqrt_ps(a.v); }
+
+inline Mask8 operator<(Float8 a, Float8 b) {
+  return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ);
+}
+inline Mask8 operator<=(Float8 a, Float8 b) {
+  return _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ);
+}
+inline Mask8 operator>(Float8 a, Float8 b) {
+  return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ);
+}
+inline Mask8 operator>=(Float8 a, Float8 b) {
+  return _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ);
+}
+inline Float8 select(Mask8 mask, Float8 a, Float8 b) {
+  return _mm256_blendv_ps(b.v, a.v, mask.v);
+}
+inline Float8 signNotZero(Float8 a) {
+  return _mm256_or_ps(_mm256_and_ps(a.v, _mm256_set1_ps(-0.0F)),
+                      _mm256_set1_ps(1.0F));
+}
+inline Float8 floor(Float8 a) { return _mm256_floor_ps(a.v); }
+#else
+inline Mask8 operator&(Mask8 a, Mask8 b) {
+  return Mask8(a.lo & b.lo, a.hi & b.hi);
+}
+inline Mask8 operator|(Mask8 a, Mask8 b) {
+  return Mask8(a.lo | b.lo, a.hi | b.hi);
+}
+inline Mask8 operator^(Mask8 a, Mask8 b) {
+  return Mask8(a.lo ^ b.lo, a.hi ^ b.hi);
+}
+inline Mask8 operator~(Mask8 a) { return Mask8(~a.lo, ~a.hi); }
+inline Mask8 andNot(Mask8 a, Mask8 b) {
+  return Mask8(andNot(a.lo, b.lo), andNot(a.hi, b.hi));
+}
+
+#define LIBY_FLOAT8_BINARY(op)                                                 \
+  inline Float8 op(Float8 a, Float8 b) {                                       \
+    return Float8(op(a.lo, b.lo), op(a.hi, b.hi));                             \
+  }
+#define LIBY_FLOAT8_COMPARE(op)                                                \
+  inline Mask8 op(Float8 a, Float8 b) {                                        \
+    return Mask8(op(a.lo, b.lo), op(a.hi, b.hi));                              \
+  }
+LIBY_FLOAT8_BINARY(operator+)
+LIBY_FLOAT8_BINARY(operator-)
+LIBY_FLOAT8_BINARY(operator*)
+LIBY_FLOAT8_BINARY(operator/)
+LIBY_FLOAT8_BINARY(min)
+LIBY_FLOAT8_BINARY(max)
+LIBY_FLOAT8_COMPARE(operator<)
+LIBY_FLOAT8_COMPARE(operator<=)
+LIBY_FLOAT8_COMPARE(operator>)
+LIBY_FLOAT8_COMPARE(operator>=)
+#undef LIBY_FLOAT8_BINARY
+#undef LIBY_FLOAT8_COMPARE
+
+inline Float8 operator-(Float8 a) { return Float8(-a.lo, -a.hi); }
+inline Float8 abs(Float8 a) { return Float8(abs(a.lo), abs(a.hi)); }
+inline Float8 sqrt(Float8 a) { return Float8(sqrt(a.lo), sqrt(a.hi)); }
+inline Float8 select(Mask8 mask, Float8 a, Float8 b) {
+  return Float8(select(mask.lo, a.lo, b.lo), select(mask.hi, a.hi, b.hi));
+}
+inline Float8 signNotZero(Float8 a) {
+  return Float8(signNotZero(a.lo), signNotZero(a.hi));
+}
+inline Float8 floor(Float8 a) { return Float8(floor(a.lo), floor(a.hi)); }
+#endif
+
+inline bool any(Mask4 mask) { return mask.bits() != 0; }
+inline bool all(Mask4 mask) { return mask.bits() == 0xF; }
+inline bool none(Mask4 mask) { return mask.bits() == 0; }
+inline bool any(Mask8 mask) { return mask.bits() != 0; }
+inline bool all(Mask8 mask) { return mask.bits() == 0xFF; }
+inline bool none(Mask8 mask) { return mask.bits() == 0; }
+} // namespace simd
+} // namespace math
+} // namespace liby
@@ -0,0 +1,145 @@
+#include "transform3x4.hpp"
+
+namespace liby {
+namespace math {
+Transform3x4::Transform3x4(float n00, float n01, float n02, float n03,
+                           float n10, float n11, float n12, float n13,
+                           float n20, float n21, float n22, float n23) {
+  n[0][0] = n00;
+  n[1][0] = n01;
+  n[2][0] = n02;
+  n[3][0] = n03;
+  n[0][1] = n10;
+  n[1][1] = n11;
+  n[2][1] = n12;
+  n[3][1] = n13;
+  n[0][2] = n20;
+  n[1][2] = n21;
+  n[2][2] = n22;
+  n[3][2] = n23;
+}
+
+Transform3x4::Transform3x4(const Vector3D &a, const Vector3D &b,
+                           const Vector3D &c, const Point3D &p) {
+  n[0][0] = a[0];
+  n[1][0] = b[0];
+  n[2][0] = c[0];
+  n[3][0] = p[0];
+  n[0][1] = a[1];
+  n[1][1] = b[1];
+  n[2][1] = c[1];
+  n[3][1] = p[1];
+  n[0][2] = a[2];
+  n[1][2] = b[2];
+  n[2][2] = c[2];
+  n[3][2] = p[2];
+}
+
+Transform3x4::Transform3x4(const Transform4D &h) {
+  for (int j = 0; j < 4; j++) {
+    n[j][0] = h(0, j);
+    n[j][1] = h(1, j);
+    n[j][2] = h(2, j);
+  }
+}
+
+Vector3D &Transform3x4::operator[](int j) {
+  if (j < 0 || j >= 4) {
+    throw std::runtime_error("Index out of bounds");
+  }
+  return (*reinterpret_cast<Vector3D *>(n[j]));
+}
+
+const Vector3D &Transform3x4::operator[](int j) const {
+  if (j < 0 || j >= 4) {
+    throw std::runtime_error("Index out of bounds");
+  }
+  return (*reinterpret_cast<const Vector3D *>(n[j]));
+}
+
+float &Transform3x4::operator()(int i, int j) {
+  if (i < 0 || i >= 3 || j < 0 || j >= 4) {
+    throw std::runtime_error("Index out of bounds");
+  }
+  return (n[j][i]);
+}
+
+const float &Transform3x4::operator()(int i, int j) const {
+  if (i < 0 || i >= 3 || j < 0 || j >= 4) {
+    throw std::runtime_error("Index out of bounds");
+  }
+  return (n[j][i]);
+}
+
+const Point3D Transform3x4::getTranslation(void) const {
+  return Point3D(n[3][0], n[3][1], n[3][2]);
+}
+
+void Transform3x4::setTranslation(const Point3D &p) {
+  n[3][0] = p[0];
+  n[3][1] = p[1];
+  n[3][2] = p[2];
+}
+
+Transform4D Transform3x4::getTransform4D(void) const {
+  return Transform4D(n[0][0], n[1][0], n[2][0], n[3][0], n[0][1], n[1][1],
+                     n[2][1], n[3][1], n[0][2], n[1][2], n[2][2], n[3][2]);
+}
+
+Transform3x4 operator*(const Transform3x4 &a, const Transform3x4 &b) {
+  return Transform3x4(
+      a.n[0][0] * b.n[0][0] + a.n[1][0] * b.n[0][1] + a.n[2][0] * b.n[0][2],
+      a.n[0][0] * b.n[1][0] + a.n[1][0] * b.n[1][1] + a.n[2][0] * b.n[1][2],
+      a.n[0][0] * b.n[2][0] + a.n[1][0] * b.n[2][1] + a.n[2][0] * b.n[2][2],
+      a.n[0][0] * b.n[3][0] + a.n[1][0] * b.n[3][1] + a.n[2][0] * b.n[3][2] +
+          a.n[3][0],
+      a.n[0][1] * b.n[0][0] + a.n[1][1] * b.n[0][1] + a.n[2][1] * b.n[0][2],
+      a.n[0][1] * b.n[1][0] + a.n[1][1] * b.n[1][1] + a.n[2][1] * b.n[1][2],
+      a.n[0][1] * b.n[2][0] + a.n[1][1] * b.n[2][1] + a.n[2][1] * b.n[2][2],
+      a.n[0][1] * b.n[3][0] + a.n[1][1] * b.n[3][1] + a.n[2][1] * b.n[3][2] +
+          a.n[3][1],
+      a.n[0][2] * b.n[0][0] + a.n[1][2] * b.n[0][1] + a.n[2][2] * b.n[0][2],
+      a.n[0][2] * b.n[1][0] + a.n[1][2] * b.n[1][1] + a.n[2][2] * b.n[1][2],
+      a.n[0][2] * b.n[2][0] + a.n[1][2] * b.n[2][1] + a.n[2][2] * b.n[2][2],
+      a.n[0][2] * b.n[3][0] + a.n[1][2] * b.n[3][1] + a.n[2][2] * b.n[3][2] +
+          a.n[3][2]);
+}
+
+Vector3D operator*(const Transform3x4 &h, const Vector3D &v) {
+  return Vector3D(h.n[0][0] * v.x() + h.n[1][0] * v.y() + h.n[2][0] * v.z(),
+                  h.n[0][1] * v.x() + h.n[1][1] * v.y() + h.n[2][1] * v.z(),
+                  h.n[0][2] * v.x() + h.n[1][2] * v.y() + h.n[2][2] * v.z());
+}
+
+Point3D operator*(const Transform3x4 &h, const Point3D &p) {
+  return Point3D(
+      h.n[0][0] * p.x() + h.n[1][0] * p.y() + h.n[2][0] * p.z() + h.n[3][0],
+      h.n[0][1] * p.x() + h.n[1][1] * p.y() + h.n[2][1] * p.z() + h.n[3][1],
+      h.n[0][2] * p.x() + h.n[1][2] * p.y() + h.n[2][2] * p.z() + h.n[3][2]);
+}
+
+Transform3x4 inverse(const Transform3x4 &h) {
+  const auto &a = h[0];
+  const auto &b = h[1];
+  const auto &c = h[2];
+  const auto &d = h[3];
+
+  // rows of the inverse linear part are the cross products of the columns
+  auto r0 = cross(b, c);
+  auto r1 = cross(c, a);
+  auto r2 = cross(a, b);
+  auto invDet = 1.0F / dot(r2, c);
+  r0 *= invDet;
+  r1 *= invDet;
+  r2 *= invDet;
+
+  return Transform3x4(r0.x(), r0.y(), r0.z(), -dot(r0, d), r1.x(), r1.y(),
+                      r1.z(), -dot(r1, d), r2.x(), r2.y(), r2.z(),
+                      -dot(r2, d));
+}
+
+Transform3x4 Transform3x4::identity() {
+  return Transform3x4(1.0F, 0, 0, 0, 0, 1.0F, 0, 0, 0, 0, 1.0F, 0);
+}
+} // namespace math
+} // namespace liby
@@ -0,0 +1,51 @@
+#pragma once
+#include "transform4D.hpp"
+
+namespace liby {
+namespace math {
+/**
+ * @brief Affine transform stored as the top three rows of a Transform4D.
+ *
+ * The implicit bottom row is always (0, 0, 0, 1), so the matrix takes 48
+ * bytes instead of 64 and composing two of them needs 36 multiplies instead
+ * of the 64 of a general 4x4 product. Meant for large arrays of transforms
+ * such as instances and scene-graph nodes; convert to Transform4D where the
+ * full matrix API is needed.
+ */
+class Transform3x4 {
+public:
+  Transform3x4() = default;
+  Transform3x4(float n00, float n01, float n02, float n03, float n10,
+               float n11, float n12, float n13, float n20, float n21,
+               float n22, float n23);
+  Transform3x4(const Vector3D &a, const Vector3D &b, const Vector3D &c,
+               const Point3D &p);
+  explicit Transform3x4(const Transform4D &h);
+
+  Vector3D &operator[](int j);
+  const Vector3D &operator[](int j) const;
+  float &operator()(int i, int j);
+  const float &operator()(int i, int j) const;
+
+  const Point3D getTranslation(void) const;
+  void setTranslation(const Point3D &p);
+  Transform4D getTransform4D(void) const;
+
+  friend Transform3x4 operator*(const Transform3x4 &, const Transform3x4 &);
+  friend Vector3D operator*(const Transform3x4 &, const Vector3D &);
+  friend Point3D operator*(const Transform3x4 &, const Point3D &);
+
+  /**
+   * @brief Inverts the affine transform using the 3x3 adjugate; the result is
+   * undefined when the linear part is singular.
+   */
+  friend Transform3x4 inverse(const Transform3x4 &);
+
+  static Transform3x4 identity();
+
+private:
+  // column-major like Matrix4D, n[j][i] is row i of column j
+  float n[4][3];
+};
+} // namespace math
+} // namespace liby
@@ -2,6 +2,13 @@
 
 namespace liby {
 namespace math {
+Transform4D::Transform4D(const Matrix4D &m) : Matrix4D(m) {
+  n[0][3] = 0.0F;
+  n[1][3] = 0.0F;
+  n[2][3] = 0.0F;
+  n[3][3] = 1.0F;
+}
+
 Transform4D::Transform4D(float n00, float n01, float n02, float n03, float n10,
                          float n11, float n12, float n13, float n20, float n21,
                          float n22, float n23) {
@@ -58,10 +65,14 @@ const Vector3D &Transform4D::operator[](int j) const {
 }
 
 const Point3D Transform4D::getTranslation(void) const {
-  return Point3D(n[0][3], n[1][3], n[2][3]);
+  return Point3D(n[3][0], n[3][1], n[3][2]);
 }
 
-void Transform4D::setTranslsation(const Point3D &p) {}
+void Transform4D::setTranslsation(const Point3D &p) {
+  n[3][0] = p[0];
+  n[3][1] = p[1];
+  n[3][2] = p[2];
+}
 
 Transform4D Transform4D::makeReflection(const Vector3D &v) {}
 
@@ -70,19 +81,19 @@ Transform4D Transform4D::makeRotation(float r, const Vector3D &v) {}
 Transform4D Transform4D::makeRotationX(float x) {
   auto c = cos(x);
   auto s = sin(x);
-  return Transform4D(1.0F, 0, 0, 0, c, s, 0, -s, c, 0, 0, 0);
+  return Transform4D(1.0F, 0, 0, 0, 0, c, -s, 0, 0, s, c, 0);
 }
 
 Transform4D Transform4D::makeRotationY(float y) {
   auto c = cos(y);
   auto s = sin(y);
-  return Transform4D(c, 0, -s, 1.0F, 0, s, 0, c, 0, 0, 0, 0);
+  return Transform4D(c, 0, s, 0, 0, 1.0F, 0, 0, -s, 0, c, 0);
 }
 
 Transform4D Transform4D::makeRotationZ(float z) {
   auto c = cos(z);
   auto s = sin(z);
-  return Transform4D(c, s, 0, -s, c, 0, 0, 0, 1.0F, 0, 0, 0);
+  return Transform4D(c, -s, 0, 0, s, c, 0, 0, 0, 0, 1.0F, 0);
 }
 
 Transform4D Transform4D::makeScale(float s, const Vector3D &v) {
@@ -98,7 +109,13 @@ Transform4D Transform4D::makeScale(float s, const Vector3D &v) {
 }
 
 Transform4D Transform4D::makeScale(float sx, float sy, float sz) {
-  return Transform4D(sx, 0, 0, 0, sy, 0, 0, 0, sz, 0, 0, 0);
+  return Transform4D(sx, 0, 0, 0, 0, sy, 0, 0, 0, 0, sz, 0);
+}
+
+Transform4D Transform4D::makeScale(float s) { return makeScale(s, s, s); }
+
+Transform4D Transform4D::makeTranslation(const Vector3D &v) {
+  return Transform4D(1.0F, 0, 0, v[0], 0, 1.0F, 0, v[1], 0, 0, 1.0F, v[2]);
 }
 
 Transform4D Transform4D::makeSkew(float t, const Vector3D &v,
@@ -112,10 +129,56 @@ Transform4D Transform4D::makeSkew(float t, const Vector3D &v,
                      0.0F);
 }
 
+Transform4D operator*(const Transform4D &a, const Transform4D &b) {
+  return Transform4D(
+      a.n[0][0] * b.n[0][0] + a.n[1][0] * b.n[0][1] + a.n[2][0] * b.n[0][2],
+      a.n[0][0] * b.n[1][0] + a.n[1][0] * b.n[1][1] + a.n[2][0] * b.n[1][2],
+      a.n[0][0] * b.n[2][0] + a.n[1][0] * b.n[2][1] + a.n[2][0] * b.n[2][2],
+      a.n[0][0] * b.n[3][0] + a.n[1][0] * b.n[3][1] + a.n[2][0] * b.n[3][2] +
+          a.n[3][0],
+      a.n[0][1] * b.n[0][0] + a.n[1][1] * b.n[0][1] + a.n[2][1] * b.n[0][2],
+      a.n[0][1] * b.n[1][0] + a.n[1][1] * b.n[1][1] + a.n[2][1] * b.n[1][2],
+      a.n[0][1] * b.n[2][0] + a.n[1][1] * b.n[2][1] + a.n[2][1] * b.n[2][2],
+      a.n[0][1] * b.n[3][0] + a.n[1][1] * b.n[3][1] + a.n[2][1] * b.n[3][2] +
+          a.n[3][1],
+      a.n[0][2] * b.n[0][0] + a.n[1][2] * b.n[0][1] + a.n[2][2] * b.n[0][2],
+      a.n[0][2] * b.n[1][0] + a.n[1][2] * b.n[1][1] + a.n[2][2] * b.n[1][2],
+      a.n[0][2] * b.n[2][0] + a.n[1][2] * b.n[2][1] + a.n[2][2] * b.n[2][2],
+      a.n[0][2] * b.n[3][0] + a.n[1][2] * b.n[3][1] + a.n[2][2] * b.n[3][2] +
+          a.n[3][2]);
+}
+
 Vector3D operator*(const Transform4D &h, const Vector3D &v) {
-  return (Vector3D(v[0] * h.n[0][0] + v[1] * h.n[0][1] + v[2] * h.n[0][2],
-                   v[0] * h.n[1][0] + v[1] * h.n[1][1] + v[2] * h.n[1][2],
-                   v[0] * h.n[2][0] + v[1] * h.n[2][1] + v[2] * h.n[2][2]));
+  return (Vector3D(v[0] * h.n[0][0] + v[1] * h.n[1][0] + v[2] * h.n[2][0],
+                   v[0] * h.n[0][1] + v[1] * h.n[1][1] + v[2] * h.n[2][1],
+                   v[0] * h.n[0][2] + v[1] * h.n[1][2] + v[2] * h.n[2][2]));
+}
+
+Point3D operator*(const Transform4D &h, const Point3D &p) {
+  return (Point3D(
+      p[0] * h.n[0][0] + p[1] * h.n[1][0] + p[2] * h.n[2][0] + h.n[3][0],
+      p[0] * h.n[0][1] + p[1] * h.n[1][1] + p[2] * h.n[2][1] + h.n[3][1],
+      p[0] * h.n[0][2] + p[1] * h.n[1][2] + p[2] * h.n[2][2] + h.n[3][2]));
+}
+
+Transform4D inverse(const Transform4D &h) {
+  const auto &a = h[0];
+  const auto &b = h[1];
+  const auto &c = h[2];
+  const auto &d = h[3];
+
+  auto s = cross(a, b);
+  auto t = cross(c, d);
+  auto invDet = 1.0F / dot(s, c);
+  s *= invDet;
+  t *= invDet;
+  auto v = c * invDet;
+
+  auto r0 = cross(b, v);
+  auto r1 = cross(v, a);
+
+  return Transform4D(r0[0], r0[1], r0[2], -dot(b, t), r1[0], r1[1], r1[2],
+                     dot(a, t), s[0], s[1], s[2], -dot(d, s));
 }
 
 Transform4D makeReflection(const Plane &f) {
@@ -5,6 +5,8 @@ namespace liby {
 namespace math {
 class Transform4D : public Matrix4D {
 public:
+  Transform4D() = default;
+  explicit Transform4D(const Matrix4D &m);
   Transform4D(float n00, float n01, float n02, float n03, float n10, float n11,
               float n12, float n13, float n20, float n21, float n22, float n23);
   Transform4D(const Vector3D &a, const Vector3D &b, const Vector3D &c,
@@ -16,7 +18,20 @@ public:
   const Point3D getTranslation(void) const;
   void setTranslsation(const Point3D &p);
 
+  /**
+   * @brief Composes two affine transforms. The constant bottom row is never
+   * read or multiplied, which saves 28 of the 64 multiplies of the general
+   * Matrix4D product.
+   */
+  friend Transform4D operator*(const Transform4D &, const Transform4D &);
   friend Vector3D operator*(const Transform4D &, const Vector3D &);
+  friend Point3D operator*(const Transform4D &, const Point3D &);
+
+  /**
+   * @brief Inverts an affine transform, skipping the work the general 4x4
+   * inverse spends on the constant bottom row.
+   */
+  friend Transform4D inverse(const Transform4D &);
   friend Plane operator*(const Transform4D &, const Plane &);
 
   static Transform4D makeReflection(const Vector3D &);
@@ -31,6 +46,7 @@ public:
   static Transform4D makeScaleY(float y);
   static Transform4D makeScaleZ(float z);
   static Transform4D makeScale(float sx, float sy, float sz);
+  static Transform4D makeTranslation(const Vector3D &);
   static Transform4D makeSkew(float t, const Vector3D &, const Vector3D &);
 };
 } // namespace math
@@ -0,0 +1,202 @@
+#include "transformHierarchy.hpp"
+#include <algorithm>
+
+namespace liby {
+namespace math {
+TransformHierarchy::NodeId TransformHierarchy::addNode(const Transform4D &local,
+                                                       NodeId parent) {
+  auto slot = static_cast<uint32_t>(parent_.size());
+  auto parentSlot = parent == None ? None : slotOf(parent);
+
+  parent_.push_back(parentSlot);
+  subtreeEnd_.push_back(slot + 1);
+  local_.emplace_back(local);
+  world_.emplace_back(local);
+  dirty_.push_back(0);
+  auto node = static_cast<NodeId>(slot_.size());
+  node_.push_back(node);
+  slot_.push_back(slot);
+
+  // appending keeps the depth-first order as long as the parent's subtree
+  // already ends at the back of the arrays, which is the common case when a
+  // scene is built top-down
+  if (parentSlot != None && !layoutDirty_) {
+    if (subtreeEnd_[parentSlot] == slot) {
+      for (auto a = parentSlot; a != None && subtreeEnd_[a] == slot;
+           a = parent_[a]) {
+        subtreeEnd_[a] = slot + 1;
+      }
+    } else {
+      layoutDirty_ = true;
+    }
+  }
+  markDirty(slot);
+  return node;
+}
+
+void TransformHierarchy::setParent(NodeId node, NodeId parent) {
+  auto slot = slotOf(node);
+  auto parentSlot = parent == None ? None : slotOf(parent);
+  for (auto a = parentSlot; a != None; a = parent_[a]) {
+    if (a == slot) {
+      throw std::runtime_error("Transform hierarchy cycle");
+    }
+  }
+  parent_[slot] = parentSlot;
+  layoutDirty_ = true;
+}
+
+void TransformHierarchy::setLocal(NodeId node, const Transform4D &local) {
+  setLocal(node, Transform3x4(local));
+}
+
+void TransformHierarchy::setLocal(NodeId node, const Transform3x4 &local) {
+  auto slot = slotOf(node);
+  local_[slot] = local;
+  markDirty(slot);
+}
+
+TransformHierarchy::NodeId TransformHierarchy::getParent(NodeId node) const {
+  auto parentSlot = parent_[slotOf(node)];
+  return parentSlot == None ? None : node_[parentSlot];
+}
+
+const Transform3x4 &TransformHierarchy::getLocal(NodeId node) const {
+  return local_[slotOf(node)];
+}
+
+const Transform3x4 &TransformHierarchy::getWorld(NodeId node) const {
+  return world_[slotOf(node)];
+}
+
+bool TransformHierarchy::isDirty(NodeId node) const {
+  if (layoutDirty_) {
+    return true;
+  }
+  for (auto a = slotOf(node); a != None; a = parent_[a]) {
+    if (dirty_[a]) {
+      return true;
+    }
+  }
+  return false;
+}
+
+size_t TransformHierarchy::size(void) const { return slot_.size(); }
+
+void TransformHierarchy::update(void) {
+  if (layoutDirty_) {
+    relayout();
+    for (uint32_t i = 0; i < parent_.size(); i++) {
+      world_[i] =
+          parent_[i] == None ? local_[i] : world_[parent_[i]] * local_[i];
+      dirty_[i] = 0;
+    }
+    dirtyRoots_.clear();
+    return;
+  }
+
+  // roots are visited in slot order, so a root nested inside a subtree that
+  // was already recomputed can be skipped
+  std::sort(dirtyRoots_.begin(), dirtyRoots_.end());
+  uint32_t covered = 0;
+  for (auto root : dirtyRoots_) {
+    dirty_[root] = 0;
+    if (root < covered) {
+      continue;
+    }
+    for (auto i = root; i < subtreeEnd_[root]; i++) {
+      world_[i] =
+          parent_[i] == None ? local_[i] : world_[parent_[i]] * local_[i];
+    }
+    covered = subtreeEnd_[root];
+  }
+  dirtyRoots_.clear();
+}
+
+void TransformHierarchy::relayout(void) {
+  auto count = static_cast<uint32_t>(parent_.size());
+
+  // children of every slot, packed by parent
+  std::vector<uint32_t> childStart(count + 1, 0);
+  for (uint32_t i = 0; i < count; i++) {
+    if (parent_[i] != None) {
+      childStart[parent_[i] + 1]++;
+    }
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    childStart[i + 1] += childStart[i];
+  }
+  std::vector<uint32_t> children(count);
+  std::vector<uint32_t> fill(childStart.begin(), childStart.end() - 1);
+  for (uint32_t i = 0; i < count; i++) {
+    if (parent_[i] != None) {
+      children[fill[parent_[i]]++] = i;
+    }
+  }
+
+  // depth-first order, keeping siblings in their current relative order
+  std::vector<uint32_t> order;
+  std::vector<uint32_t> stack;
+  order.reserve(count);
+  for (auto i = count; i-- > 0;) {
+    if (parent_[i] == None) {
+      stack.push_back(i);
+    }
+  }
+  while (!stack.empty()) {
+    auto s = stack.back();
+    stack.pop_back();
+    order.push_back(s);
+    for (auto c = childStart[s + 1]; c-- > childStart[s];) {
+      stack.push_back(children[c]);
+    }
+  }
+
+  std::vector<uint32_t> newSlot(count);
+  for (uint32_t k = 0; k < count; k++) {
+    newSlot[order[k]] = k;
+  }
+
+  std::vector<uint32_t> parent(count);
+  std::vector<Transform3x4> local(count);
+  std::vector<NodeId> node(count);
+  for (uint32_t k = 0; k < count; k++) {
+    auto old = order[k];
+    parent[k] = parent_[old] == None ? None : newSlot[parent_[old]];
+    local[k] = local_[old];
+    node[k] = node_[old];
+    slot_[node[k]] = k;
+  }
+  parent_ = std::move(parent);
+  local_ = std::move(local);
+  node_ = std::move(node);
+
+  // children follow their parent, so walking backwards folds every subtree
+  // into its parent before the parent itself is visited
+  for (uint32_t k = 0; k < count; k++) {
+    subtreeEnd_[k] = k + 1;
+  }
+  for (auto k = count; k-- > 0;) {
+    if (parent_[k] != None) {
+      subtreeEnd_[parent_[k]] =
+          std::max(subtreeEnd_[parent_[k]], subtreeEnd_[k]);
+    }
+  }
+  layoutDirty_ = false;
+}
+
+void TransformHierarchy::markDirty(uint32_t slot) {
+  if (!dirty_[slot]) {
+    dirty_[slot] = 1;
+    dirtyRoots_.push_back(slot);
+  }
+}
+
+uint32_t TransformHierarchy::slotOf(NodeId node) const {
+  if (node >= slot_.size()) {
+    throw std::runtime_error("Invalid transform hierarchy node");
+  }
+  return slot_[node];
+}
+} // namespace math
+} // namespace liby
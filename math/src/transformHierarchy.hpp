@@ -0,0 +1,77 @@
+#pragma once
+
+#include "transform3x4.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace liby {
+namespace math {
+/**
+ * @brief Scene-graph of Transform4D nodes stored in flat arrays.
+ *
+ * Nodes are kept in depth-first order, so every subtree occupies a contiguous
+ * range of slots and a parent always precedes its children. Changing a local
+ * transform only marks that node; update() then recomputes the world matrices
+ * of the marked subtrees in a single forward pass and leaves the rest of the
+ * hierarchy untouched. Transforms are kept in the compact 3x4 form.
+ */
+class TransformHierarchy {
+public:
+  using NodeId = uint32_t;
+  static constexpr NodeId None = UINT32_MAX;
+
+  TransformHierarchy() = default;
+
+  /**
+   * @brief Adds a node below parent (or as a root when parent is None) and
+   * returns a handle that stays valid for the lifetime of the hierarchy.
+   */
+  NodeId addNode(const Transform4D &local, NodeId parent = None);
+
+  /**
+   * @brief Moves node and its subtree below parent. Throws if parent is the
+   * node itself or one of its descendants.
+   */
+  void setParent(NodeId node, NodeId parent);
+  void setLocal(NodeId node, const Transform4D &local);
+  void setLocal(NodeId node, const Transform3x4 &local);
+
+  NodeId getParent(NodeId node) const;
+  const Transform3x4 &getLocal(NodeId node) const;
+
+  /**
+   * @brief Returns the world transform of node as of the last update().
+   */
+  const Transform3x4 &getWorld(NodeId node) const;
+  bool isDirty(NodeId node) const;
+  size_t size(void) const;
+
+  /**
+   * @brief Brings every world transform up to date. Only subtrees below nodes
+   * whose local transform changed are recomputed, unless the structure itself
+   * changed, in which case the arrays are re-sorted and rebuilt once.
+   */
+  void update(void);
+
+private:
+  void relayout(void);
+  void markDirty(uint32_t slot);
+  uint32_t slotOf(NodeId node) const;
+
+  // all arrays below are indexed by slot, in depth-first order
+  std::vector<uint32_t> parent_;
+  std::vector<uint32_t> subtreeEnd_;
+  std::vector<Transform3x4> local_;
+  std::vector<Transform3x4> world_;
+  std::vector<uint8_t> dirty_;
+  std::vector<NodeId> node_;
+
+  // handle to slot
+  std::vector<uint32_t> slot_;
+
+  // slots whose subtree needs its world transforms recomputed
+  std::vector<uint32_t> dirtyRoots_;
+  bool layoutDirty_ = false;
+};
+} // namespace math
+} // namespace liby
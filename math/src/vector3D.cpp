@@ -130,7 +130,7 @@ Point3D operator+(const Point3D &p, const Vector3D &v) {
 }
 
 Vector3D operator-(const Point3D &p, const Point3D &pp) {
-  return Vector3D(p.x_ + pp.x_, p.y_ + pp.y_, p.z_ + pp.z_);
+  return Vector3D(p.x_ - pp.x_, p.y_ - pp.y_, p.z_ - pp.z_);
 }
 
 Point3D operator-(const Point3D &p, const Vector3D &v) {
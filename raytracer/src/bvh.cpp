@@ -0,0 +1,1076 @@
+#include "bvh.hpp"
+#include "morton.hpp"
+#include "shape.hpp"
+#include "threadPool.hpp"
+#include "world.hpp"
+#include <algorithm>
+#include <memory>
+
+namespace liby {
+namespace raytracer {
+namespace {
+// deeper subtrees are collapsed into a leaf so traversal can use a fixed
+// stack; leaves too big for the 16-bit count keep halving, which takes at
+// most 16 more levels
+constexpr int MaxDepth = 64;
+static_assert(BVH::StackSize >= MaxDepth + 16, "BVH stack too small");
+constexpr int MaxBins = 64;
+
+// ranges at least this long are binned, partitioned and sorted across the
+// workers; below it the threads would mostly wait on each other
+constexpr uint32_t ParallelGrain = 16384;
+
+// subtrees smaller than this are never worth a task of their own
+constexpr uint32_t MinTaskSize = 1024;
+
+struct BuildPrimitive {
+  math::Bounds3D bounds;
+  float centroid[3];
+  uint32_t index;
+};
+
+struct Bin {
+  math::Bounds3D bounds;
+  uint32_t count = 0;
+};
+
+struct Split {
+  int axis = -1;
+  int bin = 0;
+  // sum of child areas times child counts; compare against the node area
+  // times its count
+  float cost = INFINITY;
+};
+
+struct RangeBounds {
+  math::Bounds3D bounds;
+  math::Bounds3D centroids;
+
+  void add(const BuildPrimitive &p) {
+    bounds.expand(p.bounds);
+    for (int i = 0; i < 3; i++) {
+      centroids.lo[i] = std::min(centroids.lo[i], p.centroid[i]);
+      centroids.hi[i] = std::max(centroids.hi[i], p.centroid[i]);
+    }
+  }
+
+  void add(const RangeBounds &r) {
+    bounds.expand(r.bounds);
+    centroids.expand(r.centroids);
+  }
+};
+
+uint32_t chunkBegin(uint32_t begin, uint32_t end, size_t chunk,
+                    size_t chunks) {
+  return begin + static_cast<uint32_t>(static_cast<uint64_t>(end - begin) *
+                                       chunk / chunks);
+}
+
+void runChunks(ThreadPool *pool, size_t chunks,
+               const std::function<void(size_t)> &body) {
+  if (pool && chunks > 1) {
+    pool->parallelFor(chunks, body);
+    return;
+  }
+  for (size_t c = 0; c < chunks; c++) {
+    body(c);
+  }
+}
+
+/**
+ * @brief The part of the tree above the task frontier, plus the subtrees
+ * below it. Top nodes are laid out like the final tree (first child next,
+ * second child at offset) except that a frontier node stands for a whole
+ * subtree, which is built into its own array by a worker. emit() splices
+ * everything into one depth-first array.
+ */
+class TaskTree {
+public:
+  struct Subtree {
+    uint32_t begin;
+    uint32_t end;
+    int depth;
+    std::vector<BVH::Node> nodes;
+  };
+
+  uint32_t addNode(const BVH::Node &node) {
+    nodes_.push_back(node);
+    subtreeOf_.push_back(-1);
+    return static_cast<uint32_t>(nodes_.size() - 1);
+  }
+
+  uint32_t addSubtree(uint32_t begin, uint32_t end, int depth) {
+    auto index = addNode({math::Bounds3D(), 0, 0, 0});
+    subtreeOf_[index] = static_cast<int32_t>(subtrees_.size());
+    subtrees_.push_back({begin, end, depth, {}});
+    return index;
+  }
+
+  BVH::Node &node(uint32_t index) { return nodes_[index]; }
+  std::vector<Subtree> &subtrees(void) { return subtrees_; }
+
+  size_t nodeCount(void) const {
+    auto count = nodes_.size() - subtrees_.size();
+    for (const auto &subtree : subtrees_) {
+      count += subtree.nodes.size();
+    }
+    return count;
+  }
+
+  // interior top nodes take their bounds from their children, so builders
+  // that only know bounds bottom-up can leave them empty
+  void emit(uint32_t index, std::vector<BVH::Node> &out) const {
+    if (subtreeOf_[index] >= 0) {
+      auto base = static_cast<uint32_t>(out.size());
+      for (auto node : subtrees_[subtreeOf_[index]].nodes) {
+        if (node.count == 0) {
+          node.offset += base;
+        }
+        out.push_back(node);
+      }
+      return;
+    }
+    const auto &node = nodes_[index];
+    auto at = out.size();
+    out.push_back(node);
+    if (node.count > 0) {
+      return;
+    }
+    emit(index + 1, out);
+    out[at].offset = static_cast<uint32_t>(out.size());
+    emit(node.offset, out);
+    out[at].bounds = merge(out[at + 1].bounds, out[out[at].offset].bounds);
+  }
+
+private:
+  std::vector<BVH::Node> nodes_;
+  std::vector<int32_t> subtreeOf_;
+  std::vector<Subtree> subtrees_;
+};
+
+/**
+ * @brief Shared driver of the builders. The top of the tree is split on the
+ * calling thread, using the workers inside each split for ranges that are
+ * large enough; once a range drops below the task size it becomes a subtree
+ * that one worker builds serially.
+ */
+class Builder {
+public:
+  Builder(std::vector<BuildPrimitive> &primitives,
+          const BVHSettings &settings, ThreadPool *pool)
+      : primitives_(primitives), settings_(settings), pool_(pool) {
+    auto count = static_cast<uint32_t>(primitives.size());
+    taskSize_ = pool ? std::max(MinTaskSize, count / (8 * pool->size()))
+                     : UINT32_MAX;
+  }
+  virtual ~Builder() = default;
+
+  void build(std::vector<BVH::Node> &nodes) {
+    TaskTree tree;
+    buildTop(tree, 0, static_cast<uint32_t>(primitives_.size()), 0);
+
+    // biggest subtrees first so that no worker is left with a large one at
+    // the end
+    auto &subtrees = tree.subtrees();
+    std::vector<size_t> order(subtrees.size());
+    for (size_t i = 0; i < order.size(); i++) {
+      order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+      return subtrees[a].end - subtrees[a].begin >
+             subtrees[b].end - subtrees[b].begin;
+    });
+    runChunks(pool_, order.size(), [&](size_t i) {
+      auto &subtree = subtrees[order[i]];
+      subtree.nodes.reserve(2 * (subtree.end - subtree.begin));
+      buildSerial(subtree.nodes, subtree.begin, subtree.end, subtree.depth);
+    });
+
+    nodes.clear();
+    nodes.reserve(tree.nodeCount());
+    tree.emit(0, nodes);
+  }
+
+protected:
+  /**
+   * @brief Builds the subtree over [begin, end) into nodes on the calling
+   * thread and returns the index of its root.
+   */
+  virtual uint32_t buildSerial(std::vector<BVH::Node> &nodes, uint32_t begin,
+                               uint32_t end, int depth) = 0;
+
+  /**
+   * @brief Chooses how to split a range at the top of the tree. Returns
+   * false and fills node when the range should be a leaf.
+   */
+  virtual bool splitTop(uint32_t begin, uint32_t end, int depth,
+                        BVH::Node &node, uint32_t *mid) = 0;
+
+  size_t chunksFor(uint32_t count) const {
+    if (!pool_ || count < ParallelGrain) {
+      return 1;
+    }
+    return std::min<size_t>(pool_->size(), count / (ParallelGrain / 4));
+  }
+
+  math::Bounds3D leafBounds(uint32_t begin, uint32_t end) const {
+    math::Bounds3D bounds;
+    for (auto i = begin; i < end; i++) {
+      bounds.expand(primitives_[i].bounds);
+    }
+    return bounds;
+  }
+
+  std::vector<BuildPrimitive> &primitives_;
+  const BVHSettings &settings_;
+  ThreadPool *pool_;
+
+private:
+  uint32_t buildTop(TaskTree &tree, uint32_t begin, uint32_t end, int depth) {
+    if (end - begin <= taskSize_) {
+      return tree.addSubtree(begin, end, depth);
+    }
+    BVH::Node node = {math::Bounds3D(), begin, 0, 0};
+    uint32_t mid;
+    if (!splitTop(begin, end, depth, node, &mid)) {
+      return tree.addNode(node);
+    }
+    auto index = tree.addNode(node);
+    buildTop(tree, begin, mid, depth + 1);
+    auto second = buildTop(tree, mid, end, depth + 1);
+    tree.node(index).offset = second;
+    return index;
+  }
+
+  uint32_t taskSize_;
+};
+
+class SAHBuilder : public Builder {
+public:
+  SAHBuilder(std::vector<BuildPrimitive> &primitives,
+             const BVHSettings &settings, ThreadPool *pool)
+      : Builder(primitives, settings, pool) {}
+
+protected:
+  uint32_t buildSerial(std::vector<BVH::Node> &nodes, uint32_t begin,
+                       uint32_t end, int depth) override {
+    RangeBounds range;
+    for (auto i = begin; i < end; i++) {
+      range.add(primitives_[i]);
+    }
+    auto index = static_cast<uint32_t>(nodes.size());
+    nodes.push_back({range.bounds, begin, 0, 0});
+
+    Split split;
+    auto count = end - begin;
+    if (count > 1 && depth < MaxDepth) {
+      Bin bins[3 * MaxBins];
+      binRange(begin, end, range.centroids, bins);
+      split = findSplit(bins, range.centroids, count);
+    }
+    if (!shouldSplit(count, depth, range.bounds, split)) {
+      nodes[index].count = static_cast<uint16_t>(count);
+      return index;
+    }
+
+    auto mid = begin + count / 2;
+    if (split.axis >= 0) {
+      auto it = std::partition(primitives_.begin() + begin,
+                               primitives_.begin() + end,
+                               Side(split, range.centroids, settings_.bins));
+      mid = static_cast<uint32_t>(it - primitives_.begin());
+    }
+    buildSerial(nodes, begin, mid, depth + 1);
+    auto second = buildSerial(nodes, mid, end, depth + 1);
+    nodes[index].offset = second;
+    nodes[index].axis = static_cast<uint16_t>(std::max(split.axis, 0));
+    return index;
+  }
+
+  bool splitTop(uint32_t begin, uint32_t end, int depth, BVH::Node &node,
+                uint32_t *mid) override {
+    auto count = end - begin;
+    auto chunks = chunksFor(count);
+
+    std::vector<RangeBounds> ranges(chunks);
+    runChunks(pool_, chunks, [&](size_t c) {
+      for (auto i = chunkBegin(begin, end, c, chunks),
+                e = chunkBegin(begin, end, c + 1, chunks);
+           i < e; i++) {
+        ranges[c].add(primitives_[i]);
+      }
+    });
+    for (size_t c = 1; c < chunks; c++) {
+      ranges[0].add(ranges[c]);
+    }
+    const auto &range = ranges[0];
+    node.bounds = range.bounds;
+
+    Split split;
+    if (count > 1 && depth < MaxDepth) {
+      // every chunk bins into its own slice, merged before the sweep
+      auto width = 3 * settings_.bins;
+      std::vector<Bin> chunkBins(chunks * width);
+      runChunks(pool_, chunks, [&](size_t c) {
+        binRange(chunkBegin(begin, end, c, chunks),
+                 chunkBegin(begin, end, c + 1, chunks), range.centroids,
+                 chunkBins.data() + c * width);
+      });
+      for (size_t c = 1; c < chunks; c++) {
+        for (int b = 0; b < width; b++) {
+          chunkBins[b].bounds.expand(chunkBins[c * width + b].bounds);
+          chunkBins[b].count += chunkBins[c * width + b].count;
+        }
+      }
+      split = findSplit(chunkBins.data(), range.centroids, count);
+    }
+    if (!shouldSplit(count, depth, range.bounds, split)) {
+      node.count = static_cast<uint16_t>(count);
+      return false;
+    }
+    node.axis = static_cast<uint16_t>(std::max(split.axis, 0));
+
+    *mid = begin + count / 2;
+    if (split.axis >= 0) {
+      *mid = partition(begin, end, chunks,
+                       Side(split, range.centroids, settings_.bins));
+    }
+    return true;
+  }
+
+private:
+  // true for primitives that go to the first child
+  struct Side {
+    Side(const Split &split, const math::Bounds3D &centroids, int bins)
+        : axis(split.axis), bin(split.bin), bins(bins),
+          lo(centroids.lo[split.axis]),
+          scale(bins / (centroids.hi[split.axis] - lo)) {}
+
+    bool operator()(const BuildPrimitive &p) const {
+      return binOf(p.centroid[axis], lo, scale, bins) <= bin;
+    }
+
+    int axis;
+    int bin;
+    int bins;
+    float lo;
+    float scale;
+  };
+
+  static int binOf(float c, float lo, float scale, int bins) {
+    auto b = static_cast<int>((c - lo) * scale);
+    return std::min(std::max(b, 0), bins - 1);
+  }
+
+  // bins [begin, end) along all three axes in one pass; flat axes land in
+  // bin 0 and are skipped by findSplit()
+  void binRange(uint32_t begin, uint32_t end,
+                const math::Bounds3D &centroids, Bin *bins) const {
+    auto count = settings_.bins;
+    std::fill(bins, bins + 3 * count, Bin());
+    float scale[3];
+    for (int axis = 0; axis < 3; axis++) {
+      auto extent = centroids.hi[axis] - centroids.lo[axis];
+      scale[axis] = extent > 0.0F ? count / extent : 0.0F;
+    }
+    for (auto i = begin; i < end; i++) {
+      const auto &p = primitives_[i];
+      for (int axis = 0; axis < 3; axis++) {
+        auto &bin = bins[axis * count + binOf(p.centroid[axis],
+                                              centroids.lo[axis],
+                                              scale[axis], count)];
+        bin.bounds.expand(p.bounds);
+        bin.count++;
+      }
+    }
+  }
+
+  Split findSplit(const Bin *bins, const math::Bounds3D &centroids,
+                  uint32_t count) const {
+    auto binCount = settings_.bins;
+    Split best;
+    for (int axis = 0; axis < 3; axis++) {
+      if (!(centroids.hi[axis] - centroids.lo[axis] > 0.0F)) {
+        continue;
+      }
+      const auto *axisBins = bins + axis * binCount;
+      float rightCost[MaxBins];
+      math::Bounds3D right;
+      uint32_t rightCount = 0;
+      for (auto b = binCount - 1; b > 0; b--) {
+        right.expand(axisBins[b].bounds);
+        rightCount += axisBins[b].count;
+        rightCost[b] = right.surfaceArea() * rightCount;
+      }
+      math::Bounds3D left;
+      uint32_t leftCount = 0;
+      for (int b = 0; b < binCount - 1; b++) {
+        left.expand(axisBins[b].bounds);
+        leftCount += axisBins[b].count;
+        if (leftCount == 0 || leftCount == count) {
+          continue;
+        }
+        auto cost = left.surfaceArea() * leftCount + rightCost[b + 1];
+        if (cost < best.cost) {
+          best = {axis, b, cost};
+        }
+      }
+    }
+    return best;
+  }
+
+  bool shouldSplit(uint32_t count, int depth, const math::Bounds3D &bounds,
+                   const Split &split) const {
+    if (count == 1 || (depth >= MaxDepth && count <= UINT16_MAX)) {
+      return false;
+    }
+    if (count > static_cast<uint32_t>(settings_.maxLeafSize)) {
+      return true;
+    }
+    // SAH costs are compared scaled by the node area, which avoids dividing
+    // by zero for flat nodes
+    auto area = bounds.surfaceArea();
+    return settings_.traversalCost * area + split.cost <
+           static_cast<float>(count) * area;
+  }
+
+  // stable two-way partition; large ranges count per chunk, scatter into a
+  // scratch array and copy back, all across the workers
+  uint32_t partition(uint32_t begin, uint32_t end, size_t chunks,
+                     const Side &side) {
+    if (chunks == 1) {
+      auto it = std::stable_partition(primitives_.begin() + begin,
+                                      primitives_.begin() + end, side);
+      return static_cast<uint32_t>(it - primitives_.begin());
+    }
+    std::vector<uint32_t> leftCounts(chunks, 0);
+    runChunks(pool_, chunks, [&](size_t c) {
+      for (auto i = chunkBegin(begin, end, c, chunks),
+                e = chunkBegin(begin, end, c + 1, chunks);
+           i < e; i++) {
+        leftCounts[c] += side(primitives_[i]);
+      }
+    });
+    uint32_t leftTotal = 0;
+    std::vector<uint32_t> leftStart(chunks);
+    std::vector<uint32_t> rightStart(chunks);
+    for (size_t c = 0; c < chunks; c++) {
+      leftStart[c] = leftTotal;
+      leftTotal += leftCounts[c];
+    }
+    for (size_t c = 0; c < chunks; c++) {
+      rightStart[c] = leftTotal + chunkBegin(0, end - begin, c, chunks) -
+                      leftStart[c];
+    }
+
+    scratch_.resize(end - begin);
+    runChunks(pool_, chunks, [&](size_t c) {
+      auto l = leftStart[c];
+      auto r = rightStart[c];
+      for (auto i = chunkBegin(begin, end, c, chunks),
+                e = chunkBegin(begin, end, c + 1, chunks);
+           i < e; i++) {
+        scratch_[side(primitives_[i]) ? l++ : r++] = primitives_[i];
+      }
+    });
+    runChunks(pool_, chunks, [&](size_t c) {
+      auto b = chunkBegin(0, end - begin, c, chunks);
+      auto e = chunkBegin(0, end - begin, c + 1, chunks);
+      std::copy(scratch_.begin() + b, scratch_.begin() + e,
+                primitives_.begin() + begin + b);
+    });
+    return begin + leftTotal;
+  }
+
+  std::vector<BuildPrimitive> scratch_;
+};
+
+/**
+ * @brief Linear BVH: primitives are sorted along a Morton curve through
+ * their centroids and every node splits its range where the codes first
+ * differ, so building a level is a binary search rather than a sweep.
+ */
+class LBVHBuilder : public Builder {
+public:
+  LBVHBuilder(std::vector<BuildPrimitive> &primitives,
+              const BVHSettings &settings, ThreadPool *pool)
+      : Builder(primitives, settings, pool) {
+    sortByMortonCode();
+  }
+
+protected:
+  uint32_t buildSerial(std::vector<BVH::Node> &nodes, uint32_t begin,
+                       uint32_t end, int depth) override {
+    auto index = static_cast<uint32_t>(nodes.size());
+    nodes.push_back({math::Bounds3D(), begin, 0, 0});
+    BVH::Node &node = nodes.back();
+    uint32_t mid;
+    if (!split(begin, end, depth, node, &mid)) {
+      return index;
+    }
+    buildSerial(nodes, begin, mid, depth + 1);
+    auto second = buildSerial(nodes, mid, end, depth + 1);
+    nodes[index].offset = second;
+    nodes[index].bounds =
+        merge(nodes[index + 1].bounds, nodes[second].bounds);
+    return index;
+  }
+
+  bool splitTop(uint32_t begin, uint32_t end, int depth, BVH::Node &node,
+                uint32_t *mid) override {
+    return split(begin, end, depth, node, mid);
+  }
+
+private:
+  bool split(uint32_t begin, uint32_t end, int depth, BVH::Node &node,
+             uint32_t *mid) {
+    auto count = end - begin;
+    if (count <= static_cast<uint32_t>(settings_.maxLeafSize) ||
+        (depth >= MaxDepth && count <= UINT16_MAX)) {
+      node.bounds = leafBounds(begin, end);
+      node.count = static_cast<uint16_t>(count);
+      return false;
+    }
+
+    auto first = codes_[begin];
+    auto last = codes_[end - 1];
+    if (first == last || depth >= MaxDepth) {
+      *mid = begin + count / 2;
+      return true;
+    }
+
+    // codes are sorted and share every bit above the highest differing one,
+    // so the range splits where that bit turns on
+    auto diff = first ^ last;
+    int bit = 31;
+    while (!(diff & (1U << bit))) {
+      bit--;
+    }
+    auto mask = 1U << bit;
+    auto it = std::partition_point(
+        codes_.begin() + begin, codes_.begin() + end,
+        [mask](uint32_t code) { return !(code & mask); });
+    *mid = static_cast<uint32_t>(it - codes_.begin());
+    // bits interleave as x, y, z from the top of every triple
+    node.axis = static_cast<uint16_t>(2 - bit % 3);
+    return true;
+  }
+
+  void sortByMortonCode(void) {
+    auto count = static_cast<uint32_t>(primitives_.size());
+    auto chunks = chunksFor(count);
+
+    std::vector<RangeBounds> ranges(chunks);
+    runChunks(pool_, chunks, [&](size_t c) {
+      for (auto i = chunkBegin(0, count, c, chunks),
+                e = chunkBegin(0, count, c + 1, chunks);
+           i < e; i++) {
+        ranges[c].add(primitives_[i]);
+      }
+    });
+    for (size_t c = 1; c < chunks; c++) {
+      ranges[0].add(ranges[c]);
+    }
+    const auto &centroids = ranges[0].centroids;
+
+    float scale[3];
+    for (int axis = 0; axis < 3; axis++) {
+      auto extent = centroids.hi[axis] - centroids.lo[axis];
+      scale[axis] = extent > 0.0F ? 1023.0F / extent : 0.0F;
+    }
+    std::vector<uint32_t> codes(count);
+    std::vector<uint32_t> order(count);
+    runChunks(pool_, chunks, [&](size_t c) {
+      for (auto i = chunkBegin(0, count, c, chunks),
+                e = chunkBegin(0, count, c + 1, chunks);
+           i < e; i++) {
+        uint32_t q[3];
+        for (int axis = 0; axis < 3; axis++) {
+          auto v = (primitives_[i].centroid[axis] - centroids.lo[axis]) *
+                   scale[axis];
+          q[axis] = std::min(static_cast<uint32_t>(v), 1023U);
+        }
+        codes[i] = math::encodeMorton3(q[0], q[1], q[2]);
+        order[i] = i;
+      }
+    });
+
+    radixSort(codes, order, chunks);
+
+    std::vector<BuildPrimitive> sorted(count);
+    runChunks(pool_, chunks, [&](size_t c) {
+      for (auto i = chunkBegin(0, count, c, chunks),
+                e = chunkBegin(0, count, c + 1, chunks);
+           i < e; i++) {
+        sorted[i] = primitives_[order[i]];
+      }
+    });
+    primitives_.swap(sorted);
+    codes_.swap(codes);
+  }
+
+  // least-significant-digit radix sort of the 30-bit codes, three 10-bit
+  // digits; every chunk histograms and scatters its own slice
+  void radixSort(std::vector<uint32_t> &codes, std::vector<uint32_t> &order,
+                 size_t chunks) {
+    constexpr int DigitBits = 10;
+    constexpr uint32_t Buckets = 1U << DigitBits;
+    auto count = static_cast<uint32_t>(codes.size());
+    std::vector<uint32_t> codesOut(count);
+    std::vector<uint32_t> orderOut(count);
+    std::vector<uint32_t> histogram(chunks * Buckets);
+
+    for (int shift = 0; shift < 30; shift += DigitBits) {
+      std::fill(histogram.begin(), histogram.end(), 0);
+      runChunks(pool_, chunks, [&](size_t c) {
+        auto *h = histogram.data() + c * Buckets;
+        for (auto i = chunkBegin(0, count, c, chunks),
+                  e = chunkBegin(0, count, c + 1, chunks);
+             i < e; i++) {
+          h[(codes[i] >> shift) & (Buckets - 1)]++;
+        }
+      });
+      // exclusive prefix sum, bucket-major so equal digits keep chunk order
+      uint32_t sum = 0;
+      for (uint32_t b = 0; b < Buckets; b++) {
+        for (size_t c = 0; c < chunks; c++) {
+          auto n = histogram[c * Buckets + b];
+          histogram[c * Buckets + b] = sum;
+          sum += n;
+        }
+      }
+      runChunks(pool_, chunks, [&](size_t c) {
+        auto *h = histogram.data() + c * Buckets;
+        for (auto i = chunkBegin(0, count, c, chunks),
+                  e = chunkBegin(0, count, c + 1, chunks);
+             i < e; i++) {
+          auto to = h[(codes[i] >> shift) & (Buckets - 1)]++;
+          codesOut[to] = codes[i];
+          orderOut[to] = order[i];
+        }
+      });
+      codes.swap(codesOut);
+      order.swap(orderOut);
+    }
+  }
+
+  std::vector<uint32_t> codes_;
+};
+
+// threads == 0 means the shared pool, 1 means the calling thread. A build
+// started from inside the pool uses it too: the waiting worker runs the
+// build's own jobs rather than blocking
+ThreadPool *selectPool(const BVHSettings &settings,
+                       std::unique_ptr<ThreadPool> &ownPool) {
+  ThreadPool *pool = nullptr;
+  if (settings.threads == 0) {
+    pool = &ThreadPool::getDefault();
+  } else if (settings.threads > 1) {
+    ownPool = std::make_unique<ThreadPool>(settings.threads);
+    pool = ownPool.get();
+  }
+  if (pool && pool->size() < 2) {
+    pool = nullptr;
+  }
+  return pool;
+}
+} // namespace
+
+BVH::BVH(const std::vector<const Shape *> &shapes,
+         const BVHSettings &settings) {
+  build(shapes, settings);
+}
+
+void BVH::build(const std::vector<const Shape *> &shapes,
+                const BVHSettings &settings) {
+  nodes_.clear();
+  primitives_.clear();
+  unbounded_.clear();
+  store_.clear();
+  refs_.clear();
+  unboundedRefs_.clear();
+
+  std::unique_ptr<ThreadPool> ownPool;
+  auto pool = selectPool(settings, ownPool);
+  auto count = static_cast<uint32_t>(shapes.size());
+  std::vector<math::Bounds3D> bounds(count);
+  auto chunks = pool && count >= ParallelGrain ? pool->size() : 1;
+  runChunks(pool, chunks, [&](size_t c) {
+    for (auto i = chunkBegin(0, count, c, chunks),
+              e = chunkBegin(0, count, c + 1, chunks);
+         i < e; i++) {
+      bounds[i] = shapes[i]->bounds();
+    }
+  });
+
+  std::vector<math::Bounds3D> finite;
+  std::vector<const Shape *> bounded;
+  finite.reserve(count);
+  bounded.reserve(count);
+  for (uint32_t i = 0; i < count; i++) {
+    if (bounds[i].isEmpty()) {
+      continue;
+    }
+    if (!bounds[i].isFinite()) {
+      unbounded_.push_back(shapes[i]);
+      continue;
+    }
+    finite.push_back(bounds[i]);
+    bounded.push_back(shapes[i]);
+  }
+
+  auto order = buildNodes(finite, settings, nodes_);
+  primitives_.reserve(order.size());
+  for (auto i : order) {
+    primitives_.push_back(bounded[i]);
+  }
+  packShapes(settings.storage);
+}
+
+void BVH::packShapes(ShapeStorage storage) {
+  // group each leaf's shapes, and the unbounded ones, by type so that they
+  // land next to each other in the store and can be tested as runs
+  if (storage == ShapeStorage::Packed) {
+    auto byType = [](const Shape *a, const Shape *b) {
+      return ShapeStore::classify(*a) < ShapeStore::classify(*b);
+    };
+    for (const auto &node : nodes_) {
+      if (node.count > 0) {
+        auto first = primitives_.begin() + node.offset;
+        std::stable_sort(first, first + node.count, byType);
+      }
+    }
+    std::stable_sort(unbounded_.begin(), unbounded_.end(), byType);
+  }
+
+  refs_.reserve(primitives_.size());
+  for (auto shape : primitives_) {
+    refs_.push_back(store_.add(*shape, storage));
+  }
+  unboundedRefs_.reserve(unbounded_.size());
+  for (auto shape : unbounded_) {
+    unboundedRefs_.push_back(store_.add(*shape, storage));
+  }
+}
+
+std::vector<uint32_t>
+BVH::buildNodes(const std::vector<math::Bounds3D> &bounds,
+                const BVHSettings &settings, std::vector<Node> &nodes) {
+  if (settings.bins < 2 || settings.bins > MaxBins ||
+      settings.maxLeafSize < 1) {
+    throw std::runtime_error("Invalid BVH settings");
+  }
+  nodes.clear();
+  if (bounds.empty()) {
+    return {};
+  }
+
+  std::unique_ptr<ThreadPool> ownPool;
+  auto pool = selectPool(settings, ownPool);
+  std::vector<BuildPrimitive> build(bounds.size());
+  for (uint32_t i = 0; i < build.size(); i++) {
+    build[i].bounds = bounds[i];
+    for (int axis = 0; axis < 3; axis++) {
+      build[i].centroid[axis] =
+          0.5F * (bounds[i].lo[axis] + bounds[i].hi[axis]);
+    }
+    build[i].index = i;
+  }
+
+  if (settings.method == BVHBuildMethod::LBVH) {
+    LBVHBuilder(build, settings, pool).build(nodes);
+  } else {
+    SAHBuilder(build, settings, pool).build(nodes);
+  }
+  std::vector<uint32_t> order;
+  order.reserve(build.size());
+  for (const auto &p : build) {
+    order.push_back(p.index);
+  }
+  return order;
+}
+
+template <typename Test>
+bool BVH::traverse(const PackedRay &ray, float tMin, const float *tMax,
+                   Test &test) const {
+  const auto *origin = ray.origin;
+  const auto *d = ray.direction;
+  float invDirection[3] = {1.0F / d[0], 1.0F / d[1], 1.0F / d[2]};
+
+  uint32_t stack[BVH::StackSize];
+  int size = 0;
+  uint32_t index = 0;
+  for (;;) {
+    const auto &node = nodes_[index];
+    if (math::slabTest(node.bounds, origin, invDirection, tMin, *tMax)) {
+      if (node.count > 0) {
+        if (test(&refs_[node.offset], node.count)) {
+          return true;
+        }
+      } else {
+        // descend into the child on the near side of the split axis first
+        if (invDirection[node.axis] < 0.0F) {
+          stack[size++] = index + 1;
+          index = node.offset;
+        } else {
+          stack[size++] = node.offset;
+          index = index + 1;
+        }
+        continue;
+      }
+    }
+    if (size == 0) {
+      break;
+    }
+    index = stack[--size];
+  }
+  return false;
+}
+
+bool BVH::closestHit(const math::Ray &ray, float tMin, float tMax,
+                     Intersection *closest) const {
+  PackedRay packed(ray);
+  ShapeStore::Ref hit;
+  auto found = false;
+  // entries of one type next to each other have consecutive store indices
+  auto test = [&](const ShapeStore::Ref *refs, uint32_t count) {
+    for (uint32_t i = 0; i < count;) {
+      auto type = refs[i].type;
+      uint32_t run = 1;
+      while (i + run < count && refs[i + run].type == type) {
+        run++;
+      }
+      uint32_t index;
+      if (store_.closestHit(type, refs[i].index, run, packed, tMin, &tMax,
+                            &index)) {
+        hit = {type, index};
+        found = true;
+      }
+      i += run;
+    }
+    return false;
+  };
+  test(unboundedRefs_.data(), static_cast<uint32_t>(unboundedRefs_.size()));
+  if (!nodes_.empty()) {
+    traverse(packed, tMin, &tMax, test);
+  }
+  if (found) {
+    *closest = {tMax, store_.getShape(hit)};
+  }
+  return found;
+}
+
+bool BVH::occluded(const math::Ray &ray, float tMin, float tMax) const {
+  PackedRay packed(ray);
+  auto test = [&](const ShapeStore::Ref *refs, uint32_t count) {
+    for (uint32_t i = 0; i < count;) {
+      auto type = refs[i].type;
+      uint32_t run = 1;
+      while (i + run < count && refs[i + run].type == type) {
+        run++;
+      }
+      if (store_.anyHit(type, refs[i].index, run, packed, tMin, tMax)) {
+        return true;
+      }
+      i += run;
+    }
+    return false;
+  };
+  if (test(unboundedRefs_.data(),
+           static_cast<uint32_t>(unboundedRefs_.size()))) {
+    return true;
+  }
+  return !nodes_.empty() && traverse(packed, tMin, &tMax, test);
+}
+
+template <typename FloatT, typename Test>
+void BVH::traversePacket(const math::RayPacket<FloatT> &packet,
+                         typename FloatT::Mask *active, Test &test) const {
+  // near-first order follows the first live lane; coherent lanes mostly
+  // agree on it and the order only affects speed
+  int lane = 0;
+  while (!(*active)[lane]) {
+    lane++;
+  }
+  bool negative[3] = {packet.idx[lane] < 0.0F, packet.idy[lane] < 0.0F,
+                      packet.idz[lane] < 0.0F};
+
+  uint32_t stack[BVH::StackSize];
+  int size = 0;
+  uint32_t index = 0;
+  for (;;) {
+    const auto &node = nodes_[index];
+    FloatT tNear;
+    auto lanes = math::intersectBox(packet, node.bounds, *active, &tNear);
+    if (any(lanes)) {
+      if (node.count > 0) {
+        test(&refs_[node.offset], node.count, lanes);
+        if (none(*active)) {
+          return;
+        }
+      } else {
+        if (negative[node.axis]) {
+          stack[size++] = index + 1;
+          index = node.offset;
+        } else {
+          stack[size++] = node.offset;
+          index = index + 1;
+        }
+        continue;
+      }
+    }
+    if (size == 0) {
+      break;
+    }
+    index = stack[--size];
+  }
+}
+
+template <typename FloatT>
+typename FloatT::Mask BVH::closestHit(const math::RayPacket<FloatT> &packet,
+                                      Intersection *hits) const {
+  using Mask = typename FloatT::Mask;
+  constexpr int Width = FloatT::Width;
+  auto local = packet;
+  auto active = local.valid();
+  auto found = Mask(false);
+  if (none(active)) {
+    return found;
+  }
+  ShapeType hitType[Width];
+  uint32_t hitIndex[Width];
+  auto test = [&](const ShapeStore::Ref *refs, uint32_t count, Mask lanes) {
+    for (uint32_t i = 0; i < count;) {
+      auto type = refs[i].type;
+      uint32_t run = 1;
+      while (i + run < count && refs[i + run].type == type) {
+        run++;
+      }
+      uint32_t index[Width];
+      auto hit = store_.closestHit(type, refs[i].index, run, local, lanes,
+                                   index);
+      for (int lane = 0; lane < Width; lane++) {
+        if (hit[lane]) {
+          hitType[lane] = type;
+          hitIndex[lane] = index[lane];
+        }
+      }
+      found = found | hit;
+      i += run;
+    }
+  };
+  test(unboundedRefs_.data(), static_cast<uint32_t>(unboundedRefs_.size()),
+       active);
+  if (!nodes_.empty()) {
+    traversePacket(local, &active, test);
+  }
+  for (int lane = 0; lane < Width; lane++) {
+    if (found[lane]) {
+      hits[lane] = {local.tMax[lane],
+                    store_.getShape({hitType[lane], hitIndex[lane]})};
+    }
+  }
+  return found;
+}
+
+template <typename FloatT>
+typename FloatT::Mask
+BVH::occluded(const math::RayPacket<FloatT> &packet) const {
+  using Mask = typename FloatT::Mask;
+  auto active = packet.valid();
+  auto blocked = Mask(false);
+  auto test = [&](const ShapeStore::Ref *refs, uint32_t count, Mask lanes) {
+    for (uint32_t i = 0; i < count && any(lanes);) {
+      auto type = refs[i].type;
+      uint32_t run = 1;
+      while (i + run < count && refs[i + run].type == type) {
+        run++;
+      }
+      auto hit = store_.anyHit(type, refs[i].index, run, packet, lanes);
+      blocked = blocked | hit;
+      lanes = andNot(lanes, hit);
+      active = andNot(active, hit);
+      i += run;
+    }
+  };
+  if (none(active)) {
+    return blocked;
+  }
+  test(unboundedRefs_.data(), static_cast<uint32_t>(unboundedRefs_.size()),
+       active);
+  if (!nodes_.empty() && any(active)) {
+    traversePacket(packet, &active, test);
+  }
+  return blocked;
+}
+
+template math::simd::Mask4
+BVH::closestHit(const math::RayPacket4 &, Intersection *) const;
+template math::simd::Mask8
+BVH::closestHit(const math::RayPacket8 &, Intersection *) const;
+template math::simd::Mask4 BVH::occluded(const math::RayPacket4 &) const;
+template math::simd::Mask8 BVH::occluded(const math::RayPacket8 &) const;
+
+void BVH::intersectAll(const math::Ray &ray,
+                       std::vector<Intersection> &xs) const {
+  PackedRay packed(ray);
+  auto test = [&](const Shape *shape, ShapeStore::Ref ref) {
+    float ts[MaxShapeHits];
+    auto count = store_.intersect(ref, packed, ts);
+    for (int i = 0; i < count; i++) {
+      xs.push_back({ts[i], shape});
+    }
+  };
+  for (size_t i = 0; i < unbounded_.size(); i++) {
+    test(unbounded_[i], unboundedRefs_[i]);
+  }
+  if (nodes_.empty()) {
+    return;
+  }
+
+  // hits behind the origin are wanted too (refraction needs them to know
+  // which objects the ray starts inside), so the boxes are tested against
+  // the whole line
+  const auto *origin = packed.origin;
+  const auto *d = packed.direction;
+  float invDirection[3] = {1.0F / d[0], 1.0F / d[1], 1.0F / d[2]};
+
+  uint32_t stack[BVH::StackSize];
+  int size = 0;
+  uint32_t index = 0;
+  for (;;) {
+    const auto &node = nodes_[index];
+    if (math::slabTest(node.bounds, origin, invDirection, -INFINITY,
+                       INFINITY)) {
+      if (node.count > 0) {
+        for (uint32_t i = node.offset; i < node.offset + node.count; i++) {
+          test(primitives_[i], refs_[i]);
+        }
+      } else {
+        stack[size++] = node.offset;
+        index = index + 1;
+        continue;
+      }
+    }
+    if (size == 0) {
+      break;
+    }
+    index = stack[--size];
+  }
+}
+
+const std::vector<BVH::Node> &BVH::getNodes(void) const { return nodes_; }
+
+const std::vector<const Shape *> &BVH::getPrimitives(void) const {
+  return primitives_;
+}
+
+const std::vector<const Shape *> &BVH::getUnbounded(void) const {
+  return unbounded_;
+}
+
+math::Bounds3D BVH::bounds(void) const {
+  return nodes_.empty() ? math::Bounds3D() : nodes_[0].bounds;
+}
+} // namespace raytracer
+} // namespace liby
@@ -0,0 +1,164 @@
+#pragma once
+
+#include "bounds3D.hpp"
+#include "ray.hpp"
+#include "shapeStore.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace liby {
+namespace raytracer {
+class Shape;
+struct Intersection;
+
+enum class BVHBuildMethod {
+  // binned surface area heuristic; the best trees, the slowest build
+  BinnedSAH,
+  // linear BVH split along Morton-code prefixes; a fraction of the build
+  // time for trees that are slower to traverse, meant for interactive rebuilds
+  LBVH,
+};
+
+struct BVHSettings {
+  BVHBuildMethod method = BVHBuildMethod::BinnedSAH;
+  // worker threads used for the build; zero uses the shared pool sized to the
+  // cores and one builds on the calling thread
+  unsigned int threads = 0;
+  // number of centroid bins evaluated per axis at every SAH split; fewer bins
+  // build faster and give slightly worse trees
+  int bins = 16;
+  // leaves hold no more primitives than this, except at the depth cap,
+  // where up to UINT16_MAX are left in one leaf
+  int maxLeafSize = 4;
+  // cost of visiting a node relative to testing one primitive
+  float traversalCost = 1.0F;
+  // how leaves test their shapes; see ShapeStore
+  ShapeStorage storage = ShapeStorage::Packed;
+};
+
+/**
+ * @brief Bounding-volume hierarchy over a set of shapes, built with binned
+ * SAH or as an LBVH (see BVHSettings). The top of the tree is split on the
+ * calling thread, with binning, partitioning and sorting of large ranges
+ * spread over the workers; the subtrees below are built as parallel tasks.
+ *
+ * Nodes are stored depth-first in a single array: an interior node's first
+ * child immediately follows it and `offset` holds the index of the second
+ * child; a leaf covers `count` entries of the primitive array starting at
+ * `offset`. Shapes without finite bounds (planes, open cylinders) cannot be
+ * placed in the tree and are tested against every ray instead.
+ *
+ * With ShapeStorage::Packed the shapes of each leaf are grouped by type and
+ * copied, in leaf order, into a ShapeStore; a leaf is then tested as a few
+ * runs of one type each. The BVH must be rebuilt when its shapes move.
+ */
+class BVH {
+public:
+  // depth of the stack a traversal needs; no tree is built deeper than this
+  static constexpr int StackSize = 80;
+
+  struct Node {
+    math::Bounds3D bounds;
+    uint32_t offset;
+    uint16_t count;
+    uint16_t axis;
+  };
+
+  BVH() = default;
+  explicit BVH(const std::vector<const Shape *> &shapes,
+               const BVHSettings &settings = BVHSettings());
+
+  void build(const std::vector<const Shape *> &shapes,
+             const BVHSettings &settings = BVHSettings());
+
+  /**
+   * @brief Finds the closest intersection with t in [tMin, tMax) without
+   * building a list of hits. Children are visited front to back and
+   * subtrees that start beyond the closest hit found so far are skipped.
+   * Returns false, leaving closest alone, if nothing was hit.
+   */
+  bool closestHit(const math::Ray &ray, float tMin, float tMax,
+                  Intersection *closest) const;
+
+  /**
+   * @brief Returns true if anything crosses ray with t in [tMin, tMax).
+   * Traversal stops at the first such hit, and no distance or shape is
+   * reported, which makes it the cheap query for shadow rays.
+   */
+  bool occluded(const math::Ray &ray, float tMin, float tMax) const;
+
+  /**
+   * @brief Packet form of closestHit() for coherent rays such as camera rays
+   * from neighbouring pixels. The lanes walk the tree together on one
+   * stack, each clipped to its own [tMin, tMax), and a node is entered when
+   * any lane's slab test passes. Returns the lanes that hit something and
+   * fills hits[lane] for them; other entries of hits are left alone.
+   */
+  template <typename FloatT>
+  typename FloatT::Mask closestHit(const math::RayPacket<FloatT> &packet,
+                                   Intersection *hits) const;
+
+  /**
+   * @brief Packet form of occluded(); returns the blocked lanes. Lanes drop
+   * out as they are found blocked and the walk ends when none are left.
+   */
+  template <typename FloatT>
+  typename FloatT::Mask occluded(const math::RayPacket<FloatT> &packet) const;
+
+  /**
+   * @brief Appends every intersection of ray, in no particular order. xs is
+   * only ever appended to, so callers can reuse one buffer across rays.
+   */
+  void intersectAll(const math::Ray &ray,
+                    std::vector<Intersection> &xs) const;
+
+  /**
+   * @brief Builds a node array over arbitrary boxes, which must be finite
+   * and non-empty, and returns the indices into bounds in leaf order. Leaves
+   * refer to positions in the returned array.
+   */
+  static std::vector<uint32_t>
+  buildNodes(const std::vector<math::Bounds3D> &bounds,
+             const BVHSettings &settings, std::vector<Node> &nodes);
+
+  const std::vector<Node> &getNodes(void) const;
+  const std::vector<const Shape *> &getPrimitives(void) const;
+  const std::vector<const Shape *> &getUnbounded(void) const;
+
+  /**
+   * @brief Returns the bounds of everything in the tree; empty if the tree
+   * holds no bounded shape.
+   */
+  math::Bounds3D bounds(void) const;
+
+private:
+  void packShapes(ShapeStorage storage);
+
+  /**
+   * @brief Walks the nodes ray crosses in [tMin, *tMax) front to back and
+   * hands each leaf's entries of refs_ to test, which may lower *tMax.
+   * Stops and returns true as soon as test does.
+   */
+  template <typename Test>
+  bool traverse(const PackedRay &ray, float tMin, const float *tMax,
+                Test &test) const;
+
+  /**
+   * @brief Packet form of traverse(). test gets each reached leaf and the
+   * lanes whose slab test passed, and may clear lanes of *active; the walk
+   * stops once no lane is left.
+   */
+  template <typename FloatT, typename Test>
+  void traversePacket(const math::RayPacket<FloatT> &packet,
+                      typename FloatT::Mask *active, Test &test) const;
+
+  std::vector<Node> nodes_;
+  std::vector<const Shape *> primitives_;
+  std::vector<const Shape *> unbounded_;
+  // primitives_ and unbounded_ as entries of store_, index for index
+  ShapeStore store_;
+  std::vector<ShapeStore::Ref> refs_;
+  std::vector<ShapeStore::Ref> unboundedRefs_;
+};
+} // namespace raytracer
+} // namespace liby
@@ -0,0 +1,61 @@
+#include "camera.hpp"
+#include <cmath>
+
+namespace liby {
+namespace raytracer {
+Camera::Camera(int hsize, int vsize, float fieldOfView,
+               const math::Transform4D &transform)
+    : hsize_(hsize), vsize_(vsize), fieldOfView_(fieldOfView),
+      transform_(transform), inverse_(inverse(transform)) {
+  auto halfView = std::tan(fieldOfView / 2.0F);
+  auto aspect = static_cast<float>(hsize) / static_cast<float>(vsize);
+  if (aspect >= 1.0F) {
+    halfWidth_ = halfView;
+    halfHeight_ = halfView / aspect;
+  } else {
+    halfWidth_ = halfView * aspect;
+    halfHeight_ = halfView;
+  }
+  pixelSize_ = halfWidth_ * 2.0F / static_cast<float>(hsize);
+}
+
+int Camera::getHsize(void) const { return hsize_; }
+int Camera::getVsize(void) const { return vsize_; }
+float Camera::getFieldOfView(void) const { return fieldOfView_; }
+float Camera::getPixelSize(void) const { return pixelSize_; }
+const math::Transform4D &Camera::getTransform(void) const { return transform_; }
+
+void Camera::setTransform(const math::Transform4D &transform) {
+  transform_ = transform;
+  inverse_ = inverse(transform);
+}
+
+math::Ray Camera::rayForPixel(int x, int y) const {
+  return rayThrough(static_cast<float>(x) + 0.5F,
+                    static_cast<float>(y) + 0.5F);
+}
+
+math::Ray Camera::rayThrough(float x, float y) const {
+  // the camera looks down -z, so +x in world space is to the left
+  auto worldX = halfWidth_ - x * pixelSize_;
+  auto worldY = halfHeight_ - y * pixelSize_;
+  auto pixel = inverse_ * math::Point3D(worldX, worldY, -1.0F);
+  auto origin = inverse_ * math::Point3D(0.0F, 0.0F, 0.0F);
+  return math::Ray(origin, normalize(pixel - origin));
+}
+
+math::Transform4D Camera::viewTransform(const math::Point3D &from,
+                                        const math::Point3D &to,
+                                        const math::Vector3D &up) {
+  auto forward = normalize(to - from);
+  auto left = cross(forward, normalize(up));
+  auto trueUp = cross(left, forward);
+  math::Transform4D orientation(left.x(), left.y(), left.z(), 0.0F,
+                                trueUp.x(), trueUp.y(), trueUp.z(), 0.0F,
+                                -forward.x(), -forward.y(), -forward.z(),
+                                0.0F);
+  return orientation * math::Transform4D::makeTranslation(
+                           math::Vector3D(-from.x(), -from.y(), -from.z()));
+}
+} // namespace raytracer
+} // namespace liby
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "ray.hpp"
+#include "transform4D.hpp"
+
+namespace liby {
+namespace raytracer {
+/**
+ * @brief Pinhole camera. The canvas sits one unit in front of the eye and
+ * transform maps world space into camera space, as built by viewTransform().
+ */
+class Camera {
+public:
+  Camera(int hsize, int vsize, float fieldOfView,
+         const math::Transform4D &transform =
+             math::Transform4D(math::Matrix4D::identity()));
+
+  int getHsize(void) const;
+  int getVsize(void) const;
+  float getFieldOfView(void) const;
+  float getPixelSize(void) const;
+  const math::Transform4D &getTransform(void) const;
+  void setTransform(const math::Transform4D &transform);
+
+  /**
+   * @brief Returns the world-space ray through the center of pixel (x, y).
+   */
+  math::Ray rayForPixel(int x, int y) const;
+
+  /**
+   * @brief Returns the world-space ray through the canvas position (x, y),
+   * measured in pixels from the top-left corner.
+   */
+  math::Ray rayThrough(float x, float y) const;
+
+  /**
+   * @brief Returns the transform that looks from `from` towards `to` with up
+   * roughly pointing along `up`.
+   */
+  static math::Transform4D viewTransform(const math::Point3D &from,
+                                         const math::Point3D &to,
+                                         const math::Vector3D &up);
+
+private:
+  int hsize_;
+  int vsize_;
+  float fieldOfView_;
+  float halfWidth_;
+  float halfHeight_;
+  float pixelSize_;
+  math::Transform4D transform_;
+  math::Transform4D inverse_;
+};
+} // namespace raytracer
+} // namespace liby
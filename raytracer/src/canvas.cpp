@@ -0,0 +1,72 @@
+#include "canvas.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+namespace liby {
+namespace raytracer {
+namespace {
+int toByte(float c) {
+  return static_cast<int>(std::lround(std::clamp(c, 0.0F, 1.0F) * 255.0F));
+}
+} // namespace
+
+Canvas::Canvas(int width, int height)
+    : width_(width), height_(height), layout_(width, height),
+      pixels_(layout_.getSize(), math::RGBA(0.0F, 0.0F, 0.0F)) {}
+
+int Canvas::getWidth(void) const { return width_; }
+int Canvas::getHeight(void) const { return height_; }
+
+void Canvas::writePixel(int x, int y, const math::RGBA &color) {
+  if (x < 0 || x >= width_ || y < 0 || y >= height_) {
+    throw std::runtime_error("Index out of bounds");
+  }
+  pixels_[layout_.index(x, y)] = color;
+}
+
+const math::RGBA &Canvas::pixelAt(int x, int y) const {
+  if (x < 0 || x >= width_ || y < 0 || y >= height_) {
+    throw std::runtime_error("Index out of bounds");
+  }
+  return pixels_[layout_.index(x, y)];
+}
+
+std::vector<math::RGBA> Canvas::getRows(void) const {
+  std::vector<math::RGBA> rows;
+  rows.reserve(static_cast<size_t>(width_) * height_);
+  for (int y = 0; y < height_; y++) {
+    for (int x = 0; x < width_; x++) {
+      rows.push_back(pixels_[layout_.index(x, y)]);
+    }
+  }
+  return rows;
+}
+
+void Canvas::writePPM(std::ostream &out) const {
+  out << "P3\n" << width_ << " " << height_ << "\n255\n";
+  for (int y = 0; y < height_; y++) {
+    // PPM readers expect lines of at most 70 characters
+    size_t column = 0;
+    for (int x = 0; x < width_; x++) {
+      const auto &c = pixels_[layout_.index(x, y)];
+      for (auto v : {c.r(), c.g(), c.b()}) {
+        auto s = std::to_string(toByte(v));
+        if (column + s.size() + 1 > 70) {
+          out << "\n";
+          column = 0;
+        }
+        if (column > 0) {
+          out << " ";
+          column++;
+        }
+        out << s;
+        column += s.size();
+      }
+    }
+    out << "\n";
+  }
+}
+} // namespace raytracer
+} // namespace liby
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "rgba.hpp"
+#include "tiling.hpp"
+#include <ostream>
+#include <vector>
+
+namespace liby {
+namespace raytracer {
+/**
+ * @brief Grid of linear colors with (0, 0) at the top-left, stored in 8x8
+ * blocks (see BlockLayout) so that the tiles of a render are written to
+ * memory of their own. Rows are put back together only on the way out, by
+ * writePPM() and getRows().
+ */
+class Canvas {
+public:
+  Canvas(int width, int height);
+
+  int getWidth(void) const;
+  int getHeight(void) const;
+  void writePixel(int x, int y, const math::RGBA &color);
+  const math::RGBA &pixelAt(int x, int y) const;
+
+  /**
+   * @brief Returns the pixels row by row, top row first, as an image upload
+   * or file format expects them.
+   */
+  std::vector<math::RGBA> getRows(void) const;
+
+  /**
+   * @brief Writes the canvas as a plain (P3) PPM image, clamping every
+   * channel to [0, 255].
+   */
+  void writePPM(std::ostream &out) const;
+
+private:
+  int width_;
+  int height_;
+  BlockLayout layout_;
+  std::vector<math::RGBA> pixels_;
+};
+} // namespace raytracer
+} // namespace liby
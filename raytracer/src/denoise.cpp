@@ -0,0 +1,296 @@
+#include "denoise.hpp"
+#include "simd.hpp"
+#include "threadPool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+
+namespace liby {
+namespace raytracer {
+namespace {
+#ifdef LIBY_SIMD_AVX
+using Lanes = math::simd::Float8;
+#else
+using Lanes = math::simd::Float4;
+#endif
+
+// B3-spline weights of the 5x5 kernel, outermost tap first
+constexpr int Radius = 2;
+constexpr float Kernel[2 * Radius + 1] = {1.0F / 16.0F, 1.0F / 4.0F,
+                                          3.0F / 8.0F, 1.0F / 4.0F,
+                                          1.0F / 16.0F};
+
+// planes of the guide image: albedo, normal, then depth
+constexpr int AlbedoPlane = 0;
+constexpr int NormalPlane = 3;
+constexpr int DepthPlane = 6;
+constexpr int GuidePlanes = 7;
+
+ThreadPool &poolFor(unsigned int threads, std::unique_ptr<ThreadPool> &own) {
+  if (threads != 0) {
+    own = std::make_unique<ThreadPool>(threads);
+  }
+  return own ? *own : ThreadPool::getDefault();
+}
+
+/**
+ * @brief Image of count float planes. Rows are padded on both sides, and
+ * to whole registers, so that taps up to pad pixels beyond the image and
+ * the last register of a row can be loaded without checks; the padding is
+ * zero and taps landing there are masked out of the sums.
+ */
+class Planes {
+public:
+  Planes(int count, int width, int height, int pad)
+      : height_(height), pad_(pad),
+        stride_(pad + (width + Lanes::Width - 1) / Lanes::Width *
+                          Lanes::Width +
+                pad),
+        data_(static_cast<size_t>(count) * height * stride_, 0.0F) {}
+
+  float *row(int plane, int y) {
+    return &data_[(static_cast<size_t>(plane) * height_ + y) * stride_ +
+                  pad_];
+  }
+  const float *row(int plane, int y) const {
+    return &data_[(static_cast<size_t>(plane) * height_ + y) * stride_ +
+                  pad_];
+  }
+
+private:
+  int height_;
+  int pad_;
+  int stride_;
+  std::vector<float> data_;
+};
+
+/**
+ * @brief e^-x for x >= 0 as (1 - x / 256)^256: multiplies only, and within
+ * a few percent of the real thing wherever the weight still matters.
+ */
+Lanes negExp(Lanes x) {
+  auto y = max(Lanes(1.0F) - x * Lanes(1.0F / 256.0F), Lanes(0.0F));
+  for (int i = 0; i < 8; i++) {
+    y = y * y;
+  }
+  return y;
+}
+
+Lanes squaredDistance(const float *const *p, const float *const *q,
+                      int count, int x) {
+  Lanes sum(0.0F);
+  for (int c = 0; c < count; c++) {
+    auto d = Lanes::load(p[c] + x) - Lanes::load(q[c] + x);
+    sum = sum + d * d;
+  }
+  return sum;
+}
+
+struct PassWeights {
+  int step;
+  // one over the squared sigmas, depth's already divided by the step
+  float color;
+  float albedo;
+  float normal;
+  float depth;
+};
+
+/**
+ * @brief One filter pass over rows [y0, y1) and columns [x0, x1) of the
+ * image, x0 a whole number of registers in.
+ */
+void filterTile(const Planes &in, const Planes &guide, Planes &out,
+                int width, int height, const PassWeights &weights, int x0,
+                int y0, int x1, int y1) {
+  float laneIndex[Lanes::Width];
+  for (int i = 0; i < Lanes::Width; i++) {
+    laneIndex[i] = static_cast<float>(i);
+  }
+  auto lanes = Lanes::load(laneIndex);
+  auto step = weights.step;
+  const float *center[GuidePlanes + 3];
+  const float *tap[GuidePlanes + 3];
+  for (auto y = y0; y < y1; y++) {
+    for (int c = 0; c < 3; c++) {
+      center[c] = in.row(c, y);
+    }
+    for (int g = 0; g < GuidePlanes; g++) {
+      center[3 + g] = guide.row(g, y);
+    }
+    for (auto x = x0; x < x1; x += Lanes::Width) {
+      auto xs = Lanes(static_cast<float>(x)) + lanes;
+      Lanes sum[3] = {Lanes(0.0F), Lanes(0.0F), Lanes(0.0F)};
+      Lanes total(0.0F);
+      for (int dy = -Radius; dy <= Radius; dy++) {
+        auto yq = y + dy * step;
+        if (yq < 0 || yq >= height) {
+          continue;
+        }
+        for (int c = 0; c < 3; c++) {
+          tap[c] = in.row(c, yq);
+        }
+        for (int g = 0; g < GuidePlanes; g++) {
+          tap[3 + g] = guide.row(g, yq);
+        }
+        for (int dx = -Radius; dx <= Radius; dx++) {
+          auto offset = dx * step;
+          auto xq = xs + Lanes(static_cast<float>(offset));
+          auto inside = (xq >= Lanes(0.0F)) &
+                        (xq < Lanes(static_cast<float>(width)));
+          // the center's values are loaded at x and the tap's at x + offset
+          const float *shifted[GuidePlanes + 3];
+          for (int p = 0; p < GuidePlanes + 3; p++) {
+            shifted[p] = tap[p] + offset;
+          }
+          auto distance =
+              squaredDistance(center, shifted, 3, x) *
+                  Lanes(weights.color) +
+              squaredDistance(center + 3 + AlbedoPlane,
+                              shifted + 3 + AlbedoPlane, 3, x) *
+                  Lanes(weights.albedo) +
+              squaredDistance(center + 3 + NormalPlane,
+                              shifted + 3 + NormalPlane, 3, x) *
+                  Lanes(weights.normal) +
+              squaredDistance(center + 3 + DepthPlane,
+                              shifted + 3 + DepthPlane, 1, x) *
+                  Lanes(weights.depth);
+          auto weight = select(inside,
+                               Lanes(Kernel[dy + Radius] *
+                                     Kernel[dx + Radius]) *
+                                   negExp(distance),
+                               Lanes(0.0F));
+          for (int c = 0; c < 3; c++) {
+            sum[c] = sum[c] + weight * Lanes::load(shifted[c] + x);
+          }
+          total = total + weight;
+        }
+      }
+      // lanes past the right edge still pick up taps from the pixels to
+      // their left; write zero there so the padding stays zero
+      auto some = (total > Lanes(0.0F)) &
+                  (xs < Lanes(static_cast<float>(width)));
+      for (int c = 0; c < 3; c++) {
+        select(some, sum[c] / select(some, total, Lanes(1.0F)),
+               Lanes(0.0F))
+            .store(out.row(c, y) + x);
+      }
+    }
+  }
+}
+} // namespace
+
+FeatureBuffers renderFeatures(const Camera &camera, const World &world,
+                              unsigned int threads) {
+  FeatureBuffers features;
+  features.width = camera.getHsize();
+  features.height = camera.getVsize();
+  auto pixels = static_cast<size_t>(features.width) * features.height;
+  for (int c = 0; c < 3; c++) {
+    features.albedo[c].assign(pixels, 0.0F);
+    features.normal[c].assign(pixels, 0.0F);
+  }
+  features.depth.assign(pixels, 0.0F);
+
+  std::unique_ptr<ThreadPool> ownPool;
+  auto &pool = poolFor(threads, ownPool);
+  world.getBVH();
+  pool.parallelFor(features.height, [&](size_t y) {
+    for (int x = 0; x < features.width; x++) {
+      auto ray = camera.rayForPixel(x, static_cast<int>(y));
+      Intersection hit;
+      if (!world.closestHit(ray, 0.0F, INFINITY, &hit)) {
+        continue;
+      }
+      // the refractive indices are not needed, so neither are the other
+      // hits along the ray
+      auto comps = prepareComputations(hit, ray, {});
+      auto albedo = comps.material->colorAt(comps.objectPoint);
+      auto i = y * features.width + x;
+      features.albedo[0][i] = albedo.r();
+      features.albedo[1][i] = albedo.g();
+      features.albedo[2][i] = albedo.b();
+      features.normal[0][i] = comps.normal.x();
+      features.normal[1][i] = comps.normal.y();
+      features.normal[2][i] = comps.normal.z();
+      features.depth[i] = comps.t;
+    }
+  });
+  return features;
+}
+
+Canvas denoise(const Canvas &image, const FeatureBuffers &features,
+               const DenoiseSettings &settings) {
+  auto width = image.getWidth();
+  auto height = image.getHeight();
+  if (features.width != width || features.height != height) {
+    throw std::runtime_error("Feature buffers do not match the image");
+  }
+  if (settings.iterations < 0 || settings.iterations > 12 ||
+      settings.tileSize <= 0 || !(settings.colorSigma > 0.0F) ||
+      !(settings.albedoSigma > 0.0F) || !(settings.normalSigma > 0.0F) ||
+      !(settings.depthSigma > 0.0F)) {
+    throw std::runtime_error("Invalid denoise settings");
+  }
+
+  // the widest pass reaches Radius steps of 2^(iterations - 1)
+  auto pad = Radius << std::max(settings.iterations - 1, 0);
+  Planes guide(GuidePlanes, width, height, pad);
+  Planes color[2] = {Planes(3, width, height, pad),
+                     Planes(3, width, height, pad)};
+  for (auto y = 0; y < height; y++) {
+    for (auto x = 0; x < width; x++) {
+      auto i = static_cast<size_t>(y) * width + x;
+      auto pixel = image.pixelAt(x, y);
+      color[0].row(0, y)[x] = pixel.r();
+      color[0].row(1, y)[x] = pixel.g();
+      color[0].row(2, y)[x] = pixel.b();
+      for (int c = 0; c < 3; c++) {
+        guide.row(AlbedoPlane + c, y)[x] = features.albedo[c][i];
+        guide.row(NormalPlane + c, y)[x] = features.normal[c][i];
+      }
+      guide.row(DepthPlane, y)[x] = features.depth[i];
+    }
+  }
+
+  // tiles a whole number of registers wide
+  auto tileWidth = (settings.tileSize + Lanes::Width - 1) / Lanes::Width *
+                   Lanes::Width;
+  auto tilesX = (width + tileWidth - 1) / tileWidth;
+  auto tilesY = (height + settings.tileSize - 1) / settings.tileSize;
+  std::unique_ptr<ThreadPool> ownPool;
+  auto &pool = poolFor(settings.threads, ownPool);
+  auto inverse2 = [](float sigma) { return 1.0F / (sigma * sigma); };
+  for (int pass = 0; pass < settings.iterations; pass++) {
+    PassWeights weights;
+    weights.step = 1 << pass;
+    weights.color = inverse2(settings.colorSigma) *
+                    static_cast<float>(1 << (2 * pass));
+    weights.albedo = inverse2(settings.albedoSigma);
+    weights.normal = inverse2(settings.normalSigma);
+    weights.depth = inverse2(settings.depthSigma * weights.step);
+    const auto &in = color[pass % 2];
+    auto &out = color[(pass + 1) % 2];
+    pool.parallelFor(tilesX * tilesY, [&](size_t tile) {
+      auto x0 = static_cast<int>(tile % tilesX) * tileWidth;
+      auto y0 = static_cast<int>(tile / tilesX) * settings.tileSize;
+      filterTile(in, guide, out, width, height, weights, x0, y0,
+                 std::min(x0 + tileWidth, width),
+                 std::min(y0 + settings.tileSize, height));
+    });
+  }
+
+  const auto &result = color[settings.iterations % 2];
+  Canvas denoised(width, height);
+  for (auto y = 0; y < height; y++) {
+    for (auto x = 0; x < width; x++) {
+      denoised.writePixel(x, y,
+                          math::RGBA(result.row(0, y)[x],
+                                     result.row(1, y)[x],
+                                     result.row(2, y)[x]));
+    }
+  }
+  return denoised;
+}
+} // namespace raytracer
+} // namespace liby
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "camera.hpp"
+#include "canvas.hpp"
+#include "world.hpp"
+#include <vector>
+
+namespace liby {
+namespace raytracer {
+/**
+ * @brief What the camera ray through each pixel center hits first: the
+ * surface color, the normal facing the camera and the distance along the
+ * ray. Pixels whose ray hits nothing are all zero. Stored plane by plane,
+ * each row-major.
+ */
+struct FeatureBuffers {
+  int width = 0;
+  int height = 0;
+  std::vector<float> albedo[3];
+  std::vector<float> normal[3];
+  std::vector<float> depth;
+};
+
+/**
+ * @brief Fills the feature buffers for camera's image of world, one row per
+ * job on the shared pool or on threads workers of its own.
+ */
+FeatureBuffers renderFeatures(const Camera &camera, const World &world,
+                              unsigned int threads = 0);
+
+struct DenoiseSettings {
+  // filter passes; pass i spaces its 5x5 taps 2^i pixels apart, so five
+  // passes reach 32 pixels out
+  int iterations = 5;
+  // how far apart, as a distance between the values, two pixels' colors,
+  // albedos and normals may be before they stop blending; the color one
+  // halves every pass so later, wider passes only smooth what is left
+  float colorSigma = 1.0F;
+  float albedoSigma = 0.1F;
+  float normalSigma = 0.2F;
+  // allowed depth difference per pixel of tap spacing, in world units
+  float depthSigma = 1.0F;
+  // edge length of the square tiles each pass is split into
+  int tileSize = 32;
+  // number of worker threads; zero uses the shared pool
+  unsigned int threads = 0;
+};
+
+/**
+ * @brief Edge-avoiding à-trous wavelet filter: repeated 5x5 B-spline
+ * blurs with the taps spread twice as far each pass, every tap weighted
+ * down by how much its color and features differ from the center's. Noise
+ * on a surface is smoothed while edges between surfaces, which show up in
+ * the albedo, normal or depth, are kept. Meant for images with few samples
+ * per pixel, such as an early ProgressiveRender preview.
+ */
+Canvas denoise(const Canvas &image, const FeatureBuffers &features,
+               const DenoiseSettings &settings = DenoiseSettings());
+} // namespace raytracer
+} // namespace liby
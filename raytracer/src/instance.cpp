@@ -0,0 +1,187 @@
+#include "instance.hpp"
+#include "world.hpp"
+
+namespace liby {
+namespace raytracer {
+Prototype::Prototype(std::vector<std::unique_ptr<Shape>> shapes,
+                     const BVHSettings &settings)
+    : shapes_(std::move(shapes)) {
+  std::vector<const Shape *> pointers;
+  pointers.reserve(shapes_.size());
+  for (const auto &shape : shapes_) {
+    pointers.push_back(shape.get());
+  }
+  bvh_.build(pointers, settings);
+  bounds_ = bvh_.getUnbounded().empty() ? bvh_.bounds()
+                                        : math::Bounds3D::infinite();
+}
+
+const std::vector<std::unique_ptr<Shape>> &Prototype::getShapes(void) const {
+  return shapes_;
+}
+
+const BVH &Prototype::getBVH(void) const { return bvh_; }
+const math::Bounds3D &Prototype::bounds(void) const { return bounds_; }
+
+Instance::Instance(std::shared_ptr<const Prototype> prototype,
+                   const math::Transform3x4 &transform,
+                   std::shared_ptr<const Material> material)
+    : prototype_(std::move(prototype)), transform_(transform),
+      inverse_(inverse(transform)), material_(std::move(material)) {
+  if (!prototype_) {
+    throw std::runtime_error("Instance without a prototype");
+  }
+}
+
+const Prototype &Instance::getPrototype(void) const { return *prototype_; }
+
+const math::Transform3x4 &Instance::getTransform(void) const {
+  return transform_;
+}
+
+const math::Transform3x4 &Instance::getInverse(void) const {
+  return inverse_;
+}
+
+void Instance::setTransform(const math::Transform3x4 &transform) {
+  transform_ = transform;
+  inverse_ = inverse(transform);
+}
+
+const Material *Instance::getMaterial(void) const { return material_.get(); }
+
+math::Bounds3D Instance::bounds(void) const {
+  return transform(prototype_->bounds(), transform_);
+}
+
+math::Vector3D Instance::normalToWorld(const math::Vector3D &normal) const {
+  const auto &h = inverse_;
+  return normalize(math::Vector3D(
+      h(0, 0) * normal.x() + h(1, 0) * normal.y() + h(2, 0) * normal.z(),
+      h(0, 1) * normal.x() + h(1, 1) * normal.y() + h(2, 1) * normal.z(),
+      h(0, 2) * normal.x() + h(1, 2) * normal.y() + h(2, 2) * normal.z()));
+}
+
+void InstanceBVH::build(const std::vector<Instance> &instances,
+                        const BVHSettings &settings) {
+  instances_ = &instances;
+  unbounded_.clear();
+  std::vector<math::Bounds3D> bounds;
+  std::vector<uint32_t> bounded;
+  bounds.reserve(instances.size());
+  bounded.reserve(instances.size());
+  for (uint32_t i = 0; i < instances.size(); i++) {
+    auto b = instances[i].bounds();
+    if (b.isEmpty()) {
+      continue;
+    }
+    if (!b.isFinite()) {
+      unbounded_.push_back(i);
+      continue;
+    }
+    bounds.push_back(b);
+    bounded.push_back(i);
+  }
+  order_ = BVH::buildNodes(bounds, settings, nodes_);
+  for (auto &i : order_) {
+    i = bounded[i];
+  }
+}
+
+template <typename Test>
+bool InstanceBVH::traverse(const math::Ray &ray, float tMin,
+                           const float *tMax, Test &test) const {
+  if (!instances_) {
+    return false;
+  }
+  for (auto i : unbounded_) {
+    if (test(i)) {
+      return true;
+    }
+  }
+  if (nodes_.empty()) {
+    return false;
+  }
+
+  const auto &o = ray.getOrigin();
+  const auto &d = ray.getDirection();
+  float origin[3] = {o.x(), o.y(), o.z()};
+  float invDirection[3] = {1.0F / d.x(), 1.0F / d.y(), 1.0F / d.z()};
+
+  uint32_t stack[BVH::StackSize];
+  int size = 0;
+  uint32_t index = 0;
+  for (;;) {
+    const auto &node = nodes_[index];
+    if (math::slabTest(node.bounds, origin, invDirection, tMin, *tMax)) {
+      if (node.count > 0) {
+        for (uint32_t i = 0; i < node.count; i++) {
+          if (test(order_[node.offset + i])) {
+            return true;
+          }
+        }
+      } else {
+        // descend into the child on the near side of the split axis first
+        if (invDirection[node.axis] < 0.0F) {
+          stack[size++] = index + 1;
+          index = node.offset;
+        } else {
+          stack[size++] = node.offset;
+          index = index + 1;
+        }
+        continue;
+      }
+    }
+    if (size == 0) {
+      break;
+    }
+    index = stack[--size];
+  }
+  return false;
+}
+
+bool InstanceBVH::closestHit(const math::Ray &ray, float tMin, float tMax,
+                             Intersection *closest) const {
+  auto found = false;
+  auto test = [&](uint32_t i) {
+    const auto &instance = (*instances_)[i];
+    auto local = transform(ray, instance.getInverse());
+    if (instance.getPrototype().getBVH().closestHit(local, tMin, tMax,
+                                                    closest)) {
+      tMax = closest->t;
+      closest->instance = &instance;
+      found = true;
+    }
+    return false;
+  };
+  traverse(ray, tMin, &tMax, test);
+  return found;
+}
+
+bool InstanceBVH::occluded(const math::Ray &ray, float tMin,
+                           float tMax) const {
+  auto test = [&](uint32_t i) {
+    const auto &instance = (*instances_)[i];
+    auto local = transform(ray, instance.getInverse());
+    return instance.getPrototype().getBVH().occluded(local, tMin, tMax);
+  };
+  return traverse(ray, tMin, &tMax, test);
+}
+
+void InstanceBVH::intersectAll(const math::Ray &ray,
+                               std::vector<Intersection> &xs) const {
+  auto test = [&](uint32_t i) {
+    const auto &instance = (*instances_)[i];
+    auto first = xs.size();
+    instance.getPrototype().getBVH().intersectAll(
+        transform(ray, instance.getInverse()), xs);
+    for (auto k = first; k < xs.size(); k++) {
+      xs[k].instance = &instance;
+    }
+    return false;
+  };
+  auto tMax = INFINITY;
+  traverse(ray, -INFINITY, &tMax, test);
+}
+} // namespace raytracer
+} // namespace liby
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "bvh.hpp"
+#include "material.hpp"
+#include "shape.hpp"
+#include "transform3x4.hpp"
+#include <memory>
+#include <vector>
+
+namespace liby {
+namespace raytracer {
+struct Intersection;
+
+/**
+ * @brief Bottom level of the two-level hierarchy: a set of shapes placed in
+ * the prototype's own space, with a BVH over them. It is built once and
+ * shared by every Instance that places a copy of it in the world.
+ */
+class Prototype {
+public:
+  explicit Prototype(std::vector<std::unique_ptr<Shape>> shapes,
+                     const BVHSettings &settings = BVHSettings());
+
+  const std::vector<std::unique_ptr<Shape>> &getShapes(void) const;
+  const BVH &getBVH(void) const;
+
+  /**
+   * @brief Bounds in prototype space. Infinite if any shape is unbounded.
+   */
+  const math::Bounds3D &bounds(void) const;
+
+private:
+  std::vector<std::unique_ptr<Shape>> shapes_;
+  BVH bvh_;
+  math::Bounds3D bounds_;
+};
+
+/**
+ * @brief A placed copy of a Prototype. Only the transform, its inverse and
+ * two shared pointers are stored per copy, so a thousand copies of a prop
+ * cost a thousand of these plus one prototype.
+ */
+class Instance {
+public:
+  /**
+   * @brief material, when set, replaces the material of every shape in the
+   * prototype; it can be shared by many instances.
+   */
+  Instance(std::shared_ptr<const Prototype> prototype,
+           const math::Transform3x4 &transform,
+           std::shared_ptr<const Material> material = nullptr);
+
+  const Prototype &getPrototype(void) const;
+  const math::Transform3x4 &getTransform(void) const;
+  const math::Transform3x4 &getInverse(void) const;
+  void setTransform(const math::Transform3x4 &transform);
+
+  /**
+   * @brief Returns the override material, or nullptr when the prototype's
+   * own materials apply.
+   */
+  const Material *getMaterial(void) const;
+  math::Bounds3D bounds(void) const;
+
+  /**
+   * @brief Maps a normal from prototype space to world space, using the
+   * inverse transpose of the instance transform.
+   */
+  math::Vector3D normalToWorld(const math::Vector3D &normal) const;
+
+private:
+  std::shared_ptr<const Prototype> prototype_;
+  math::Transform3x4 transform_;
+  math::Transform3x4 inverse_;
+  std::shared_ptr<const Material> material_;
+};
+
+/**
+ * @brief Top level of the two-level hierarchy: a BVH over instances. Rays
+ * reaching an instance are mapped into prototype space and continue down
+ * the prototype's own BVH; distances carry over unchanged because the
+ * direction is not renormalised.
+ */
+class InstanceBVH {
+public:
+  InstanceBVH() = default;
+
+  /**
+   * @brief Builds the tree over instances. Only a pointer to the vector is
+   * kept: it must outlive the tree and must not be resized, which would
+   * move its elements, until the tree is rebuilt.
+   */
+  void build(const std::vector<Instance> &instances,
+             const BVHSettings &settings = BVHSettings());
+
+  /**
+   * @brief Same contract as BVH::closestHit(); the hit records the instance.
+   */
+  bool closestHit(const math::Ray &ray, float tMin, float tMax,
+                  Intersection *closest) const;
+
+  /**
+   * @brief Same contract as BVH::occluded().
+   */
+  bool occluded(const math::Ray &ray, float tMin, float tMax) const;
+  void intersectAll(const math::Ray &ray,
+                    std::vector<Intersection> &xs) const;
+
+private:
+  /**
+   * @brief Hands test the index of every unbounded instance and then of
+   * every instance in a leaf the ray reaches within [tMin, *tMax), nearer
+   * children first; test may lower *tMax. Stops and returns true as soon as
+   * test does.
+   */
+  template <typename Test>
+  bool traverse(const math::Ray &ray, float tMin, const float *tMax,
+                Test &test) const;
+
+  const std::vector<Instance> *instances_ = nullptr;
+  std::vector<BVH::Node> nodes_;
+  std::vector<uint32_t> order_;
+  std::vector<uint32_t> unbounded_;
+};
+} // namespace raytracer
+} // namespace liby
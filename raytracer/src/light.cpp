@@ -0,0 +1,12 @@
+#include "light.hpp"
+
+namespace liby {
+namespace raytracer {
+PointLight::PointLight(const math::Point3D &position,
+                       const math::RGBA &intensity)
+    : position_(position), intensity_(intensity) {}
+
+const math::Point3D &PointLight::getPosition(void) const { return position_; }
+const math::RGBA &PointLight::getIntensity(void) const { return intensity_; }
+} // namespace raytracer
+} // namespace liby
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "rgba.hpp"
+#include "vector3D.hpp"
+
+namespace liby {
+namespace raytracer {
+class PointLight {
+public:
+  PointLight() = default;
+  PointLight(const math::Point3D &position, const math::RGBA &intensity);
+
+  const math::Point3D &getPosition(void) const;
+  const math::RGBA &getIntensity(void) const;
+
+private:
+  math::Point3D position_;
+  math::RGBA intensity_;
+};
+} // namespace raytracer
+} // namespace liby
@@ -0,0 +1,198 @@
+#include "lightTree.hpp"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace liby {
+namespace raytracer {
+namespace {
+// a node is never treated as closer than this, so a light sitting on the
+// shading point does not take every sample
+constexpr float MinDistance2 = 1e-6F;
+
+// a median split halves every level, so this covers any tree
+constexpr int StackSize = 64;
+
+// largest float below 1
+constexpr float OneMinusEpsilon = 0x1.fffffep-1F;
+
+float powerOf(const math::RGBA &intensity) {
+  return intensity.r() + intensity.g() + intensity.b();
+}
+
+/**
+ * @brief Estimate of what the lights under node can add at point: their
+ * power over the squared distance, times the cosine between normal and the
+ * direction to the node's bounding sphere closest to it. Zero only when
+ * the whole sphere is below the surface.
+ */
+float importance(const LightTree::Node &node, const math::Point3D &point,
+                 const math::Vector3D &normal) {
+  float radius2 = 0.0F;
+  for (int i = 0; i < 3; i++) {
+    auto c = node.center[i];
+    auto reach = std::max(c - node.bounds.lo[i], node.bounds.hi[i] - c);
+    radius2 += reach * reach;
+  }
+  auto d = node.center - point;
+  auto distance2 = dot(d, d);
+  auto cosine = 1.0F;
+  if (distance2 > radius2) {
+    auto distance = std::sqrt(distance2);
+    auto cosTheta = dot(d, normal) / distance;
+    auto sinBound = std::sqrt(radius2) / distance;
+    auto cosBound = std::sqrt(1.0F - sinBound * sinBound);
+    if (cosTheta < cosBound) {
+      // cos(theta - bound), the angle to the nearest edge of the sphere
+      auto sinTheta = std::sqrt(std::max(0.0F, 1.0F - cosTheta * cosTheta));
+      cosine = cosTheta * cosBound + sinTheta * sinBound;
+      if (cosine <= 0.0F) {
+        return 0.0F;
+      }
+    }
+  }
+  return node.power * cosine /
+         std::max(std::max(distance2, radius2), MinDistance2);
+}
+
+float distanceTo(const math::Bounds3D &bounds, const math::Point3D &point) {
+  float distance2 = 0.0F;
+  for (int i = 0; i < 3; i++) {
+    auto outside = std::max(
+        std::max(bounds.lo[i] - point[i], point[i] - bounds.hi[i]), 0.0F);
+    distance2 += outside * outside;
+  }
+  return std::sqrt(distance2);
+}
+} // namespace
+
+LightTree::LightTree(const std::vector<PointLight> &lights) { build(lights); }
+
+void LightTree::build(const std::vector<PointLight> &lights) {
+  nodes_.clear();
+  if (lights.empty()) {
+    return;
+  }
+  nodes_.reserve(2 * lights.size() - 1);
+  std::vector<uint32_t> order(lights.size());
+  std::iota(order.begin(), order.end(), 0);
+  build(order, 0, static_cast<uint32_t>(order.size()), lights);
+}
+
+uint32_t LightTree::build(std::vector<uint32_t> &order, uint32_t begin,
+                          uint32_t end, const std::vector<PointLight> &lights) {
+  auto index = static_cast<uint32_t>(nodes_.size());
+  nodes_.emplace_back();
+  if (end - begin == 1) {
+    const auto &light = lights[order[begin]];
+    auto &node = nodes_[index];
+    node.bounds.expand(light.getPosition());
+    node.intensity = light.getIntensity();
+    node.center = light.getPosition();
+    node.power = powerOf(light.getIntensity());
+    node.offset = order[begin];
+    node.leaf = true;
+    return index;
+  }
+
+  // median split along the longest axis of the light positions
+  math::Bounds3D positions;
+  for (auto i = begin; i < end; i++) {
+    positions.expand(lights[order[i]].getPosition());
+  }
+  auto axis = positions.getLongestAxis();
+  auto middle = begin + (end - begin) / 2;
+  std::nth_element(order.begin() + begin, order.begin() + middle,
+                   order.begin() + end, [&](uint32_t a, uint32_t b) {
+                     return lights[a].getPosition()[axis] <
+                            lights[b].getPosition()[axis];
+                   });
+  auto left = build(order, begin, middle, lights);
+  auto right = build(order, middle, end, lights);
+
+  const auto &a = nodes_[left];
+  const auto &b = nodes_[right];
+  Node node;
+  node.bounds = merge(a.bounds, b.bounds);
+  node.intensity = a.intensity + b.intensity;
+  node.power = a.power + b.power;
+  // a cluster of dark lights sits halfway between its halves
+  auto share = node.power > 0.0F ? b.power / node.power : 0.5F;
+  node.center = a.center + (b.center - a.center) * share;
+  node.offset = right;
+  node.leaf = false;
+  nodes_[index] = node;
+  return index;
+}
+
+bool LightTree::empty(void) const { return nodes_.empty(); }
+
+const std::vector<LightTree::Node> &LightTree::getNodes(void) const {
+  return nodes_;
+}
+
+math::RGBA LightTree::getIntensity(void) const {
+  return nodes_.empty() ? math::RGBA(0.0F, 0.0F, 0.0F)
+                        : nodes_[0].intensity;
+}
+
+int LightTree::sample(const math::Point3D &point, const math::Vector3D &normal,
+                      float u, float *pmf) const {
+  if (nodes_.empty() || importance(nodes_[0], point, normal) <= 0.0F) {
+    return -1;
+  }
+  uint32_t index = 0;
+  auto probability = 1.0F;
+  u = std::min(u, OneMinusEpsilon);
+  while (!nodes_[index].leaf) {
+    auto left = index + 1;
+    auto right = nodes_[index].offset;
+    auto a = importance(nodes_[left], point, normal);
+    auto b = importance(nodes_[right], point, normal);
+    if (a + b <= 0.0F) {
+      return -1;
+    }
+    // u is rescaled after every choice so one number drives the whole walk
+    auto p = a / (a + b);
+    if (u < p) {
+      u /= p;
+      probability *= p;
+      index = left;
+    } else {
+      u = (u - p) / (1.0F - p);
+      probability *= 1.0F - p;
+      index = right;
+    }
+    u = std::min(u, OneMinusEpsilon);
+  }
+  *pmf = probability;
+  return static_cast<int>(nodes_[index].offset);
+}
+
+void LightTree::cluster(const math::Point3D &point,
+                        const math::Vector3D &normal, float ratio,
+                        std::vector<LightSample> &samples) const {
+  if (nodes_.empty()) {
+    return;
+  }
+  uint32_t stack[StackSize];
+  auto size = 0;
+  stack[size++] = 0;
+  while (size > 0) {
+    const auto &node = nodes_[stack[--size]];
+    if (importance(node, point, normal) <= 0.0F) {
+      continue;
+    }
+    if (!node.leaf) {
+      auto extent = node.bounds.getExtent();
+      if (magnitude(extent) > ratio * distanceTo(node.bounds, point)) {
+        stack[size++] = node.offset;
+        stack[size++] = static_cast<uint32_t>(&node - nodes_.data()) + 1;
+        continue;
+      }
+    }
+    samples.push_back({PointLight(node.center, node.intensity), 1.0F});
+  }
+}
+} // namespace raytracer
+} // namespace liby
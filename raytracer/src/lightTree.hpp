@@ -0,0 +1,105 @@
+#pragma once
+
+#include "bounds3D.hpp"
+#include "light.hpp"
+#include "rgba.hpp"
+#include "vector3D.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace liby {
+namespace raytracer {
+enum class LightSampling {
+  // every hit is lit by every light
+  All,
+  // a few lights per hit are drawn from the LightTree by importance and
+  // weighted by their probability; noisy but unbiased
+  Sampled,
+  // lights far from the hit relative to their spread are merged into one
+  // light per cluster; deterministic but approximate
+  Clustered,
+};
+
+struct LightSettings {
+  LightSampling mode = LightSampling::All;
+  // lights drawn per hit in LightSampling::Sampled
+  int samples = 4;
+  // in LightSampling::Clustered, a subtree is shaded as one light once the
+  // diagonal of its bounds is below this fraction of its distance to the
+  // hit
+  float clusterRatio = 0.25F;
+};
+
+/**
+ * @brief A light chosen to stand in for some of a world's lights at a hit,
+ * and the factor its diffuse and specular terms are scaled by.
+ */
+struct LightSample {
+  PointLight light;
+  float weight;
+};
+
+/**
+ * @brief Bounding-volume hierarchy over point lights. Every node keeps the
+ * bounds of its lights, their summed intensity and power, and their
+ * power-weighted centroid, which is enough to estimate how much the whole
+ * subtree can add at a shading point: power over squared distance, times
+ * a cosine bound that is zero once every light in the node's bounds is
+ * below the surface. Point lights shine the same way in every direction,
+ * so the orientation bound is the receiver's, not the emitters'.
+ *
+ * Nodes are stored depth-first like BVH nodes: an interior node's first
+ * child follows it and offset holds the second child; a leaf holds one
+ * light and offset is its index in the list the tree was built from.
+ */
+class LightTree {
+public:
+  struct Node {
+    math::Bounds3D bounds;
+    math::RGBA intensity;
+    math::Point3D center;
+    float power;
+    uint32_t offset;
+    bool leaf;
+  };
+
+  LightTree() = default;
+  explicit LightTree(const std::vector<PointLight> &lights);
+
+  void build(const std::vector<PointLight> &lights);
+
+  bool empty(void) const;
+  const std::vector<Node> &getNodes(void) const;
+
+  /**
+   * @brief Summed intensity of every light in the tree.
+   */
+  math::RGBA getIntensity(void) const;
+
+  /**
+   * @brief Walks from the root to one light, picking each child with
+   * probability proportional to its importance at point, and returns the
+   * light's index with its probability in pmf. u in [0, 1) drives the
+   * choices. Returns -1 if no light can reach point from above normal.
+   */
+  int sample(const math::Point3D &point, const math::Vector3D &normal,
+             float u, float *pmf) const;
+
+  /**
+   * @brief Appends to samples, with weight 1, a light for every cluster of
+   * a cut through the tree: subtrees small relative to their distance from
+   * point (see LightSettings::clusterRatio) are merged into one light of
+   * their summed intensity at their centroid, and the rest are opened up.
+   * Subtrees entirely below the surface are left out.
+   */
+  void cluster(const math::Point3D &point, const math::Vector3D &normal,
+               float ratio, std::vector<LightSample> &samples) const;
+
+private:
+  uint32_t build(std::vector<uint32_t> &order, uint32_t begin, uint32_t end,
+                 const std::vector<PointLight> &lights);
+
+  std::vector<Node> nodes_;
+};
+} // namespace raytracer
+} // namespace liby
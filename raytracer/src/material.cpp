@@ -0,0 +1,79 @@
+#include "material.hpp"
+#include "light.hpp"
+
+namespace liby {
+namespace raytracer {
+Material::Material()
+    : ambient_(0.1F), diffuse_(0.9F), specular_(0.9F), shininess_(200.0F),
+      reflective_(0.0F), transparency_(0.0F), refractiveIndex_(1.0F),
+      color_(1.0F, 1.0F, 1.0F), pattern_(nullptr) {}
+
+Material::~Material() {}
+
+Material::Material(float ambient, float diffuse, float specular,
+                   float shininess, float reflective, float transparency,
+                   float refractiveIndex, math::RGBA color,
+                   std::unique_ptr<Pattern> pattern)
+    : ambient_(ambient), diffuse_(diffuse), specular_(specular),
+      shininess_(shininess), reflective_(reflective),
+      transparency_(transparency), refractiveIndex_(refractiveIndex),
+      color_(color), pattern_(std::move(pattern)) {
+  if (pattern_) {
+    program_ = PatternProgram(*pattern_);
+  }
+}
+
+float Material::getAmbient(void) const { return ambient_; }
+float Material::getDiffuse(void) const { return diffuse_; }
+float Material::getSpecular(void) const { return specular_; }
+float Material::getShininess(void) const { return shininess_; }
+float Material::getReflective(void) const { return reflective_; }
+float Material::getTransparency(void) const { return transparency_; }
+float Material::getRefractiveIndex(void) const { return refractiveIndex_; }
+const math::RGBA &Material::getColor(void) const { return color_; }
+const Pattern *Material::getPattern(void) const { return pattern_.get(); }
+
+const PatternProgram &Material::getPatternProgram(void) const {
+  return program_;
+}
+
+math::RGBA Material::colorAt(const math::Point3D &point) const {
+  return pattern_ ? program_.at(point) : color_;
+}
+
+math::RGBA lighting(const Material &material, const PointLight &pointLight,
+                    const math::Point3D &point, const math::Vector3D &eye,
+                    const math::Vector3D &normal, bool inShadow) {
+  return lighting(material, material.colorAt(point), pointLight, point, eye,
+                  normal, inShadow);
+}
+
+math::RGBA lighting(const Material &material, const math::RGBA &color,
+                    const PointLight &pointLight, const math::Point3D &point,
+                    const math::Vector3D &eye, const math::Vector3D &normal,
+                    bool inShadow) {
+  auto effective = color * pointLight.getIntensity();
+  auto ambient = effective * material.ambient_;
+  if (inShadow) {
+    return ambient;
+  }
+
+  const auto lightv = normalize(pointLight.getPosition() - point);
+  auto lightDotNormal = dot(lightv, normal);
+  if (lightDotNormal < 0.0F) {
+    // light is on the other side of the surface
+    return ambient;
+  }
+  auto diffuse = effective * (material.diffuse_ * lightDotNormal);
+
+  auto reflectv = reflect(-lightv, normal);
+  auto reflectDotEye = dot(reflectv, eye);
+  if (reflectDotEye <= 0.0F) {
+    return ambient + diffuse;
+  }
+  auto factor = std::pow(reflectDotEye, material.shininess_);
+  auto specular = pointLight.getIntensity() * (material.specular_ * factor);
+  return ambient + diffuse + specular;
+}
+} // namespace raytracer
+} // namespace liby
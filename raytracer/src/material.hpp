@@ -1,10 +1,12 @@
 #pragma once
 
 #include "pattern.hpp"
+#include "patternProgram.hpp"
 #include "rgba.hpp"
 #include "vector3D.hpp"
 #include <memory>
 
+namespace liby {
 namespace raytracer {
 class PointLight;
 class Material {
@@ -13,12 +15,56 @@ public:
   ~Material();
   Material(float ambient, float diffuse, float specular, float shininess,
            float reflective, float transparency, float refractiveIndex,
-           renderer::RGBA color, std::unique_ptr<Pattern> pattern);
+           math::RGBA color, std::unique_ptr<Pattern> pattern);
+  Material(Material &&) = default;
+  Material &operator=(Material &&) = default;
 
-  friend renderer::RGBA
-  lighting(const Material &material, const PointLight &pointLight,
-           const mathengine::Point3D &point, const mathengine::Vector3D &eye,
-           const mathengine::Vector3D &normal, bool inShadow);
+  float getAmbient(void) const;
+  float getDiffuse(void) const;
+  float getSpecular(void) const;
+  float getShininess(void) const;
+  float getReflective(void) const;
+  float getTransparency(void) const;
+  float getRefractiveIndex(void) const;
+  const math::RGBA &getColor(void) const;
+  const Pattern *getPattern(void) const;
+
+  /**
+   * @brief The pattern compiled when the material was built; empty if the
+   * material has no pattern.
+   */
+  const PatternProgram &getPatternProgram(void) const;
+
+  /**
+   * @brief Returns the surface color at point, in the object space of the
+   * shape being shaded (see Computations::objectPoint): the pattern's if
+   * there is one, the plain color otherwise.
+   */
+  math::RGBA colorAt(const math::Point3D &point) const;
+
+  /**
+   * @brief Phong shading of point as seen from eye under pointLight. Only the
+   * ambient term is kept when the point is in shadow. The pattern is looked
+   * up at point itself, which is only right for a shape without a
+   * transform; shading code passes colorAt(objectPoint) to the overload
+   * below.
+   */
+  friend math::RGBA lighting(const Material &material,
+                             const PointLight &pointLight,
+                             const math::Point3D &point,
+                             const math::Vector3D &eye,
+                             const math::Vector3D &normal, bool inShadow);
+
+  /**
+   * @brief Same as lighting() with color standing in for colorAt(point), for
+   * callers that evaluate the pattern over many points at once.
+   */
+  friend math::RGBA lighting(const Material &material,
+                             const math::RGBA &color,
+                             const PointLight &pointLight,
+                             const math::Point3D &point,
+                             const math::Vector3D &eye,
+                             const math::Vector3D &normal, bool inShadow);
 
 protected:
   float ambient_;
@@ -28,7 +74,9 @@ protected:
   float reflective_;
   float transparency_;
   float refractiveIndex_;
-  renderer::RGBA color_;
+  math::RGBA color_;
   std::unique_ptr<Pattern> pattern_;
+  PatternProgram program_;
 };
 } // namespace raytracer
+} // namespace liby
@@ -0,0 +1,110 @@
+#include "pattern.hpp"
+#include "patternKernels.hpp"
+#include "shape.hpp"
+#include <stdexcept>
+
+namespace liby {
+namespace raytracer {
+Pattern::Pattern()
+    : a_(1.0F, 1.0F, 1.0F), b_(0.0F, 0.0F, 0.0F),
+      manager_(std::make_unique<PatternManager>()),
+      transform_(math::Matrix4D::identity()),
+      inverse_(math::Matrix4D::identity()) {}
+
+Pattern::~Pattern() {}
+
+Pattern::Pattern(math::RGBA a, math::RGBA b,
+                 std::unique_ptr<PatternManager> manager)
+    : a_(a), b_(b), manager_(std::move(manager)),
+      transform_(math::Matrix4D::identity()),
+      inverse_(math::Matrix4D::identity()) {}
+
+Pattern::Pattern(std::unique_ptr<Pattern> a, std::unique_ptr<Pattern> b,
+                 std::unique_ptr<PatternManager> manager)
+    : a_(1.0F, 1.0F, 1.0F), b_(0.0F, 0.0F, 0.0F), patternA_(std::move(a)),
+      patternB_(std::move(b)), manager_(std::move(manager)),
+      transform_(math::Matrix4D::identity()),
+      inverse_(math::Matrix4D::identity()) {
+  if (!patternA_ || !patternB_) {
+    throw std::runtime_error("Nested pattern without both sides");
+  }
+}
+
+math::RGBA Pattern::at(const math::Point3D &p) const {
+  return manager_->at(*this, inverse_ * p);
+}
+
+math::RGBA Pattern::atShape(const Shape &shape,
+                            const math::Point3D &p) const {
+  return manager_->atShape(*this, shape, p);
+}
+
+math::RGBA Pattern::sideA(const math::Point3D &p) const {
+  return patternA_ ? patternA_->at(p) : a_;
+}
+
+math::RGBA Pattern::sideB(const math::Point3D &p) const {
+  return patternB_ ? patternB_->at(p) : b_;
+}
+
+const math::RGBA &Pattern::getA(void) const { return a_; }
+const math::RGBA &Pattern::getB(void) const { return b_; }
+const Pattern *Pattern::getPatternA(void) const { return patternA_.get(); }
+const Pattern *Pattern::getPatternB(void) const { return patternB_.get(); }
+const PatternManager *Pattern::getManager(void) const {
+  return manager_.get();
+}
+
+const math::Transform4D &Pattern::getTransform(void) const {
+  return transform_;
+}
+
+const math::Transform4D &Pattern::getInverse(void) const { return inverse_; }
+
+void Pattern::setTransform(const math::Transform4D &h) {
+  transform_ = h;
+  inverse_ = inverse(h);
+}
+
+PatternManager::PatternManager() {}
+PatternManager::~PatternManager() {}
+
+math::RGBA PatternManager::at(const Pattern &pattern,
+                              const math::Point3D &) const {
+  return pattern.getA();
+}
+
+math::RGBA PatternManager::atShape(const Pattern &pattern, const Shape &shape,
+                                   const math::Point3D &p) const {
+  return pattern.at(shape.getInverse() * p);
+}
+
+math::RGBA StripeManager::at(const Pattern &pattern,
+                             const math::Point3D &p) const {
+  return kernels::stripeIsA(p.x()) ? pattern.sideA(p) : pattern.sideB(p);
+}
+
+math::RGBA GradientManager::at(const Pattern &pattern,
+                               const math::Point3D &p) const {
+  auto a = pattern.sideA(p);
+  return a + (pattern.sideB(p) - a) * kernels::gradientFraction(p.x());
+}
+
+math::RGBA RingManager::at(const Pattern &pattern,
+                           const math::Point3D &p) const {
+  return kernels::ringIsA(p.x(), p.z()) ? pattern.sideA(p)
+                                        : pattern.sideB(p);
+}
+
+math::RGBA CheckerManager::at(const Pattern &pattern,
+                              const math::Point3D &p) const {
+  return kernels::checkerIsA(p.x(), p.y(), p.z()) ? pattern.sideA(p)
+                                                  : pattern.sideB(p);
+}
+
+math::RGBA BlendManager::at(const Pattern &pattern,
+                            const math::Point3D &p) const {
+  return (pattern.sideA(p) + pattern.sideB(p)) * 0.5F;
+}
+} // namespace raytracer
+} // namespace liby
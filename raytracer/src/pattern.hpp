@@ -1,34 +1,112 @@
 #pragma once
 
 #include "rgba.hpp"
+#include "transform4D.hpp"
 #include "vector3D.hpp"
 #include <memory>
 
+namespace liby {
 namespace raytracer {
 class PatternManager;
 class Shape;
+/**
+ * @brief Color that varies over space, painting with two sides a and b. A
+ * side is either a plain color or a nested pattern, which is evaluated in
+ * this pattern's space and so is placed relative to it. The transform maps
+ * pattern space to the space the pattern is evaluated in.
+ */
 class Pattern {
 public:
   Pattern();
   virtual ~Pattern();
-  Pattern(renderer::RGBA a, renderer::RGBA b,
+  Pattern(math::RGBA a, math::RGBA b, std::unique_ptr<PatternManager> manager);
+  Pattern(std::unique_ptr<Pattern> a, std::unique_ptr<Pattern> b,
           std::unique_ptr<PatternManager> manager);
-  virtual renderer::RGBA at(const mathengine::Point3D &) const;
-  virtual renderer::RGBA atShape(const Shape &,
-                                 const mathengine::Point3D &) const;
+
+  /**
+   * @brief Returns the color at p, given in the space the pattern is placed
+   * in; p is mapped into pattern space before the manager sees it.
+   */
+  virtual math::RGBA at(const math::Point3D &) const;
+  virtual math::RGBA atShape(const Shape &, const math::Point3D &) const;
+
+  /**
+   * @brief Returns side a or b at p, given in pattern space.
+   */
+  math::RGBA sideA(const math::Point3D &p) const;
+  math::RGBA sideB(const math::Point3D &p) const;
+
+  const math::RGBA &getA(void) const;
+  const math::RGBA &getB(void) const;
+  const Pattern *getPatternA(void) const;
+  const Pattern *getPatternB(void) const;
+  const PatternManager *getManager(void) const;
+  const math::Transform4D &getTransform(void) const;
+  const math::Transform4D &getInverse(void) const;
+  void setTransform(const math::Transform4D &);
 
 protected:
-  renderer::RGBA a_;
-  renderer::RGBA b_;
+  math::RGBA a_;
+  math::RGBA b_;
+  std::unique_ptr<Pattern> patternA_;
+  std::unique_ptr<Pattern> patternB_;
   std::unique_ptr<PatternManager> manager_;
+  math::Transform4D transform_;
+  math::Transform4D inverse_;
 };
 
+/**
+ * @brief Evaluates a pattern. The default manager paints the pattern's first
+ * color everywhere; atShape() maps the world-space point into the shape's
+ * object space before calling at(). p is in pattern space.
+ */
 class PatternManager {
 public:
   PatternManager();
-  ~PatternManager();
-  virtual renderer::RGBA at(const Pattern &, const mathengine::Point3D &) const;
-  virtual renderer::RGBA atShape(const Pattern &, const Shape &,
-                                 const mathengine::Point3D &) const;
+  virtual ~PatternManager();
+  virtual math::RGBA at(const Pattern &, const math::Point3D &p) const;
+  virtual math::RGBA atShape(const Pattern &, const Shape &,
+                             const math::Point3D &) const;
+};
+
+/**
+ * @brief Alternates a and b in unit-wide bands along x.
+ */
+class StripeManager : public PatternManager {
+public:
+  math::RGBA at(const Pattern &, const math::Point3D &p) const override;
+};
+
+/**
+ * @brief Blends linearly from a to b across each unit of x.
+ */
+class GradientManager : public PatternManager {
+public:
+  math::RGBA at(const Pattern &, const math::Point3D &p) const override;
+};
+
+/**
+ * @brief Alternates a and b in unit-wide rings around the y axis.
+ */
+class RingManager : public PatternManager {
+public:
+  math::RGBA at(const Pattern &, const math::Point3D &p) const override;
+};
+
+/**
+ * @brief Alternates a and b between neighbouring unit cubes.
+ */
+class CheckerManager : public PatternManager {
+public:
+  math::RGBA at(const Pattern &, const math::Point3D &p) const override;
+};
+
+/**
+ * @brief Averages a and b; useful with two nested patterns.
+ */
+class BlendManager : public PatternManager {
+public:
+  math::RGBA at(const Pattern &, const math::Point3D &p) const override;
 };
 } // namespace raytracer
+} // namespace liby
@@ -0,0 +1,251 @@
+#include "patternBake.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <mutex>
+#include <stdexcept>
+
+namespace liby {
+namespace raytracer {
+namespace {
+constexpr int BrickSize = BrickCache::BrickSize;
+
+// voxel coordinates are clamped well inside int range before conversion
+constexpr float MaxVoxel = 4194304.0F;
+
+// tells caches, and their contents before a clear(), apart in BrickMemo
+std::atomic<uint64_t> nextGeneration{1};
+
+// per thread, the bricks it found last; saves the lock and the hash lookup
+// for the bricks a thread keeps coming back to
+struct BrickMemo {
+  static constexpr int Size = 64;
+  struct Entry {
+    uint64_t generation;
+    uint64_t key;
+    const void *brick;
+  };
+  Entry entries[Size] = {};
+
+  Entry &slot(uint64_t key) {
+    return entries[(key ^ key >> 20 ^ key >> 40) & (Size - 1)];
+  }
+};
+
+thread_local BrickMemo memo;
+
+int floorDiv(int a, int b) { return (a >= 0 ? a : a - b + 1) / b; }
+
+uint64_t brickKey(int level, int bx, int by, int bz) {
+  auto field = [](int v) { return static_cast<uint64_t>(v) & 0xFFFFFU; };
+  return static_cast<uint64_t>(level) << 60 | field(bx) << 40 |
+         field(by) << 20 | field(bz);
+}
+
+const Pattern &sourceOf(const std::unique_ptr<Pattern> &source) {
+  if (!source) {
+    throw std::runtime_error("Baked pattern without a source");
+  }
+  return *source;
+}
+} // namespace
+
+BrickCache::BrickCache(const Pattern &source, const BakeSettings &settings)
+    : source_(source), settings_(settings),
+      generation_(nextGeneration.fetch_add(1)) {
+  if (!(settings.resolution > 0.0F) || settings.levels < 1 ||
+      settings.levels > 16) {
+    throw std::runtime_error("Invalid bake settings");
+  }
+}
+
+math::RGBA BrickCache::sample(const math::Point3D &p, float footprint) const {
+  auto top = settings_.levels - 1;
+  auto level = footprint > 0.0F ? std::log2(footprint * settings_.resolution)
+                                : 0.0F;
+  if (level <= 0.0F) {
+    return sampleLevel(0, p);
+  }
+  if (level >= static_cast<float>(top)) {
+    return sampleLevel(top, p);
+  }
+  auto lower = std::floor(level);
+  auto a = sampleLevel(static_cast<int>(lower), p);
+  auto b = sampleLevel(static_cast<int>(lower) + 1, p);
+  return a + (b - a) * (level - lower);
+}
+
+size_t BrickCache::brickCount(void) const {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  return bricks_.size();
+}
+
+void BrickCache::clear(void) {
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  bricks_.clear();
+  generation_ = nextGeneration.fetch_add(1);
+}
+
+math::RGBA BrickCache::sampleLevel(int level,
+                                   const math::Point3D &p) const {
+  // voxel centers sit at (i + 0.5) / scale
+  auto scale = settings_.resolution / static_cast<float>(1 << level);
+  float position[3] = {p.x(), p.y(), p.z()};
+  int base[3];
+  float fraction[3];
+  for (int axis = 0; axis < 3; axis++) {
+    auto u = std::min(std::max(position[axis] * scale - 0.5F, -MaxVoxel),
+                      MaxVoxel);
+    auto whole = std::floor(u);
+    base[axis] = static_cast<int>(whole);
+    fraction[axis] = u - whole;
+  }
+
+  float weights[8];
+  for (int k = 0; k < 8; k++) {
+    weights[k] = (k & 1 ? fraction[0] : 1.0F - fraction[0]) *
+                 (k & 2 ? fraction[1] : 1.0F - fraction[1]) *
+                 (k & 4 ? fraction[2] : 1.0F - fraction[2]);
+  }
+  float color[4] = {};
+  int local[3];
+  int bricks[3];
+  for (int axis = 0; axis < 3; axis++) {
+    bricks[axis] = floorDiv(base[axis], BrickSize);
+    local[axis] = base[axis] - bricks[axis] * BrickSize;
+  }
+  if (local[0] < BrickSize - 1 && local[1] < BrickSize - 1 &&
+      local[2] < BrickSize - 1) {
+    // all eight voxels are in one brick, which is the usual case
+    const auto &b = brick(level, bricks[0], bricks[1], bricks[2]);
+    const auto *v =
+        b.voxels[(local[2] * BrickSize + local[1]) * BrickSize + local[0]];
+    for (int k = 0; k < 8; k++) {
+      const auto *corner =
+          v + 4 * ((k & 1) + (k & 2 ? BrickSize : 0) +
+                   (k & 4 ? BrickSize * BrickSize : 0));
+      for (int c = 0; c < 4; c++) {
+        color[c] += corner[c] * weights[k];
+      }
+    }
+    return math::RGBA(color[0], color[1], color[2], color[3]);
+  }
+
+  // across a brick boundary, look up each corner but remember the last brick
+  const Brick *last = nullptr;
+  uint64_t lastKey = 0;
+  for (int k = 0; k < 8; k++) {
+    const auto *v = voxel(level, base[0] + (k & 1), base[1] + (k >> 1 & 1),
+                          base[2] + (k >> 2), &last, &lastKey);
+    for (int c = 0; c < 4; c++) {
+      color[c] += v[c] * weights[k];
+    }
+  }
+  return math::RGBA(color[0], color[1], color[2], color[3]);
+}
+
+const float *BrickCache::voxel(int level, int x, int y, int z,
+                               const Brick **last, uint64_t *lastKey) const {
+  auto bx = floorDiv(x, BrickSize);
+  auto by = floorDiv(y, BrickSize);
+  auto bz = floorDiv(z, BrickSize);
+  auto key = brickKey(level, bx, by, bz);
+  if (!*last || key != *lastKey) {
+    *last = &brick(level, bx, by, bz);
+    *lastKey = key;
+  }
+  auto lx = x - bx * BrickSize;
+  auto ly = y - by * BrickSize;
+  auto lz = z - bz * BrickSize;
+  return (*last)->voxels[(lz * BrickSize + ly) * BrickSize + lx];
+}
+
+const BrickCache::Brick &BrickCache::brick(int level, int bx, int by,
+                                           int bz) const {
+  auto key = brickKey(level, bx, by, bz);
+  auto &entry = memo.slot(key);
+  if (entry.generation == generation_ && entry.key == key) {
+    return *static_cast<const Brick *>(entry.brick);
+  }
+  const auto &found = find(level, bx, by, bz, key);
+  entry = {generation_, key, &found};
+  return found;
+}
+
+const BrickCache::Brick &BrickCache::find(int level, int bx, int by, int bz,
+                                          uint64_t key) const {
+  {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto found = bricks_.find(key);
+    if (found != bricks_.end()) {
+      return *found->second;
+    }
+  }
+  // baked outside the lock; if two threads bake the same brick, the first
+  // one stored is kept
+  auto baked = bake(level, bx, by, bz);
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  auto &slot = bricks_[key];
+  if (!slot) {
+    slot = std::move(baked);
+  }
+  return *slot;
+}
+
+std::unique_ptr<BrickCache::Brick> BrickCache::bake(int level, int bx, int by,
+                                                    int bz) const {
+  auto brick = std::make_unique<Brick>();
+  auto scale = settings_.resolution / static_cast<float>(1 << level);
+  const Brick *last = nullptr;
+  uint64_t lastKey = 0;
+  for (int lz = 0; lz < BrickSize; lz++) {
+    for (int ly = 0; ly < BrickSize; ly++) {
+      for (int lx = 0; lx < BrickSize; lx++) {
+        auto x = bx * BrickSize + lx;
+        auto y = by * BrickSize + ly;
+        auto z = bz * BrickSize + lz;
+        auto *out = brick->voxels[(lz * BrickSize + ly) * BrickSize + lx];
+        if (level == 0) {
+          auto c = source_.at(math::Point3D((x + 0.5F) / scale,
+                                            (y + 0.5F) / scale,
+                                            (z + 0.5F) / scale));
+          out[0] = c.r();
+          out[1] = c.g();
+          out[2] = c.b();
+          out[3] = c.a();
+          continue;
+        }
+        // box filter of the eight finer voxels this one covers
+        for (int c = 0; c < 4; c++) {
+          out[c] = 0.0F;
+        }
+        for (int k = 0; k < 8; k++) {
+          const auto *v =
+              voxel(level - 1, 2 * x + (k & 1), 2 * y + ((k >> 1) & 1),
+                    2 * z + (k >> 2), &last, &lastKey);
+          for (int c = 0; c < 4; c++) {
+            out[c] += v[c] * 0.125F;
+          }
+        }
+      }
+    }
+  }
+  return brick;
+}
+
+BakedPattern::BakedPattern(std::unique_ptr<Pattern> source,
+                           const BakeSettings &settings)
+    : source_(std::move(source)), cache_(sourceOf(source_), settings) {}
+
+math::RGBA BakedPattern::at(const math::Point3D &p) const {
+  return cache_.sample(inverse_ * p);
+}
+
+math::RGBA BakedPattern::at(const math::Point3D &p, float footprint) const {
+  return cache_.sample(inverse_ * p, footprint);
+}
+
+const Pattern &BakedPattern::getSource(void) const { return *source_; }
+const BrickCache &BakedPattern::getCache(void) const { return cache_; }
+} // namespace raytracer
+} // namespace liby
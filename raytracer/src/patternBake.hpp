@@ -0,0 +1,99 @@
+#pragma once
+
+#include "pattern.hpp"
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <unordered_map>
+
+namespace liby {
+namespace raytracer {
+struct BakeSettings {
+  // voxels per unit of pattern space at the finest level
+  float resolution = 16.0F;
+  // mip levels, each with half the resolution of the one before
+  int levels = 4;
+};
+
+/**
+ * @brief Sparse, mipmapped 3D texture of a solid pattern. Space is cut into
+ * bricks of BrickSize^3 voxels that are baked the first time a lookup
+ * touches them, so only the regions that are actually shaded take memory.
+ * Level 0 samples the pattern at voxel centers; every coarser voxel is the
+ * average of the eight below it.
+ *
+ * Lookups are safe from any number of threads. The source pattern is read
+ * only while baking and must outlive the cache. Brick coordinates are kept
+ * to 20 bits, so the bake covers about 2^22 / resolution units either side
+ * of the origin.
+ */
+class BrickCache {
+public:
+  static constexpr int BrickSize = 8;
+
+  BrickCache(const Pattern &source, const BakeSettings &settings);
+
+  /**
+   * @brief Returns the trilinearly filtered color at p, in the space the
+   * source is placed in. footprint is the width of the region the sample
+   * stands for; levels are picked, and blended, so that a voxel is about
+   * that wide. Zero reads the finest level.
+   */
+  math::RGBA sample(const math::Point3D &p, float footprint = 0.0F) const;
+
+  size_t brickCount(void) const;
+
+  /**
+   * @brief Drops every baked brick; not safe while other threads sample.
+   */
+  void clear(void);
+
+private:
+  struct Brick {
+    // rgba per voxel, x fastest
+    float voxels[BrickSize * BrickSize * BrickSize][4];
+  };
+
+  math::RGBA sampleLevel(int level, const math::Point3D &p) const;
+  const float *voxel(int level, int x, int y, int z, const Brick **last,
+                    uint64_t *lastKey) const;
+  const Brick &brick(int level, int bx, int by, int bz) const;
+  const Brick &find(int level, int bx, int by, int bz, uint64_t key) const;
+  std::unique_ptr<Brick> bake(int level, int bx, int by, int bz) const;
+
+  const Pattern &source_;
+  BakeSettings settings_;
+  // unique to this cache and changed by clear(); keys per-thread lookups
+  uint64_t generation_;
+  mutable std::shared_mutex mutex_;
+  mutable std::unordered_map<uint64_t, std::unique_ptr<Brick>> bricks_;
+};
+
+/**
+ * @brief Stands in for source, answering at() from a BrickCache instead of
+ * evaluating the pattern. The bake is filtered, so colors are close to the
+ * source's but not exact: edges between sides are blurred over about one
+ * voxel. It lives as long as the pattern, so a scene that is rendered
+ * again, as in the frames of an animation, reuses it.
+ */
+class BakedPattern : public Pattern {
+public:
+  BakedPattern(std::unique_ptr<Pattern> source,
+               const BakeSettings &settings = BakeSettings());
+
+  math::RGBA at(const math::Point3D &p) const override;
+
+  /**
+   * @brief at() with a sample footprint, see BrickCache::sample().
+   */
+  math::RGBA at(const math::Point3D &p, float footprint) const;
+
+  const Pattern &getSource(void) const;
+  const BrickCache &getCache(void) const;
+
+private:
+  std::unique_ptr<Pattern> source_;
+  BrickCache cache_;
+};
+} // namespace raytracer
+} // namespace liby
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "simd.hpp"
+#include <cmath>
+
+namespace liby {
+namespace raytracer {
+/**
+ * @brief The tests the built-in pattern managers make on a pattern-space
+ * point, on plain floats and on SIMD lanes. The managers and PatternProgram
+ * both call these, so a compiled pattern picks the same side as the virtual
+ * one; the lane forms repeat the scalar arithmetic operation for operation.
+ */
+namespace kernels {
+// f must be a whole number
+inline bool isEven(float f) { return f - 2.0F * std::floor(f * 0.5F) == 0.0F; }
+
+inline bool stripeIsA(float x) { return isEven(std::floor(x)); }
+
+inline bool ringIsA(float x, float z) {
+  return isEven(std::floor(std::sqrt(x * x + z * z)));
+}
+
+inline bool checkerIsA(float x, float y, float z) {
+  return isEven(std::floor(x) + std::floor(y) + std::floor(z));
+}
+
+inline float gradientFraction(float x) { return x - std::floor(x); }
+
+template <typename FloatT> typename FloatT::Mask isEven(FloatT f) {
+  auto r = f - FloatT(2.0F) * floor(f * FloatT(0.5F));
+  return (r <= FloatT(0.0F)) & (r >= FloatT(0.0F));
+}
+
+template <typename FloatT> typename FloatT::Mask stripeIsA(FloatT x) {
+  return isEven(floor(x));
+}
+
+template <typename FloatT>
+typename FloatT::Mask ringIsA(FloatT x, FloatT z) {
+  return isEven(floor(sqrt(x * x + z * z)));
+}
+
+template <typename FloatT>
+typename FloatT::Mask checkerIsA(FloatT x, FloatT y, FloatT z) {
+  return isEven(floor(x) + floor(y) + floor(z));
+}
+
+template <typename FloatT> FloatT gradientFraction(FloatT x) {
+  return x - floor(x);
+}
+} // namespace kernels
+} // namespace raytracer
+} // namespace liby
@@ -0,0 +1,254 @@
+#include "patternProgram.hpp"
+#include "patternKernels.hpp"
+#include <algorithm>
+#include <typeinfo>
+
+namespace liby {
+namespace raytracer {
+namespace {
+#ifdef LIBY_SIMD_AVX
+using Lanes = math::simd::Float8;
+#else
+using Lanes = math::simd::Float4;
+#endif
+
+PatternOp classify(const Pattern &pattern) {
+  const auto *manager = pattern.getManager();
+  if (typeid(pattern) != typeid(Pattern) || !manager) {
+    return PatternOp::Virtual;
+  }
+  const auto &type = typeid(*manager);
+  if (type == typeid(PatternManager)) {
+    return PatternOp::Solid;
+  }
+  if (type == typeid(StripeManager)) {
+    return PatternOp::Stripe;
+  }
+  if (type == typeid(GradientManager)) {
+    return PatternOp::Gradient;
+  }
+  if (type == typeid(RingManager)) {
+    return PatternOp::Ring;
+  }
+  if (type == typeid(CheckerManager)) {
+    return PatternOp::Checker;
+  }
+  if (type == typeid(BlendManager)) {
+    return PatternOp::Blend;
+  }
+  return PatternOp::Virtual;
+}
+} // namespace
+
+PatternProgram::PatternProgram(const Pattern &pattern) { compile(pattern); }
+
+bool PatternProgram::empty(void) const { return nodes_.empty(); }
+size_t PatternProgram::size(void) const { return nodes_.size(); }
+
+uint32_t PatternProgram::compile(const Pattern &pattern) {
+  auto index = static_cast<uint32_t>(nodes_.size());
+  Node node;
+  node.op = classify(pattern);
+  node.a = NoChild;
+  node.b = NoChild;
+  node.colorA = pattern.getA();
+  node.colorB = pattern.getB();
+  const auto &h = pattern.getInverse();
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 4; j++) {
+      node.inverse[i * 4 + j] = h(i, j);
+    }
+  }
+  node.pattern = &pattern;
+  nodes_.push_back(node);
+
+  // the plain manager and Virtual nodes never look at nested sides
+  if (node.op == PatternOp::Solid || node.op == PatternOp::Virtual) {
+    return index;
+  }
+  if (pattern.getPatternA()) {
+    auto a = compile(*pattern.getPatternA());
+    nodes_[index].a = a;
+  }
+  if (pattern.getPatternB()) {
+    auto b = compile(*pattern.getPatternB());
+    nodes_[index].b = b;
+  }
+  return index;
+}
+
+math::RGBA PatternProgram::at(const math::Point3D &p) const {
+  return eval(0, p);
+}
+
+math::RGBA PatternProgram::eval(uint32_t index,
+                                const math::Point3D &point) const {
+  const auto &node = nodes_[index];
+  if (node.op == PatternOp::Virtual) {
+    return node.pattern->at(point);
+  }
+  const auto *m = node.inverse;
+  auto x = point.x();
+  auto y = point.y();
+  auto z = point.z();
+  math::Point3D p(x * m[0] + y * m[1] + z * m[2] + m[3],
+                  x * m[4] + y * m[5] + z * m[6] + m[7],
+                  x * m[8] + y * m[9] + z * m[10] + m[11]);
+  auto sideA = [&] {
+    return node.a == NoChild ? node.colorA : eval(node.a, p);
+  };
+  auto sideB = [&] {
+    return node.b == NoChild ? node.colorB : eval(node.b, p);
+  };
+
+  switch (node.op) {
+  case PatternOp::Stripe:
+    return kernels::stripeIsA(p.x()) ? sideA() : sideB();
+  case PatternOp::Gradient: {
+    auto a = sideA();
+    return a + (sideB() - a) * kernels::gradientFraction(p.x());
+  }
+  case PatternOp::Ring:
+    return kernels::ringIsA(p.x(), p.z()) ? sideA() : sideB();
+  case PatternOp::Checker:
+    return kernels::checkerIsA(p.x(), p.y(), p.z()) ? sideA() : sideB();
+  case PatternOp::Blend:
+    return (sideA() + sideB()) * 0.5F;
+  default:
+    return node.colorA;
+  }
+}
+
+template <typename FloatT>
+void PatternProgram::side(const Node &node, bool first, const FloatT *p,
+                          FloatT *color) const {
+  auto child = first ? node.a : node.b;
+  if (child != NoChild) {
+    eval(child, p, color);
+    return;
+  }
+  const auto &c = first ? node.colorA : node.colorB;
+  color[0] = FloatT(c.r());
+  color[1] = FloatT(c.g());
+  color[2] = FloatT(c.b());
+  color[3] = FloatT(c.a());
+}
+
+template <typename FloatT>
+void PatternProgram::eval(uint32_t index, const FloatT *point,
+                          FloatT *color) const {
+  constexpr int Width = FloatT::Width;
+  const auto &node = nodes_[index];
+  if (node.op == PatternOp::Virtual) {
+    alignas(32) float channels[4][Width];
+    for (int lane = 0; lane < Width; lane++) {
+      auto c = node.pattern->at(
+          math::Point3D(point[0][lane], point[1][lane], point[2][lane]));
+      channels[0][lane] = c.r();
+      channels[1][lane] = c.g();
+      channels[2][lane] = c.b();
+      channels[3][lane] = c.a();
+    }
+    for (int i = 0; i < 4; i++) {
+      color[i] = FloatT::load(channels[i]);
+    }
+    return;
+  }
+
+  const auto *m = node.inverse;
+  FloatT p[3];
+  for (int i = 0; i < 3; i++) {
+    p[i] = point[0] * FloatT(m[i * 4]) + point[1] * FloatT(m[i * 4 + 1]) +
+           point[2] * FloatT(m[i * 4 + 2]) + FloatT(m[i * 4 + 3]);
+  }
+
+  // a side only some lanes take is evaluated on all of them and selected
+  auto choose = [&](typename FloatT::Mask isA) {
+    if (all(isA)) {
+      side(node, true, p, color);
+      return;
+    }
+    if (none(isA)) {
+      side(node, false, p, color);
+      return;
+    }
+    FloatT a[4];
+    side(node, true, p, a);
+    side(node, false, p, color);
+    for (int i = 0; i < 4; i++) {
+      color[i] = select(isA, a[i], color[i]);
+    }
+  };
+
+  FloatT a[4];
+  switch (node.op) {
+  case PatternOp::Stripe:
+    choose(kernels::stripeIsA(p[0]));
+    return;
+  case PatternOp::Gradient: {
+    auto t = kernels::gradientFraction(p[0]);
+    side(node, true, p, a);
+    side(node, false, p, color);
+    for (int i = 0; i < 4; i++) {
+      color[i] = a[i] + (color[i] - a[i]) * t;
+    }
+    return;
+  }
+  case PatternOp::Ring:
+    choose(kernels::ringIsA(p[0], p[2]));
+    return;
+  case PatternOp::Checker:
+    choose(kernels::checkerIsA(p[0], p[1], p[2]));
+    return;
+  case PatternOp::Blend:
+    side(node, true, p, a);
+    side(node, false, p, color);
+    for (int i = 0; i < 4; i++) {
+      color[i] = (a[i] + color[i]) * FloatT(0.5F);
+    }
+    return;
+  default:
+    color[0] = FloatT(node.colorA.r());
+    color[1] = FloatT(node.colorA.g());
+    color[2] = FloatT(node.colorA.b());
+    color[3] = FloatT(node.colorA.a());
+    return;
+  }
+}
+
+template <typename FloatT>
+void PatternProgram::atLanes(const float *p, float *color) const {
+  constexpr int Width = FloatT::Width;
+  FloatT point[3] = {FloatT::load(p), FloatT::load(p + Width),
+                     FloatT::load(p + 2 * Width)};
+  FloatT c[4];
+  eval(0, point, c);
+  for (int i = 0; i < 4; i++) {
+    c[i].store(color + i * Width);
+  }
+}
+
+void PatternProgram::at(const math::Point3D *points, size_t count,
+                        math::RGBA *colors) const {
+  constexpr int Width = Lanes::Width;
+  alignas(32) float p[3 * Width];
+  alignas(32) float c[4 * Width];
+  for (size_t first = 0; first < count; first += Width) {
+    auto n = static_cast<int>(std::min<size_t>(Width, count - first));
+    // a short last group repeats its final point in the spare lanes
+    for (int lane = 0; lane < Width; lane++) {
+      const auto &q = points[first + std::min(lane, n - 1)];
+      p[lane] = q.x();
+      p[Width + lane] = q.y();
+      p[2 * Width + lane] = q.z();
+    }
+    atLanes<Lanes>(p, c);
+    for (int lane = 0; lane < n; lane++) {
+      colors[first + lane] =
+          math::RGBA(c[lane], c[Width + lane], c[2 * Width + lane],
+                     c[3 * Width + lane]);
+    }
+  }
+}
+} // namespace raytracer
+} // namespace liby
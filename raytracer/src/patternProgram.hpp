@@ -0,0 +1,82 @@
+#pragma once
+
+#include "pattern.hpp"
+#include "simd.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace liby {
+namespace raytracer {
+enum class PatternOp : uint8_t {
+  // the pattern's first color everywhere, as PatternManager paints
+  Solid,
+  Stripe,
+  Gradient,
+  Ring,
+  Checker,
+  Blend,
+  // any other pattern or manager; evaluated through Pattern::at()
+  Virtual,
+};
+
+/**
+ * @brief A pattern and everything nested in it, flattened into one array of
+ * nodes that a small interpreter walks without virtual calls. Each node
+ * holds its op, the top three rows of its inverse transform, and per side
+ * either a color or the index of the nested node.
+ *
+ * A program gives exactly the colors Pattern::at() does. Patterns it does
+ * not recognise become Virtual nodes that call back into the pattern, so
+ * the pattern must outlive the program and is not to be changed after it
+ * was compiled.
+ */
+class PatternProgram {
+public:
+  PatternProgram() = default;
+  explicit PatternProgram(const Pattern &pattern);
+
+  bool empty(void) const;
+  size_t size(void) const;
+
+  /**
+   * @brief Same as Pattern::at() on the compiled pattern.
+   */
+  math::RGBA at(const math::Point3D &p) const;
+
+  /**
+   * @brief Writes at(points[i]) to colors[i] for count points. Points are
+   * taken a SIMD register's width at a time and every node is evaluated on
+   * all lanes together.
+   */
+  void at(const math::Point3D *points, size_t count,
+          math::RGBA *colors) const;
+
+private:
+  static constexpr uint32_t NoChild = UINT32_MAX;
+
+  struct Node {
+    PatternOp op;
+    // nested nodes for sides that are patterns, NoChild for plain colors
+    uint32_t a;
+    uint32_t b;
+    math::RGBA colorA;
+    math::RGBA colorB;
+    // row-major top three rows of the pattern's inverse transform
+    float inverse[12];
+    const Pattern *pattern;
+  };
+
+  uint32_t compile(const Pattern &pattern);
+  math::RGBA eval(uint32_t index, const math::Point3D &p) const;
+  template <typename FloatT>
+  void eval(uint32_t index, const FloatT *p, FloatT *color) const;
+  template <typename FloatT>
+  void side(const Node &node, bool first, const FloatT *p,
+            FloatT *color) const;
+  template <typename FloatT> void atLanes(const float *p, float *color) const;
+
+  std::vector<Node> nodes_;
+};
+} // namespace raytracer
+} // namespace liby
@@ -0,0 +1,365 @@
+#include "progressive.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <thread>
+
+namespace liby {
+namespace raytracer {
+namespace {
+#ifdef LIBY_SIMD_AVX
+using Packet = math::RayPacket8;
+#else
+using Packet = math::RayPacket4;
+#endif
+
+// pixel block traced as one packet: two rows of Width / 2 pixels
+constexpr int BlockWidth = Packet::Width / 2;
+constexpr int BlockHeight = 2;
+
+// floats kept per pixel in the accumulation buffer
+constexpr size_t Channels = 4;
+
+/**
+ * @brief Where in its pixel sample number n goes, as offsets in [0, 1).
+ * Sample 0 is the center; the rest follow the R2 sequence from there, which
+ * covers the pixel evenly at any count.
+ */
+void samplePosition(int n, float *u, float *v) {
+  constexpr double A1 = 0.7548776662466927;
+  constexpr double A2 = 0.5698402909980532;
+  auto s = 0.5 + A1 * n;
+  auto t = 0.5 + A2 * n;
+  *u = static_cast<float>(s - std::floor(s));
+  *v = static_cast<float>(t - std::floor(t));
+}
+
+float luminance(const math::RGBA &color) {
+  return 0.2126F * color.r() + 0.7152F * color.g() + 0.0722F * color.b();
+}
+} // namespace
+
+ProgressiveRender::ProgressiveRender(const Camera &camera, const World &world,
+                                     const ProgressiveSettings &settings)
+    : camera_(camera), world_(world), settings_(settings),
+      layout_(camera.getHsize(), camera.getVsize()) {
+  if (settings.render.tileSize <= 0) {
+    throw std::runtime_error("Tile size must be positive");
+  }
+  if (settings.render.bounces.maxDepth < 0 ||
+      settings.render.bounces.maxDepth > MaxBounceDepth) {
+    throw std::runtime_error("Bounce depth out of range");
+  }
+  if (settings.maxSamples < 0 || settings.timeLimit < 0.0 ||
+      settings.noiseThreshold < 0.0F || settings.minSamples < 2) {
+    throw std::runtime_error("Invalid progressive settings");
+  }
+  if (settings.render.threads != 0) {
+    ownPool_ = std::make_unique<ThreadPool>(settings.render.threads);
+  }
+  pool_ = ownPool_ ? ownPool_.get() : &ThreadPool::getDefault();
+
+  auto tileSize = settings.render.tileSize;
+  auto tilesX = (camera.getHsize() + tileSize - 1) / tileSize;
+  auto tilesY = (camera.getVsize() + tileSize - 1) / tileSize;
+  auto order = tileOrder(tilesX, tilesY, settings.render.tileOrder);
+  tiles_ = std::vector<Tile>(order.size());
+  for (size_t i = 0; i < tiles_.size(); i++) {
+    auto &tile = tiles_[i];
+    tile.x0 = static_cast<int>(order[i] % tilesX) * tileSize;
+    tile.y0 = static_cast<int>(order[i] / tilesX) * tileSize;
+    tile.x1 = std::min(tile.x0 + tileSize, camera.getHsize());
+    tile.y1 = std::min(tile.y0 + tileSize, camera.getVsize());
+  }
+  auto pixels = layout_.getSize();
+  sums_ = std::vector<std::atomic<float>>(Channels * pixels);
+  squares_ = std::vector<std::atomic<float>>(pixels);
+  counts_ = std::vector<std::atomic<uint32_t>>(pixels);
+  converged_.assign(pixels, 0);
+}
+
+ProgressiveRender::~ProgressiveRender() {
+  // like stop(), but a worker's exception is dropped rather than thrown
+  stopping_ = true;
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_.wait(lock, [this] { return active_ == 0; });
+}
+
+void ProgressiveRender::start(void) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (active_ > 0) {
+    return;
+  }
+  world_.getBVH();
+  world_.getLightTree();
+  stopping_ = false;
+  deadline_ = std::chrono::steady_clock::now() +
+              std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                  std::chrono::duration<double>(settings_.timeLimit));
+  auto jobs = std::min(static_cast<size_t>(pool_->size()), tiles_.size());
+  active_ = static_cast<int>(jobs);
+  for (size_t i = 0; i < jobs; i++) {
+    pool_->submit([this] {
+      try {
+        work();
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!error_) {
+          error_ = std::current_exception();
+        }
+        stopping_ = true;
+      }
+      // notified under the lock: once active_ reaches zero the render may
+      // be destroyed as soon as the waiter gets the mutex
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (--active_ == 0) {
+        done_.notify_all();
+      }
+    });
+  }
+}
+
+void ProgressiveRender::stop(void) {
+  stopping_ = true;
+  wait();
+}
+
+void ProgressiveRender::wait(void) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_.wait(lock, [this] { return active_ == 0; });
+  if (error_) {
+    auto error = error_;
+    error_ = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+bool ProgressiveRender::isRunning(void) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return active_ > 0;
+}
+
+int ProgressiveRender::getSamples(void) const {
+  uint32_t samples = UINT32_MAX;
+  for (const auto &tile : tiles_) {
+    samples = std::min(samples, tile.sequence.load() / 2);
+  }
+  return tiles_.empty() ? 0 : static_cast<int>(samples);
+}
+
+Canvas ProgressiveRender::preview(void) const {
+  Canvas image(camera_.getHsize(), camera_.getVsize());
+  std::vector<float> sums;
+  std::vector<uint32_t> counts;
+  for (const auto &tile : tiles_) {
+    readTile(tile, sums, counts);
+    const auto *sum = sums.data();
+    const auto *count = counts.data();
+    for (auto y = tile.y0; y < tile.y1; y++) {
+      for (auto x = tile.x0; x < tile.x1; x++, sum += Channels, count++) {
+        if (*count == 0) {
+          continue;
+        }
+        auto scale = 1.0F / static_cast<float>(*count);
+        image.writePixel(x, y,
+                         math::RGBA(sum[0] * scale, sum[1] * scale,
+                                    sum[2] * scale, sum[3] * scale));
+      }
+    }
+  }
+  return image;
+}
+
+std::vector<uint32_t> ProgressiveRender::getSampleCounts(void) const {
+  auto width = camera_.getHsize();
+  std::vector<uint32_t> result(static_cast<size_t>(width) *
+                               camera_.getVsize());
+  std::vector<float> sums;
+  std::vector<uint32_t> counts;
+  for (const auto &tile : tiles_) {
+    readTile(tile, sums, counts);
+    const auto *count = counts.data();
+    for (auto y = tile.y0; y < tile.y1; y++) {
+      for (auto x = tile.x0; x < tile.x1; x++) {
+        result[y * width + x] = *count++;
+      }
+    }
+  }
+  return result;
+}
+
+uint32_t ProgressiveRender::readTile(const Tile &tile,
+                                     std::vector<float> &sums,
+                                     std::vector<uint32_t> &counts) const {
+  auto tileWidth = static_cast<size_t>(tile.x1 - tile.x0);
+  auto pixels = tileWidth * (tile.y1 - tile.y0);
+  sums.resize(Channels * pixels);
+  counts.resize(pixels);
+  // a seqlock read: retried if the tile's worker was adding to it
+  // meanwhile, which only spans the update of one tile's sums
+  for (;;) {
+    auto sequence = tile.sequence.load(std::memory_order_acquire);
+    if (sequence % 2 != 0) {
+      std::this_thread::yield();
+      continue;
+    }
+    auto *sum = sums.data();
+    auto *count = counts.data();
+    for (auto y = tile.y0; y < tile.y1; y++) {
+      for (auto x = tile.x0; x < tile.x1; x++) {
+        auto pixel = layout_.index(x, y);
+        for (size_t c = 0; c < Channels; c++) {
+          *sum++ = sums_[Channels * pixel + c].load(std::memory_order_relaxed);
+        }
+        *count++ = counts_[pixel].load(std::memory_order_relaxed);
+      }
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (tile.sequence.load(std::memory_order_relaxed) == sequence) {
+      return sequence / 2;
+    }
+  }
+}
+
+bool ProgressiveRender::finished(void) const {
+  return completeTiles_ == tiles_.size();
+}
+
+void ProgressiveRender::work(void) {
+  auto tileSize = static_cast<size_t>(settings_.render.tileSize);
+  std::vector<math::RGBA> colors(tileSize * tileSize);
+  auto timed = settings_.timeLimit > 0.0;
+  // tiles visited in a row without one to render; after a whole round the
+  // rest are complete or held by workers that will finish them
+  size_t idle = 0;
+  while (!stopping_ && !finished() && idle < tiles_.size()) {
+    if (timed && std::chrono::steady_clock::now() >= deadline_) {
+      return;
+    }
+    // tiles are visited round robin so the image refines evenly; one
+    // another worker holds is skipped and comes round again
+    auto &tile = tiles_[nextTile_++ % tiles_.size()];
+    if (tile.busy.exchange(true, std::memory_order_acquire)) {
+      idle++;
+      std::this_thread::yield();
+      continue;
+    }
+    if (tile.complete) {
+      idle++;
+    } else {
+      idle = 0;
+      if (!renderTile(tile, colors)) {
+        tile.complete = true;
+        completeTiles_++;
+      }
+    }
+    tile.busy.store(false, std::memory_order_release);
+  }
+}
+
+bool ProgressiveRender::renderTile(Tile &tile,
+                                   std::vector<math::RGBA> &colors) {
+  auto tileWidth = tile.x1 - tile.x0;
+  const auto &bounces = settings_.render.bounces;
+  // each pixel follows the sample sequence at its own count
+  auto rayFor = [&](int x, int y) {
+    float u;
+    float v;
+    samplePosition(static_cast<int>(counts_[layout_.index(x, y)].load(
+                       std::memory_order_relaxed)),
+                   &u, &v);
+    return camera_.rayThrough(static_cast<float>(x) + u,
+                              static_cast<float>(y) + v);
+  };
+  if (settings_.render.packets) {
+    math::Point3D origins[Packet::Width];
+    math::Vector3D directions[Packet::Width];
+    int slots[Packet::Width];
+    math::RGBA packetColors[Packet::Width];
+    for (auto by = tile.y0; by < tile.y1; by += BlockHeight) {
+      for (auto bx = tile.x0; bx < tile.x1; bx += BlockWidth) {
+        int count = 0;
+        for (auto y = by; y < std::min(by + BlockHeight, tile.y1); y++) {
+          for (auto x = bx; x < std::min(bx + BlockWidth, tile.x1); x++) {
+            if (converged_[layout_.index(x, y)]) {
+              continue;
+            }
+            auto ray = rayFor(x, y);
+            origins[count] = ray.getOrigin();
+            directions[count] = ray.getDirection();
+            slots[count] = (y - tile.y0) * tileWidth + (x - tile.x0);
+            count++;
+          }
+        }
+        if (count == 0) {
+          continue;
+        }
+        world_.colorAt(Packet::fromRays(origins, directions, count),
+                       bounces, packetColors);
+        for (int i = 0; i < count; i++) {
+          colors[slots[i]] = packetColors[i];
+        }
+      }
+    }
+  } else {
+    for (auto y = tile.y0; y < tile.y1; y++) {
+      for (auto x = tile.x0; x < tile.x1; x++) {
+        if (!converged_[layout_.index(x, y)]) {
+          colors[(y - tile.y0) * tileWidth + (x - tile.x0)] =
+              world_.colorAt(rayFor(x, y), bounces);
+        }
+      }
+    }
+  }
+
+  // only this worker writes the tile, so the sums can be read and stored
+  // back plainly; the odd sequence tells readers to retry meanwhile
+  auto sequence = tile.sequence.load(std::memory_order_relaxed);
+  tile.sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  auto relaxed = std::memory_order_relaxed;
+  auto maxSamples = static_cast<uint32_t>(settings_.maxSamples);
+  auto minSamples = static_cast<uint32_t>(settings_.minSamples);
+  auto threshold = settings_.noiseThreshold;
+  auto active = false;
+  const auto *color = colors.data();
+  for (auto y = tile.y0; y < tile.y1; y++) {
+    for (auto x = tile.x0; x < tile.x1; x++, color++) {
+      auto pixel = layout_.index(x, y);
+      if (converged_[pixel]) {
+        continue;
+      }
+      const float add[Channels] = {color->r(), color->g(), color->b(),
+                                   color->a()};
+      auto *sum = &sums_[Channels * pixel];
+      for (size_t c = 0; c < Channels; c++) {
+        sum[c].store(sum[c].load(relaxed) + add[c], relaxed);
+      }
+      auto l = luminance(*color);
+      auto squares = squares_[pixel].load(relaxed) + l * l;
+      squares_[pixel].store(squares, relaxed);
+      auto count = counts_[pixel].load(relaxed) + 1;
+      counts_[pixel].store(count, relaxed);
+
+      auto done = maxSamples > 0 && count >= maxSamples;
+      if (!done && threshold > 0.0F && count >= minSamples) {
+        // sample variance of the luminance, and from it the standard
+        // error of the mean
+        auto n = static_cast<float>(count);
+        auto mean = luminance(math::RGBA(sum[0].load(relaxed),
+                                         sum[1].load(relaxed),
+                                         sum[2].load(relaxed))) /
+                    n;
+        auto variance = std::max(0.0F, (squares - n * mean * mean) /
+                                           (n - 1.0F));
+        done = variance <= threshold * threshold * n;
+      }
+      converged_[pixel] = done;
+      active = active || !done;
+    }
+  }
+  tile.sequence.store(sequence + 2, std::memory_order_release);
+  return active;
+}
+} // namespace raytracer
+} // namespace liby
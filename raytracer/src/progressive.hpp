@@ -0,0 +1,152 @@
+#pragma once
+
+#include "render.hpp"
+#include "threadPool.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace liby {
+namespace raytracer {
+struct ProgressiveSettings {
+  // tile size, threads, bounces and packets as for render(); mode is ignored
+  RenderSettings render;
+  // stop once every pixel has this many samples; zero never stops on count
+  int maxSamples = 0;
+  // stop after this many seconds; zero never stops on time
+  double timeLimit = 0.0;
+  // a pixel stops taking samples once the standard error of its mean
+  // luminance is below this; zero samples every pixel on every pass
+  float noiseThreshold = 0.0F;
+  // samples a pixel takes before its variance is trusted
+  int minSamples = 8;
+};
+
+/**
+ * @brief Renders world in passes of one sample per pixel, adding each into
+ * a float RGBA accumulation buffer, until stopped or until the settings'
+ * sample count or time limit is reached. The first sample goes through the
+ * pixel center, so one pass gives render()'s image; later ones are spread
+ * over the pixel along a low-discrepancy sequence, antialiasing the image
+ * as it refines. With a noise threshold, pixels whose estimate has settled
+ * drop out of later passes so the samples go where noise remains; flat
+ * regions typically settle after the minimum.
+ *
+ * Workers claim whole tiles, so a tile is only ever written by one thread
+ * and takes its samples in order; the image after n samples does not
+ * depend on the thread count. Each tile publishes its sums under a sequence
+ * counter, so preview() reads a consistent image at any time without
+ * taking a lock the workers wait on. camera and world must outlive the
+ * render and stay unchanged while it runs.
+ */
+class ProgressiveRender {
+public:
+  ProgressiveRender(const Camera &camera, const World &world,
+                    const ProgressiveSettings &settings =
+                        ProgressiveSettings());
+  ~ProgressiveRender();
+  ProgressiveRender(const ProgressiveRender &) = delete;
+  ProgressiveRender &operator=(const ProgressiveRender &) = delete;
+
+  /**
+   * @brief Starts the workers and returns at once. Calling it again after
+   * the render stopped carries on refining the same buffer, with the time
+   * limit counted afresh.
+   */
+  void start(void);
+
+  /**
+   * @brief Asks the workers to stop after their current tile and waits for
+   * them.
+   */
+  void stop(void);
+
+  /**
+   * @brief Blocks until the render stops, and rethrows the first exception
+   * a worker threw.
+   */
+  void wait(void);
+
+  bool isRunning(void) const;
+
+  /**
+   * @brief Passes every tile has been through so far; tiles still working
+   * on the next one may already have more. Converged pixels sit passes out,
+   * so this is an upper bound on their samples.
+   */
+  int getSamples(void) const;
+
+  /**
+   * @brief Returns the average of the samples taken so far. Pixels that
+   * have none yet are black.
+   */
+  Canvas preview(void) const;
+
+  /**
+   * @brief Returns how many samples each pixel has taken so far, row by
+   * row.
+   */
+  std::vector<uint32_t> getSampleCounts(void) const;
+
+private:
+  struct Tile {
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+    // twice the passes made; odd while the sums are being updated
+    std::atomic<uint32_t> sequence{0};
+    std::atomic<bool> busy{false};
+    // every pixel has converged or reached maxSamples; only read and
+    // written by the worker holding busy
+    bool complete = false;
+  };
+
+  void work(void);
+  bool finished(void) const;
+
+  /**
+   * @brief Adds a sample to every pixel of tile still taking them and
+   * returns whether any still is afterwards.
+   */
+  bool renderTile(Tile &tile, std::vector<math::RGBA> &colors);
+
+  /**
+   * @brief Copies tile's sums and sample counts as of one moment between
+   * passes, and returns the passes it had made.
+   */
+  uint32_t readTile(const Tile &tile, std::vector<float> &sums,
+                    std::vector<uint32_t> &counts) const;
+
+  const Camera &camera_;
+  const World &world_;
+  ProgressiveSettings settings_;
+  BlockLayout layout_;
+  std::unique_ptr<ThreadPool> ownPool_;
+  ThreadPool *pool_;
+  // in the order they are visited in
+  std::vector<Tile> tiles_;
+  // per pixel, in layout_: the summed RGBA of its samples, the summed
+  // squares of their luminance, and how many there are
+  std::vector<std::atomic<float>> sums_;
+  std::vector<std::atomic<float>> squares_;
+  std::vector<std::atomic<uint32_t>> counts_;
+  // pixels that no longer take samples; owned like Tile::complete
+  std::vector<uint8_t> converged_;
+  std::atomic<size_t> nextTile_{0};
+  // tiles with every pixel done
+  std::atomic<size_t> completeTiles_{0};
+  std::atomic<bool> stopping_{false};
+  std::chrono::steady_clock::time_point deadline_;
+  mutable std::mutex mutex_;
+  std::condition_variable done_;
+  int active_ = 0;
+  std::exception_ptr error_;
+};
+} // namespace raytracer
+} // namespace liby
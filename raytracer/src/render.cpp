@@ -0,0 +1,117 @@
+#include "render.hpp"
+#include "threadPool.hpp"
+#include "wavefront.hpp"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+
+namespace liby {
+namespace raytracer {
+namespace {
+#ifdef LIBY_SIMD_AVX
+using Packet = math::RayPacket8;
+#else
+using Packet = math::RayPacket4;
+#endif
+
+// pixel block traced as one packet: two rows of Width / 2 pixels
+constexpr int BlockWidth = Packet::Width / 2;
+constexpr int BlockHeight = 2;
+
+void renderBlock(const Camera &camera, const World &world,
+                 const BounceSettings &bounces, int x0, int y0, int x1,
+                 int y1, Canvas &image) {
+  math::Point3D origins[Packet::Width];
+  math::Vector3D directions[Packet::Width];
+  int xs[Packet::Width];
+  int ys[Packet::Width];
+  int count = 0;
+  for (auto y = y0; y < y1; y++) {
+    for (auto x = x0; x < x1; x++) {
+      auto ray = camera.rayForPixel(x, y);
+      origins[count] = ray.getOrigin();
+      directions[count] = ray.getDirection();
+      xs[count] = x;
+      ys[count] = y;
+      count++;
+    }
+  }
+  math::RGBA colors[Packet::Width];
+  world.colorAt(Packet::fromRays(origins, directions, count), bounces,
+                colors);
+  for (int i = 0; i < count; i++) {
+    image.writePixel(xs[i], ys[i], colors[i]);
+  }
+}
+} // namespace
+
+Canvas render(const Camera &camera, const World &world,
+              const RenderSettings &settings) {
+  if (settings.tileSize <= 0) {
+    throw std::runtime_error("Tile size must be positive");
+  }
+  if (settings.bounces.maxDepth < 0 ||
+      settings.bounces.maxDepth > MaxBounceDepth) {
+    throw std::runtime_error("Bounce depth out of range");
+  }
+  Canvas image(camera.getHsize(), camera.getVsize());
+  auto tileSize = settings.tileSize;
+  auto tilesX = (camera.getHsize() + tileSize - 1) / tileSize;
+  auto tilesY = (camera.getVsize() + tileSize - 1) / tileSize;
+  auto tileCount = tilesX * tilesY;
+
+  std::unique_ptr<ThreadPool> ownPool;
+  if (settings.threads != 0) {
+    ownPool = std::make_unique<ThreadPool>(settings.threads);
+  }
+  auto &pool = ownPool ? *ownPool : ThreadPool::getDefault();
+
+  // build the hierarchies up front on the whole machine rather than lazily
+  // inside whichever tile asks first
+  world.getBVH();
+  world.getLightTree();
+  if (settings.mode == RenderMode::Wavefront) {
+    renderWavefront(camera, world, settings, pool, image);
+    return image;
+  }
+
+  auto order = tileOrder(tilesX, tilesY, settings.tileOrder);
+  std::atomic<int> nextTile{0};
+  auto worker = [&] {
+    for (int next = nextTile++; next < tileCount; next = nextTile++) {
+      auto tile = static_cast<int>(order[next]);
+      auto x0 = (tile % tilesX) * tileSize;
+      auto y0 = (tile / tilesX) * tileSize;
+      auto x1 = std::min(x0 + tileSize, camera.getHsize());
+      auto y1 = std::min(y0 + tileSize, camera.getVsize());
+      if (settings.packets) {
+        for (auto y = y0; y < y1; y += BlockHeight) {
+          for (auto x = x0; x < x1; x += BlockWidth) {
+            renderBlock(camera, world, settings.bounces, x, y,
+                        std::min(x + BlockWidth, x1),
+                        std::min(y + BlockHeight, y1), image);
+          }
+        }
+        continue;
+      }
+      for (auto y = y0; y < y1; y++) {
+        for (auto x = x0; x < x1; x++) {
+          image.writePixel(x, y, world.colorAt(camera.rayForPixel(x, y),
+                                               settings.bounces));
+        }
+      }
+    }
+  };
+  // a group of its own, so the render does not wait on whatever else the
+  // pool is running
+  TaskGroup group(pool);
+  auto jobs = std::min(static_cast<int>(pool.size()), tileCount);
+  for (int i = 0; i < jobs; i++) {
+    group.run(worker);
+  }
+  group.wait();
+  return image;
+}
+} // namespace raytracer
+} // namespace liby
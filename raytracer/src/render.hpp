@@ -0,0 +1,49 @@
+#pragma once
+
+#include "camera.hpp"
+#include "canvas.hpp"
+#include "tiling.hpp"
+#include "world.hpp"
+
+namespace liby {
+namespace raytracer {
+enum class RenderMode {
+  // each worker follows its pixels' rays depth first, bounce by bounce
+  Tiled,
+  // rays of many pixels advance together one bounce at a time, see
+  // renderWavefront()
+  Wavefront,
+};
+
+struct RenderSettings {
+  RenderMode mode = RenderMode::Tiled;
+  // edge length of the square tiles handed to the workers, in pixels; a
+  // multiple of BlockLayout::BlockSize keeps workers off each other's
+  // cache lines
+  int tileSize = 16;
+  // order the tiles are handed out in
+  TileOrder tileOrder = TileOrder::Hilbert;
+  // number of worker threads; zero uses the shared pool sized to the cores
+  unsigned int threads = 0;
+  // how far reflection and refraction are followed per camera ray
+  BounceSettings bounces;
+  // trace camera rays, and their shadow rays, in SIMD packets covering a
+  // small block of pixels; the image is the same either way as long as
+  // multiply-adds are not fused (the build passes -ffp-contract=off)
+  bool packets = true;
+  // rough number of camera rays per wave in RenderMode::Wavefront
+  int waveSize = 1 << 16;
+};
+
+/**
+ * @brief Renders world as seen by camera. The image is split into tiles that
+ * workers pull from a shared counter in settings.tileOrder, so cheap and
+ * expensive regions of the image balance out across threads while the
+ * tiles in flight stay close together. Each pixel is written by exactly one
+ * worker and the result does not depend on the thread count. In
+ * RenderMode::Wavefront the work is laid out by renderWavefront() instead.
+ */
+Canvas render(const Camera &camera, const World &world,
+              const RenderSettings &settings = RenderSettings());
+} // namespace raytracer
+} // namespace liby
@@ -0,0 +1,195 @@
+#include "shading.hpp"
+#include "rayPacket.hpp"
+#include "simd.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace liby {
+namespace raytracer {
+namespace {
+#ifdef LIBY_SIMD_AVX
+using Lanes = math::simd::Float8;
+#else
+using Lanes = math::simd::Float4;
+#endif
+
+// hits gathered at a time, small enough to stay in L1 while every light
+// passes over them; a multiple of the SIMD width
+constexpr size_t BlockSize = 256;
+
+// hit data of one block, padded to whole registers by repeating the last hit
+struct Block {
+  alignas(32) float point[3][BlockSize];
+  alignas(32) float normal[3][BlockSize];
+  alignas(32) float eye[3][BlockSize];
+  alignas(32) float color[3][BlockSize];
+  alignas(32) float ambient[BlockSize];
+  alignas(32) float diffuse[BlockSize];
+  alignas(32) float specular[BlockSize];
+  alignas(32) float shininess[BlockSize];
+  // per light: ambient plus diffuse, then the specular power
+  alignas(32) float partial[3][BlockSize];
+  alignas(32) float power[BlockSize];
+  alignas(32) float sum[3][BlockSize];
+};
+
+// a light broadcast to every lane, built once per pass over a block
+struct LightLanes {
+  Lanes position[3];
+  Lanes intensity[3];
+};
+
+Lanes::Mask shadowMask(const uint8_t *inShadow, size_t valid) {
+  int bits = 0;
+  for (size_t lane = 0; lane < Lanes::Width; lane++) {
+    // padding lanes count as shadowed so they skip the specular term
+    if (lane >= valid || inShadow[lane]) {
+      bits |= 1 << lane;
+    }
+  }
+  return math::lanesFromBits<Lanes>(bits);
+}
+
+// the operations and their order follow lighting() so that every lane
+// rounds the same way. Leaves ambient plus diffuse in block.partial and, in
+// block.power, the base the specular term raises to the shininess, or zero
+// where there is no highlight.
+void diffuseLanes(Block &block, size_t k, const LightLanes &light,
+                  Lanes::Mask inShadow) {
+  using math::simd::select;
+  Lanes zero(0.0F);
+  Lanes lightv[3];
+  for (int c = 0; c < 3; c++) {
+    lightv[c] = light.position[c] - Lanes::load(&block.point[c][k]);
+  }
+  auto inverse = Lanes(1.0F) / sqrt(lightv[0] * lightv[0] +
+                                    lightv[1] * lightv[1] +
+                                    lightv[2] * lightv[2]);
+  Lanes normal[3];
+  for (int c = 0; c < 3; c++) {
+    lightv[c] = inverse * lightv[c];
+    normal[c] = Lanes::load(&block.normal[c][k]);
+  }
+  auto lightDotNormal =
+      lightv[0] * normal[0] + lightv[1] * normal[1] + lightv[2] * normal[2];
+  // light on the other side of the surface leaves only the ambient term
+  auto lit = andNot(lightDotNormal >= zero, inShadow);
+  auto diffuseFactor = Lanes::load(&block.diffuse[k]) * lightDotNormal;
+  for (int c = 0; c < 3; c++) {
+    auto effective = Lanes::load(&block.color[c][k]) * light.intensity[c];
+    auto ambient = effective * Lanes::load(&block.ambient[k]);
+    auto diffuse = select(lit, effective * diffuseFactor, zero);
+    (ambient + diffuse).store(&block.partial[c][k]);
+  }
+
+  auto twice = Lanes(2.0F) * -lightDotNormal;
+  Lanes reflectv[3];
+  for (int c = 0; c < 3; c++) {
+    reflectv[c] = -lightv[c] - normal[c] * twice;
+  }
+  auto reflectDotEye = reflectv[0] * Lanes::load(&block.eye[0][k]) +
+                       reflectv[1] * Lanes::load(&block.eye[1][k]) +
+                       reflectv[2] * Lanes::load(&block.eye[2][k]);
+  auto highlight = lit & (reflectDotEye > zero);
+  select(highlight, reflectDotEye, zero).store(&block.power[k]);
+}
+
+// a highlight that rounds away to nothing adds zero, as lighting() would
+// have added no specular term at all
+void specularLanes(Block &block, size_t k, const LightLanes &light) {
+  auto factor =
+      Lanes::load(&block.specular[k]) * Lanes::load(&block.power[k]);
+  for (int c = 0; c < 3; c++) {
+    auto specular = light.intensity[c] * factor;
+    auto sum = Lanes::load(&block.sum[c][k]);
+    (sum + (Lanes::load(&block.partial[c][k]) + specular))
+        .store(&block.sum[c][k]);
+  }
+}
+} // namespace
+
+size_t ShadingBatch::size(void) const { return material.size(); }
+
+void ShadingBatch::clear(void) {
+  for (int c = 0; c < 3; c++) {
+    point[c].clear();
+    normal[c].clear();
+    eye[c].clear();
+    color[c].clear();
+  }
+  material.clear();
+  inShadow.clear();
+}
+
+void ShadingBatch::push(const math::Point3D &p, const math::Vector3D &n,
+                        const math::Vector3D &e, const math::RGBA &c,
+                        uint32_t m) {
+  point[0].push_back(p.x());
+  point[1].push_back(p.y());
+  point[2].push_back(p.z());
+  normal[0].push_back(n.x());
+  normal[1].push_back(n.y());
+  normal[2].push_back(n.z());
+  eye[0].push_back(e.x());
+  eye[1].push_back(e.y());
+  eye[2].push_back(e.z());
+  color[0].push_back(c.r());
+  color[1].push_back(c.g());
+  color[2].push_back(c.b());
+  material.push_back(m);
+}
+
+void shadeBatch(const ShadingBatch &batch, const Material *const *materials,
+                const std::vector<PointLight> &lights, math::RGBA *colors) {
+  constexpr size_t Width = Lanes::Width;
+  thread_local Block block;
+  auto count = batch.size();
+  for (size_t first = 0; first < count; first += BlockSize) {
+    auto n = std::min(BlockSize, count - first);
+    auto padded = (n + Width - 1) / Width * Width;
+    for (size_t k = 0; k < padded; k++) {
+      auto i = first + std::min(k, n - 1);
+      for (int c = 0; c < 3; c++) {
+        block.point[c][k] = batch.point[c][i];
+        block.normal[c][k] = batch.normal[c][i];
+        block.eye[c][k] = batch.eye[c][i];
+        block.color[c][k] = batch.color[c][i];
+        block.sum[c][k] = 0.0F;
+      }
+      const auto &material = *materials[batch.material[i]];
+      block.ambient[k] = material.getAmbient();
+      block.diffuse[k] = material.getDiffuse();
+      block.specular[k] = material.getSpecular();
+      block.shininess[k] = material.getShininess();
+    }
+
+    for (size_t l = 0; l < lights.size(); l++) {
+      const auto &position = lights[l].getPosition();
+      const auto &intensity = lights[l].getIntensity();
+      LightLanes light = {
+          {Lanes(position.x()), Lanes(position.y()), Lanes(position.z())},
+          {Lanes(intensity.r()), Lanes(intensity.g()), Lanes(intensity.b())}};
+      const auto *inShadow = &batch.inShadow[l * count + first];
+      for (size_t k = 0; k < padded; k += Width) {
+        diffuseLanes(block, k, light, shadowMask(inShadow + k, n - k));
+      }
+      // pow stays scalar to give exactly the value lighting() gets; a pass
+      // of its own keeps the calls out of the SIMD code
+      for (size_t k = 0; k < padded; k++) {
+        if (block.power[k] > 0.0F) {
+          block.power[k] = std::pow(block.power[k], block.shininess[k]);
+        }
+      }
+      for (size_t k = 0; k < padded; k += Width) {
+        specularLanes(block, k, light);
+      }
+    }
+
+    for (size_t k = 0; k < n; k++) {
+      colors[first + k] =
+          math::RGBA(block.sum[0][k], block.sum[1][k], block.sum[2][k]);
+    }
+  }
+}
+} // namespace raytracer
+} // namespace liby
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "light.hpp"
+#include "material.hpp"
+#include "rgba.hpp"
+#include "vector3D.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace liby {
+namespace raytracer {
+/**
+ * @brief Surface points waiting to be lit, one array per component so that
+ * shadeBatch() can load a SIMD register's worth of hits at a time.
+ */
+struct ShadingBatch {
+  // points already nudged off the surface, as Computations::overPoint
+  std::vector<float> point[3];
+  std::vector<float> normal[3];
+  std::vector<float> eye[3];
+  // surface color: the material's pattern at Computations::objectPoint, or
+  // its plain color
+  std::vector<float> color[3];
+  // index into the materials handed to shadeBatch()
+  std::vector<uint32_t> material;
+  // one row of size() flags per light, nonzero where the hit is in shadow;
+  // filled by the caller once every hit is pushed
+  std::vector<uint8_t> inShadow;
+
+  size_t size(void) const;
+  void clear(void);
+  void push(const math::Point3D &point, const math::Vector3D &normal,
+            const math::Vector3D &eye, const math::RGBA &color,
+            uint32_t material);
+};
+
+/**
+ * @brief Writes to colors[i] the sum over lights of lighting() for hit i of
+ * batch, giving the same values bit for bit when multiply-adds are not
+ * fused (see shapeKernels.hpp). Hits are shaded a SIMD
+ * register's width at a time with the lights in the outer loop, so each
+ * light's position and intensity are loaded once per block of hits. Alpha
+ * is left at 1.
+ */
+void shadeBatch(const ShadingBatch &batch, const Material *const *materials,
+                const std::vector<PointLight> &lights, math::RGBA *colors);
+} // namespace raytracer
+} // namespace liby
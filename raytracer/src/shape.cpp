@@ -1,3 +1,357 @@
 #include "shape.hpp"
+#include "shapeKernels.hpp"
+#include <algorithm>
+#include <atomic>
 
-namespace raytracer {}
+namespace liby {
+namespace raytracer {
+namespace {
+float nextShapeId(void) {
+  static std::atomic<unsigned int> currentId{0};
+  return static_cast<float>(currentId++);
+}
+
+std::unique_ptr<math::Transform4D> identityTransform(void) {
+  return std::make_unique<math::Transform4D>(math::Matrix4D::identity());
+}
+
+// applies the transpose of h's upper 3x3 to v, which maps object-space
+// normals to world space when h is the inverse of the shape's transform
+math::Vector3D transposeTimes(const math::Transform4D &h,
+                              const math::Vector3D &v) {
+  return math::Vector3D(h(0, 0) * v.x() + h(1, 0) * v.y() + h(2, 0) * v.z(),
+                        h(0, 1) * v.x() + h(1, 1) * v.y() + h(2, 1) * v.z(),
+                        h(0, 2) * v.x() + h(1, 2) * v.y() + h(2, 2) * v.z());
+}
+
+void unpack(const math::Ray &ray, float *o, float *d) {
+  const auto &origin = ray.getOrigin();
+  const auto &direction = ray.getDirection();
+  o[0] = origin.x();
+  o[1] = origin.y();
+  o[2] = origin.z();
+  d[0] = direction.x();
+  d[1] = direction.y();
+  d[2] = direction.z();
+}
+} // namespace
+
+Shape::Shape()
+    : id_(nextShapeId()), radius_(1.0F), material_(),
+      center_(0.0F, 0.0F, 0.0F), matrix_(math::Matrix4D::identity()),
+      inverse_(math::Matrix4D::identity()), manager_(nullptr) {}
+
+Shape::Shape(float id, float radius, Material material,
+             std::unique_ptr<math::Transform4D> matrix, math::Point3D center,
+             std::unique_ptr<ShapeManager> manager)
+    : id_(id), radius_(radius), material_(std::move(material)),
+      center_(center),
+      matrix_(matrix ? *matrix : math::Matrix4D::identity()),
+      inverse_(inverse(matrix_)), manager_(std::move(manager)) {}
+
+Shape::~Shape() {}
+
+math::Vector3D Shape::normal(const math::Point3D &p) const {
+  auto localNormal = manager_->normal(*this, inverse_ * p);
+  return normalize(transposeTimes(inverse_, localNormal));
+}
+
+int Shape::intersect(const math::Ray &ray, float *ts) const {
+  if (!manager_) {
+    return 0;
+  }
+  return manager_->intersect(*this, transform(ray, inverse_), ts);
+}
+
+bool Shape::closestHit(const math::Ray &ray, float tMin, float tMax,
+                       float *t) const {
+  float ts[MaxShapeHits];
+  auto count = intersect(ray, ts);
+  auto found = false;
+  for (int i = 0; i < count; i++) {
+    if (ts[i] >= tMin && ts[i] < tMax) {
+      tMax = ts[i];
+      found = true;
+    }
+  }
+  if (found) {
+    *t = tMax;
+  }
+  return found;
+}
+
+bool Shape::occluded(const math::Ray &ray, float tMin, float tMax) const {
+  float t;
+  return closestHit(ray, tMin, tMax, &t);
+}
+
+math::Bounds3D Shape::bounds(void) const {
+  if (!manager_) {
+    return math::Bounds3D();
+  }
+  return transform(manager_->bounds(*this), matrix_);
+}
+
+float Shape::getId(void) const { return id_; }
+float Shape::getRadius(void) const { return radius_; }
+const math::Point3D &Shape::getCenter(void) const { return center_; }
+const Material &Shape::getMaterial(void) const { return material_; }
+Material &Shape::getMaterial(void) { return material_; }
+const math::Transform4D &Shape::getTransform(void) const { return matrix_; }
+const math::Transform4D &Shape::getInverse(void) const { return inverse_; }
+
+void Shape::setTransform(const math::Transform4D &h) {
+  matrix_ = h;
+  inverse_ = inverse(h);
+}
+const ShapeManager *Shape::getManager(void) const { return manager_.get(); }
+float Shape::nextId(void) { return nextShapeId(); }
+
+ShapeManager::ShapeManager() {}
+ShapeManager::~ShapeManager() {}
+
+int ShapeManager::intersect(const Shape &, const math::Ray &, float *) {
+  return 0;
+}
+
+math::Bounds3D ShapeManager::bounds(const Shape &) {
+  return math::Bounds3D::infinite();
+}
+
+SphereManager::SphereManager() {}
+
+math::Vector3D SphereManager::normal(const Shape &shape,
+                                     const math::Point3D &p) {
+  return (p - shape.getCenter()) / shape.getRadius();
+}
+
+int SphereManager::intersect(const Shape &shape, const math::Ray &ray,
+                             float *ts) {
+  float o[3], d[3];
+  unpack(ray, o, d);
+  const auto &c = shape.getCenter();
+  float center[3] = {c.x(), c.y(), c.z()};
+  return kernels::intersectSphere(o, d, center, shape.getRadius(), ts);
+}
+
+math::Bounds3D SphereManager::bounds(const Shape &shape) {
+  auto r = shape.getRadius();
+  const auto &c = shape.getCenter();
+  return math::Bounds3D(math::Point3D(c.x() - r, c.y() - r, c.z() - r),
+                        math::Point3D(c.x() + r, c.y() + r, c.z() + r));
+}
+
+Sphere::Sphere()
+    : Sphere(Material(), identityTransform(),
+             std::make_unique<SphereManager>()) {}
+
+Sphere::Sphere(Material material, std::unique_ptr<math::Transform4D> matrix,
+               std::unique_ptr<SphereManager> manager)
+    : Shape(nextShapeId(), 1.0F, std::move(material), std::move(matrix),
+            math::Point3D(0.0F, 0.0F, 0.0F), std::move(manager)) {}
+
+math::Vector3D Sphere::normal(const math::Point3D &p) const {
+  return Shape::normal(p);
+}
+
+int Sphere::intersect(const math::Ray &ray, float *ts) const {
+  return Shape::intersect(ray, ts);
+}
+
+PlaneManager::PlaneManager() {}
+
+math::Vector3D PlaneManager::normal(const Shape &, const math::Point3D &) {
+  return math::Vector3D(0.0F, 1.0F, 0.0F);
+}
+
+int PlaneManager::intersect(const Shape &, const math::Ray &ray,
+                            float *ts) {
+  float o[3], d[3];
+  unpack(ray, o, d);
+  return kernels::intersectPlane(o, d, ts);
+}
+
+math::Bounds3D PlaneManager::bounds(const Shape &) {
+  return math::Bounds3D(math::Point3D(-INFINITY, 0.0F, -INFINITY),
+                        math::Point3D(INFINITY, 0.0F, INFINITY));
+}
+
+Plane::Plane()
+    : Plane(Material(), identityTransform(), std::make_unique<PlaneManager>()) {
+}
+
+Plane::Plane(Material material, std::unique_ptr<math::Transform4D> matrix,
+             std::unique_ptr<PlaneManager> manager)
+    : Shape(nextShapeId(), 0.0F, std::move(material), std::move(matrix),
+            math::Point3D(0.0F, 0.0F, 0.0F), std::move(manager)) {}
+
+math::Vector3D Plane::normal(const math::Point3D &p) const {
+  return Shape::normal(p);
+}
+
+int Plane::intersect(const math::Ray &ray, float *ts) const {
+  return Shape::intersect(ray, ts);
+}
+
+CylinderManager::CylinderManager() {}
+
+math::Vector3D CylinderManager::normal(const Shape &shape,
+                                       const math::Point3D &p) {
+  const auto &cylinder = static_cast<const Cylinder &>(shape);
+  auto dist = p.x() * p.x() + p.z() * p.z();
+  if (dist < 1.0F && p.y() >= cylinder.getMaximum() - Epsilon) {
+    return math::Vector3D(0.0F, 1.0F, 0.0F);
+  }
+  if (dist < 1.0F && p.y() <= cylinder.getMinimum() + Epsilon) {
+    return math::Vector3D(0.0F, -1.0F, 0.0F);
+  }
+  return math::Vector3D(p.x(), 0.0F, p.z());
+}
+
+int CylinderManager::intersect(const Shape &shape, const math::Ray &ray,
+                               float *ts) {
+  const auto &cylinder = static_cast<const Cylinder &>(shape);
+  float o[3], d[3];
+  unpack(ray, o, d);
+  return kernels::intersectCylinder(o, d, cylinder.getMinimum(),
+                                    cylinder.getMaximum(),
+                                    cylinder.getIsClosed(), ts);
+}
+
+math::Bounds3D CylinderManager::bounds(const Shape &shape) {
+  const auto &cylinder = static_cast<const Cylinder &>(shape);
+  return math::Bounds3D(math::Point3D(-1.0F, cylinder.getMinimum(), -1.0F),
+                        math::Point3D(1.0F, cylinder.getMaximum(), 1.0F));
+}
+
+Cylinder::Cylinder()
+    : Cylinder(Material(), identityTransform(),
+               std::make_unique<CylinderManager>()) {}
+
+Cylinder::Cylinder(Material material,
+                   std::unique_ptr<math::Transform4D> matrix,
+                   std::unique_ptr<CylinderManager> manager, float minimum,
+                   float maximum, bool isClosed)
+    : Cylinder(std::move(material), std::move(matrix),
+               std::unique_ptr<ShapeManager>(std::move(manager)), minimum,
+               maximum, isClosed) {}
+
+Cylinder::Cylinder(Material material,
+                   std::unique_ptr<math::Transform4D> matrix,
+                   std::unique_ptr<ShapeManager> manager, float minimum,
+                   float maximum, bool isClosed)
+    : Shape(nextShapeId(), 1.0F, std::move(material), std::move(matrix),
+            math::Point3D(0.0F, 0.0F, 0.0F), std::move(manager)),
+      minimum(minimum), maximum(maximum), isClosed(isClosed) {}
+
+math::Vector3D Cylinder::normal(const math::Point3D &p) const {
+  return Shape::normal(p);
+}
+
+int Cylinder::intersect(const math::Ray &ray, float *ts) const {
+  return Shape::intersect(ray, ts);
+}
+
+float Cylinder::getMinimum(void) const { return minimum; }
+float Cylinder::getMaximum(void) const { return maximum; }
+bool Cylinder::getIsClosed(void) const { return isClosed; }
+
+ConeManager::ConeManager() {}
+
+math::Vector3D ConeManager::normal(const Shape &shape,
+                                   const math::Point3D &p) {
+  const auto &cone = static_cast<const Cylinder &>(shape);
+  auto dist = p.x() * p.x() + p.z() * p.z();
+  if (dist < cone.getMaximum() * cone.getMaximum() &&
+      p.y() >= cone.getMaximum() - Epsilon) {
+    return math::Vector3D(0.0F, 1.0F, 0.0F);
+  }
+  if (dist < cone.getMinimum() * cone.getMinimum() &&
+      p.y() <= cone.getMinimum() + Epsilon) {
+    return math::Vector3D(0.0F, -1.0F, 0.0F);
+  }
+  auto y = std::sqrt(dist);
+  return math::Vector3D(p.x(), p.y() > 0.0F ? -y : y, p.z());
+}
+
+int ConeManager::intersect(const Shape &shape, const math::Ray &ray,
+                           float *ts) {
+  const auto &cone = static_cast<const Cylinder &>(shape);
+  float o[3], d[3];
+  unpack(ray, o, d);
+  return kernels::intersectCone(o, d, cone.getMinimum(), cone.getMaximum(),
+                                cone.getIsClosed(), ts);
+}
+
+math::Bounds3D ConeManager::bounds(const Shape &shape) {
+  const auto &cone = static_cast<const Cylinder &>(shape);
+  auto r = std::max(std::fabs(cone.getMinimum()), std::fabs(cone.getMaximum()));
+  return math::Bounds3D(math::Point3D(-r, cone.getMinimum(), -r),
+                        math::Point3D(r, cone.getMaximum(), r));
+}
+
+Cone::Cone()
+    : Cone(Material(), identityTransform(), std::make_unique<ConeManager>()) {
+}
+
+Cone::Cone(Material material, std::unique_ptr<math::Transform4D> matrix,
+           std::unique_ptr<ConeManager> manager, float minimum, float maximum,
+           bool isClosed)
+    : Cylinder(std::move(material), std::move(matrix),
+               std::unique_ptr<ShapeManager>(std::move(manager)), minimum,
+               maximum, isClosed) {}
+
+math::Vector3D Cone::normal(const math::Point3D &p) const {
+  return Shape::normal(p);
+}
+
+int Cone::intersect(const math::Ray &ray, float *ts) const {
+  return Shape::intersect(ray, ts);
+}
+
+CubeManager::CubeManager() {}
+
+math::Vector3D CubeManager::normal(const Shape &, const math::Point3D &p) {
+  auto ax = std::fabs(p.x());
+  auto ay = std::fabs(p.y());
+  auto az = std::fabs(p.z());
+  auto maxc = std::max(ax, std::max(ay, az));
+  if (maxc == ax) {
+    return math::Vector3D(p.x(), 0.0F, 0.0F);
+  }
+  if (maxc == ay) {
+    return math::Vector3D(0.0F, p.y(), 0.0F);
+  }
+  return math::Vector3D(0.0F, 0.0F, p.z());
+}
+
+int CubeManager::intersect(const Shape &, const math::Ray &ray,
+                           float *ts) {
+  float o[3], d[3];
+  unpack(ray, o, d);
+  return kernels::intersectCube(o, d, ts);
+}
+
+math::Bounds3D CubeManager::bounds(const Shape &) {
+  return math::Bounds3D(math::Point3D(-1.0F, -1.0F, -1.0F),
+                        math::Point3D(1.0F, 1.0F, 1.0F));
+}
+
+Cube::Cube()
+    : Cube(Material(), identityTransform(), std::make_unique<CubeManager>()) {
+}
+
+Cube::Cube(Material material, std::unique_ptr<math::Transform4D> matrix,
+           std::unique_ptr<CubeManager> manager)
+    : Shape(nextShapeId(), 1.0F, std::move(material), std::move(matrix),
+            math::Point3D(0.0F, 0.0F, 0.0F), std::move(manager)) {}
+
+math::Vector3D Cube::normal(const math::Point3D &p) const {
+  return Shape::normal(p);
+}
+
+int Cube::intersect(const math::Ray &ray, float *ts) const {
+  return Shape::intersect(ray, ts);
+}
+} // namespace raytracer
+} // namespace liby
@@ -1,94 +1,178 @@
 #pragma once
 
-#include "line.hpp"
+#include "bounds3D.hpp"
 #include "material.hpp"
 #include "matrix4D.hpp"
+#include "ray.hpp"
 #include "vector3D.hpp"
 #include <memory>
 
+namespace liby {
 namespace raytracer {
+// offset used to push secondary ray origins off the surface they start on
+constexpr float Epsilon = 0.0001F;
+
+// most distances any shape reports for one ray (a capped double cone)
+constexpr int MaxShapeHits = 4;
+
 class ShapeManager;
 class Shape {
 public:
   Shape();
   Shape(float id, float radius, Material material,
-        std::unique_ptr<mathengine::Transform4D> matrix,
-        mathengine::Point3D center, std::unique_ptr<ShapeManager> manager);
+        std::unique_ptr<math::Transform4D> matrix, math::Point3D center,
+        std::unique_ptr<ShapeManager> manager);
   virtual ~Shape();
 
-  virtual mathengine::Vector3D normal(const mathengine::Point3D &) const;
-  virtual std::vector<float> intersect(const mathengine::Line &) const;
+  /**
+   * @brief Returns the world-space surface normal at the world-space point p.
+   */
+  virtual math::Vector3D normal(const math::Point3D &) const;
+
+  /**
+   * @brief Writes the distances along the world-space ray at which it
+   * crosses the shape, in no particular order, to ts and returns how many
+   * there are. ts must have room for MaxShapeHits values.
+   */
+  virtual int intersect(const math::Ray &, float *ts) const;
+
+  /**
+   * @brief Finds the nearest crossing with t in [tMin, tMax) and writes it
+   * to t. Returns false, leaving t alone, when there is none. The default
+   * goes through intersect(); shapes with many surfaces override it to
+   * prune with the closest hit found so far.
+   */
+  virtual bool closestHit(const math::Ray &ray, float tMin, float tMax,
+                          float *t) const;
+
+  /**
+   * @brief Returns true if the ray crosses the shape with t in
+   * [tMin, tMax), stopping at the first such crossing.
+   */
+  virtual bool occluded(const math::Ray &ray, float tMin, float tMax) const;
+
+  /**
+   * @brief Returns the world-space bounding box of the shape. Shapes that
+   * extend to infinity, such as planes, return Bounds3D::infinite().
+   */
+  virtual math::Bounds3D bounds(void) const;
+
+  float getId(void) const;
+  float getRadius(void) const;
+  const math::Point3D &getCenter(void) const;
+  const Material &getMaterial(void) const;
+  Material &getMaterial(void);
+  const math::Transform4D &getTransform(void) const;
+
+  /**
+   * @brief Returns the inverse of the transform, kept up to date by the
+   * constructors and setTransform() so rays and hit points never pay for it.
+   */
+  const math::Transform4D &getInverse(void) const;
+  void setTransform(const math::Transform4D &);
+  const ShapeManager *getManager(void) const;
 
 protected:
+  /**
+   * @brief Returns a fresh id for a new shape.
+   */
+  static float nextId(void);
+
   float id_;
   float radius_;
   Material material_;
-  mathengine::Point3D center_;
-  std::unique_ptr<mathengine::Transform4D> matrix_;
+  math::Point3D center_;
+  math::Transform4D matrix_;
+  math::Transform4D inverse_;
   std::unique_ptr<ShapeManager> manager_;
 };
 
+/**
+ * @brief Per-type geometry. Managers work in object space: the ray handed to
+ * intersect() and the point handed to normal() have already been mapped
+ * through the inverse of the shape's transform.
+ */
 class ShapeManager {
 public:
   ShapeManager();
   virtual ~ShapeManager();
 
-  virtual mathengine::Vector3D normal(const Shape &,
-                                      const mathengine::Point3D &) = 0;
-  virtual std::vector<float> intersect(const Shape &, const mathengine::Line &);
+  virtual math::Vector3D normal(const Shape &, const math::Point3D &) = 0;
+  virtual int intersect(const Shape &, const math::Ray &, float *ts);
+  virtual math::Bounds3D bounds(const Shape &);
 };
 
 class SphereManager : public ShapeManager {
 public:
   SphereManager();
-  mathengine::Vector3D normal(const Shape &, const mathengine::Point3D &);
-  std::vector<float> intersect(const Shape &, const mathengine::Line &);
+  math::Vector3D normal(const Shape &, const math::Point3D &);
+  int intersect(const Shape &, const math::Ray &, float *ts);
+  math::Bounds3D bounds(const Shape &);
 };
 
 class Sphere : public Shape {
 public:
   Sphere();
-  Sphere(Material material, std::unique_ptr<mathengine::Transform4D> matrix,
+  Sphere(Material material, std::unique_ptr<math::Transform4D> matrix,
          std::unique_ptr<SphereManager> manager);
 
-  mathengine::Vector3D normal(const mathengine::Point3D &) const;
-  std::vector<float> intersect(const mathengine::Line &) const;
+  math::Vector3D normal(const math::Point3D &) const;
+  int intersect(const math::Ray &, float *ts) const;
 };
 
 class PlaneManager : public ShapeManager {
 public:
   PlaneManager();
-  mathengine::Vector3D normal(const Shape &, const mathengine::Point3D &);
-  std::vector<float> intersect(const Shape &, const mathengine::Line &);
+  math::Vector3D normal(const Shape &, const math::Point3D &);
+  int intersect(const Shape &, const math::Ray &, float *ts);
+  math::Bounds3D bounds(const Shape &);
 };
 
+/**
+ * @brief The xz plane through the origin, before transformation.
+ */
 class Plane : public Shape {
 public:
   Plane();
-  Plane(Material material, std::unique_ptr<mathengine::Transform4D> matrix,
+  Plane(Material material, std::unique_ptr<math::Transform4D> matrix,
         std::unique_ptr<PlaneManager> manager);
 
-  mathengine::Vector3D normal(const mathengine::Point3D &) const;
-  std::vector<float> intersect(const mathengine::Line &) const;
+  math::Vector3D normal(const math::Point3D &) const;
+  int intersect(const math::Ray &, float *ts) const;
 };
 
 class CylinderManager : public ShapeManager {
 public:
   CylinderManager();
-  mathengine::Vector3D normal(const Shape &, const mathengine::Point3D &);
-  std::vector<float> intersect(const Shape &, const mathengine::Line &);
+  math::Vector3D normal(const Shape &, const math::Point3D &);
+  int intersect(const Shape &, const math::Ray &, float *ts);
+  math::Bounds3D bounds(const Shape &);
 };
 
+/**
+ * @brief Unit-radius cylinder around the y axis, truncated to
+ * (minimum, maximum) and optionally capped at both ends.
+ */
 class Cylinder : public Shape {
 public:
   Cylinder();
-  Cylinder(Material material, std::unique_ptr<mathengine::Transform4D> matrix,
-           std::unique_ptr<CylinderManager> manager);
+  Cylinder(Material material, std::unique_ptr<math::Transform4D> matrix,
+           std::unique_ptr<CylinderManager> manager,
+           float minimum = -INFINITY, float maximum = INFINITY,
+           bool isClosed = false);
 
-  mathengine::Vector3D normal(const mathengine::Point3D &) const;
-  std::vector<float> intersect(const mathengine::Line &) const;
+  math::Vector3D normal(const math::Point3D &) const;
+  int intersect(const math::Ray &, float *ts) const;
+
+  float getMinimum(void) const;
+  float getMaximum(void) const;
+  bool getIsClosed(void) const;
 
 protected:
+  Cylinder(Material material, std::unique_ptr<math::Transform4D> matrix,
+           std::unique_ptr<ShapeManager> manager, float minimum,
+           float maximum, bool isClosed);
+
   float minimum;
   float maximum;
   bool isClosed;
@@ -97,34 +181,45 @@ protected:
 class ConeManager : public ShapeManager {
 public:
   ConeManager();
-  mathengine::Vector3D normal(const Shape &, const mathengine::Point3D &);
-  std::vector<float> intersect(const Shape &, const mathengine::Line &);
+  math::Vector3D normal(const Shape &, const math::Point3D &);
+  int intersect(const Shape &, const math::Ray &, float *ts);
+  math::Bounds3D bounds(const Shape &);
 };
 
+/**
+ * @brief Double cone with its apex at the origin, opening along the y axis,
+ * truncated and capped like Cylinder.
+ */
 class Cone : public Cylinder {
 public:
   Cone();
-  Cone(Material material, std::unique_ptr<mathengine::Transform4D> matrix,
-       std::unique_ptr<ConeManager> manager);
+  Cone(Material material, std::unique_ptr<math::Transform4D> matrix,
+       std::unique_ptr<ConeManager> manager, float minimum = -INFINITY,
+       float maximum = INFINITY, bool isClosed = false);
 
-  mathengine::Vector3D normal(const mathengine::Point3D &) const;
-  std::vector<float> intersect(const mathengine::Line &) const;
+  math::Vector3D normal(const math::Point3D &) const;
+  int intersect(const math::Ray &, float *ts) const;
 };
 
 class CubeManager : public ShapeManager {
 public:
   CubeManager();
-  mathengine::Vector3D normal(const Shape &, const mathengine::Point3D &);
-  std::vector<float> intersect(const Shape &, const mathengine::Line &);
+  math::Vector3D normal(const Shape &, const math::Point3D &);
+  int intersect(const Shape &, const math::Ray &, float *ts);
+  math::Bounds3D bounds(const Shape &);
 };
 
+/**
+ * @brief Axis-aligned cube spanning [-1, 1] on every axis.
+ */
 class Cube : public Shape {
 public:
   Cube();
-  Cube(Material material, std::unique_ptr<mathengine::Transform4D> matrix,
+  Cube(Material material, std::unique_ptr<math::Transform4D> matrix,
        std::unique_ptr<CubeManager> manager);
 
-  mathengine::Vector3D normal(const mathengine::Point3D &) const;
-  std::vector<float> intersect(const mathengine::Line &) const;
+  math::Vector3D normal(const math::Point3D &) const;
+  int intersect(const math::Ray &, float *ts) const;
 };
 } // namespace raytracer
+} // namespace liby
@@ -0,0 +1,249 @@
+#pragma once
+
+#include "rayPacket.hpp"
+#include "shape.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace liby {
+namespace raytracer {
+/**
+ * @brief Object-space intersection routines for the built-in shapes, on
+ * plain floats so they inline into tight loops. The shape managers and
+ * ShapeStore both call these; every routine writes at most MaxShapeHits
+ * distances to ts, in no particular order, and returns how many it wrote.
+ *
+ * The packet forms take an object-space RayPacket and return, per lane, the
+ * near and far crossing in t0 <= t1 along with the lanes that have any. They
+ * repeat the scalar arithmetic operation for operation, so a lane reports
+ * exactly the distances the scalar routine would, provided the compiler
+ * fuses no multiply and add into one rounding on either side; the build
+ * passes -ffp-contract=off for that.
+ */
+namespace kernels {
+inline float dot3(const float *a, const float *b) {
+  return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+inline int intersectSphere(const float *o, const float *d,
+                           const float *center, float radius, float *ts) {
+  float oc[3] = {o[0] - center[0], o[1] - center[1], o[2] - center[2]};
+  auto a = dot3(d, d);
+  auto halfB = dot3(d, oc);
+
+  // b^2 - 4ac cancels badly for distant origins; measuring how far the line
+  // passes from the center keeps the discriminant accurate, and the roots
+  // are formed without subtracting nearly equal values
+  auto s = halfB / a;
+  float perpendicular[3] = {oc[0] - d[0] * s, oc[1] - d[1] * s,
+                            oc[2] - d[2] * s};
+  auto discriminant =
+      radius * radius - dot3(perpendicular, perpendicular);
+  if (discriminant < 0.0F) {
+    return 0;
+  }
+  auto c = dot3(oc, oc) - radius * radius;
+  auto root = std::sqrt(a * discriminant);
+  auto q = halfB < 0.0F ? root - halfB : -root - halfB;
+  auto t0 = c / q;
+  auto t1 = q / a;
+  if (q == 0.0F) {
+    t0 = t1;
+  }
+  ts[0] = std::min(t0, t1);
+  ts[1] = std::max(t0, t1);
+  return 2;
+}
+
+inline int intersectPlane(const float *o, const float *d, float *ts) {
+  if (std::fabs(d[1]) < Epsilon) {
+    return 0;
+  }
+  ts[0] = -o[1] / d[1];
+  return 1;
+}
+
+// caps sit at y = minimum and y = maximum; with isCone the cap radius is
+// |y| there, otherwise 1
+inline int intersectCaps(const float *o, const float *d, float minimum,
+                         float maximum, bool isCone, float *ts, int count) {
+  if (std::fabs(d[1]) < Epsilon) {
+    return count;
+  }
+  auto checkCap = [&](float t, float radius) {
+    auto x = o[0] + t * d[0];
+    auto z = o[2] + t * d[2];
+    return x * x + z * z <= radius * radius;
+  };
+  auto lower = (minimum - o[1]) / d[1];
+  if (checkCap(lower, isCone ? std::fabs(minimum) : 1.0F)) {
+    ts[count++] = lower;
+  }
+  auto upper = (maximum - o[1]) / d[1];
+  if (checkCap(upper, isCone ? std::fabs(maximum) : 1.0F)) {
+    ts[count++] = upper;
+  }
+  return count;
+}
+
+inline int intersectCylinder(const float *o, const float *d, float minimum,
+                             float maximum, bool isClosed, float *ts) {
+  int count = 0;
+  auto a = d[0] * d[0] + d[2] * d[2];
+  if (std::fabs(a) >= Epsilon) {
+    auto b = 2.0F * (o[0] * d[0] + o[2] * d[2]);
+    auto c = o[0] * o[0] + o[2] * o[2] - 1.0F;
+    auto discriminant = b * b - 4.0F * a * c;
+    if (discriminant >= 0.0F) {
+      auto root = std::sqrt(discriminant);
+      for (auto t : {(-b - root) / (2.0F * a), (-b + root) / (2.0F * a)}) {
+        auto y = o[1] + t * d[1];
+        if (minimum < y && y < maximum) {
+          ts[count++] = t;
+        }
+      }
+    }
+  }
+  if (!isClosed) {
+    return count;
+  }
+  return intersectCaps(o, d, minimum, maximum, false, ts, count);
+}
+
+inline int intersectCone(const float *o, const float *d, float minimum,
+                         float maximum, bool isClosed, float *ts) {
+  int count = 0;
+  auto a = d[0] * d[0] - d[1] * d[1] + d[2] * d[2];
+  auto b = 2.0F * (o[0] * d[0] - o[1] * d[1] + o[2] * d[2]);
+  auto c = o[0] * o[0] - o[1] * o[1] + o[2] * o[2];
+  auto inRange = [&](float t) {
+    auto y = o[1] + t * d[1];
+    return minimum < y && y < maximum;
+  };
+
+  if (std::fabs(a) < Epsilon) {
+    // ray parallel to one of the halves crosses the other one once
+    if (std::fabs(b) >= Epsilon) {
+      auto t = -c / (2.0F * b);
+      if (inRange(t)) {
+        ts[count++] = t;
+      }
+    }
+  } else {
+    auto discriminant = b * b - 4.0F * a * c;
+    if (discriminant >= 0.0F) {
+      auto root = std::sqrt(discriminant);
+      for (auto t : {(-b - root) / (2.0F * a), (-b + root) / (2.0F * a)}) {
+        if (inRange(t)) {
+          ts[count++] = t;
+        }
+      }
+    }
+  }
+  if (!isClosed) {
+    return count;
+  }
+  return intersectCaps(o, d, minimum, maximum, true, ts, count);
+}
+
+inline void checkAxis(float origin, float direction, float *tmin,
+                      float *tmax) {
+  auto tminNumerator = -1.0F - origin;
+  auto tmaxNumerator = 1.0F - origin;
+  if (std::fabs(direction) >= Epsilon) {
+    *tmin = tminNumerator / direction;
+    *tmax = tmaxNumerator / direction;
+  } else {
+    *tmin = tminNumerator * INFINITY;
+    *tmax = tmaxNumerator * INFINITY;
+  }
+  if (*tmin > *tmax) {
+    std::swap(*tmin, *tmax);
+  }
+}
+
+inline int intersectCube(const float *o, const float *d, float *ts) {
+  float xtmin, xtmax, ytmin, ytmax, ztmin, ztmax;
+  checkAxis(o[0], d[0], &xtmin, &xtmax);
+  checkAxis(o[1], d[1], &ytmin, &ytmax);
+  checkAxis(o[2], d[2], &ztmin, &ztmax);
+  auto tmin = std::max(xtmin, std::max(ytmin, ztmin));
+  auto tmax = std::min(xtmax, std::min(ytmax, ztmax));
+  if (tmin > tmax) {
+    return 0;
+  }
+  ts[0] = tmin;
+  ts[1] = tmax;
+  return 2;
+}
+
+template <typename FloatT>
+typename FloatT::Mask intersectSphere(const math::RayPacket<FloatT> &r,
+                                      const float *center, float radius,
+                                      FloatT *t0, FloatT *t1) {
+  using F = FloatT;
+  auto ocx = r.ox - F(center[0]);
+  auto ocy = r.oy - F(center[1]);
+  auto ocz = r.oz - F(center[2]);
+  auto a = r.dx * r.dx + r.dy * r.dy + r.dz * r.dz;
+  auto halfB = r.dx * ocx + r.dy * ocy + r.dz * ocz;
+  auto s = halfB / a;
+  auto px = ocx - r.dx * s;
+  auto py = ocy - r.dy * s;
+  auto pz = ocz - r.dz * s;
+  auto r2 = F(radius * radius);
+  auto discriminant = r2 - (px * px + py * py + pz * pz);
+  auto hit = discriminant >= F(0.0F);
+  if (none(hit)) {
+    return hit;
+  }
+  auto c = (ocx * ocx + ocy * ocy + ocz * ocz) - r2;
+  auto root = sqrt(a * max(discriminant, F(0.0F)));
+  auto q = select(halfB < F(0.0F), root - halfB, -root - halfB);
+  auto near = c / q;
+  auto far = q / a;
+  near = select((q <= F(0.0F)) & (q >= F(0.0F)), far, near);
+  *t0 = min(near, far);
+  *t1 = max(near, far);
+  return hit;
+}
+
+template <typename FloatT>
+typename FloatT::Mask intersectPlane(const math::RayPacket<FloatT> &r,
+                                     FloatT *t0, FloatT *t1) {
+  using F = FloatT;
+  auto hit = abs(r.dy) >= F(Epsilon);
+  *t0 = -r.oy / r.dy;
+  *t1 = *t0;
+  return hit;
+}
+
+template <typename FloatT>
+void checkAxis(FloatT origin, FloatT direction, FloatT *tmin,
+               FloatT *tmax) {
+  using F = FloatT;
+  auto tminNumerator = F(-1.0F) - origin;
+  auto tmaxNumerator = F(1.0F) - origin;
+  auto steep = abs(direction) >= F(Epsilon);
+  auto lo = select(steep, tminNumerator / direction,
+                   tminNumerator * F(INFINITY));
+  auto hi = select(steep, tmaxNumerator / direction,
+                   tmaxNumerator * F(INFINITY));
+  *tmin = min(lo, hi);
+  *tmax = max(lo, hi);
+}
+
+template <typename FloatT>
+typename FloatT::Mask intersectCube(const math::RayPacket<FloatT> &r,
+                                    FloatT *t0, FloatT *t1) {
+  FloatT xtmin, xtmax, ytmin, ytmax, ztmin, ztmax;
+  checkAxis(r.ox, r.dx, &xtmin, &xtmax);
+  checkAxis(r.oy, r.dy, &ytmin, &ytmax);
+  checkAxis(r.oz, r.dz, &ztmin, &ztmax);
+  *t0 = max(xtmin, max(ytmin, ztmin));
+  *t1 = min(xtmax, min(ytmax, ztmax));
+  return *t0 <= *t1;
+}
+} // namespace kernels
+} // namespace raytracer
+} // namespace liby
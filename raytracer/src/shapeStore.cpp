@@ -0,0 +1,416 @@
+#include "shapeStore.hpp"
+#include "shape.hpp"
+#include "shapeKernels.hpp"
+#include <typeinfo>
+
+namespace liby {
+namespace raytracer {
+namespace {
+template <typename S, typename M> bool isExactly(const Shape &shape) {
+  const auto *manager = shape.getManager();
+  return typeid(shape) == typeid(S) && manager &&
+         typeid(*manager) == typeid(M);
+}
+} // namespace
+
+PackedRay::PackedRay(const math::Ray &ray) : ray(&ray) {
+  const auto &o = ray.getOrigin();
+  const auto &d = ray.getDirection();
+  origin[0] = o.x();
+  origin[1] = o.y();
+  origin[2] = o.z();
+  direction[0] = d.x();
+  direction[1] = d.y();
+  direction[2] = d.z();
+}
+
+ShapeType ShapeStore::classify(const Shape &shape) {
+  // a subclass may override intersect() and a custom manager may change
+  // the geometry, so only the exact built-in pairs are packed
+  if (isExactly<Sphere, SphereManager>(shape)) {
+    return ShapeType::Sphere;
+  }
+  if (isExactly<Plane, PlaneManager>(shape)) {
+    return ShapeType::Plane;
+  }
+  if (isExactly<Cylinder, CylinderManager>(shape)) {
+    return ShapeType::Cylinder;
+  }
+  if (isExactly<Cone, ConeManager>(shape)) {
+    return ShapeType::Cone;
+  }
+  if (isExactly<Cube, CubeManager>(shape)) {
+    return ShapeType::Cube;
+  }
+  return ShapeType::Virtual;
+}
+
+void ShapeStore::clear(void) {
+  spheres_ = SphereTable();
+  planes_ = Table();
+  cylinders_ = CylinderTable();
+  cones_ = CylinderTable();
+  cubes_ = Table();
+  virtual_.clear();
+}
+
+void ShapeStore::Table::add(const Shape &shape) {
+  const auto &h = shape.getInverse();
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 4; j++) {
+      inverseRows[i * 4 + j].push_back(h(i, j));
+    }
+  }
+  shapes.push_back(&shape);
+}
+
+size_t ShapeStore::Table::size(void) const { return shapes.size(); }
+
+ShapeStore::Ref ShapeStore::add(const Shape &shape, ShapeStorage storage) {
+  auto type = storage == ShapeStorage::Packed ? classify(shape)
+                                              : ShapeType::Virtual;
+  auto addExtent = [&](CylinderTable &table) {
+    const auto &cylinder = static_cast<const Cylinder &>(shape);
+    table.add(shape);
+    table.minimum.push_back(cylinder.getMinimum());
+    table.maximum.push_back(cylinder.getMaximum());
+    table.isClosed.push_back(cylinder.getIsClosed());
+    return static_cast<uint32_t>(table.size() - 1);
+  };
+
+  switch (type) {
+  case ShapeType::Sphere: {
+    const auto &center = shape.getCenter();
+    spheres_.add(shape);
+    spheres_.centerX.push_back(center.x());
+    spheres_.centerY.push_back(center.y());
+    spheres_.centerZ.push_back(center.z());
+    spheres_.radius.push_back(shape.getRadius());
+    return {type, static_cast<uint32_t>(spheres_.size() - 1)};
+  }
+  case ShapeType::Plane:
+    planes_.add(shape);
+    return {type, static_cast<uint32_t>(planes_.size() - 1)};
+  case ShapeType::Cylinder:
+    return {type, addExtent(cylinders_)};
+  case ShapeType::Cone:
+    return {type, addExtent(cones_)};
+  case ShapeType::Cube:
+    cubes_.add(shape);
+    return {type, static_cast<uint32_t>(cubes_.size() - 1)};
+  case ShapeType::Virtual:
+    break;
+  }
+  virtual_.push_back(&shape);
+  return {ShapeType::Virtual, static_cast<uint32_t>(virtual_.size() - 1)};
+}
+
+const ShapeStore::Table &ShapeStore::table(ShapeType type) const {
+  switch (type) {
+  case ShapeType::Sphere:
+    return spheres_;
+  case ShapeType::Plane:
+    return planes_;
+  case ShapeType::Cylinder:
+    return cylinders_;
+  case ShapeType::Cone:
+    return cones_;
+  default:
+    return cubes_;
+  }
+}
+
+void ShapeStore::toObjectSpace(const Table &table, uint32_t k,
+                               const PackedRay &ray, float *o, float *d) {
+  const auto *m = table.inverseRows;
+  for (int i = 0; i < 3; i++) {
+    o[i] = m[i * 4][k] * ray.origin[0] + m[i * 4 + 1][k] * ray.origin[1] +
+           m[i * 4 + 2][k] * ray.origin[2] + m[i * 4 + 3][k];
+    d[i] = m[i * 4][k] * ray.direction[0] +
+           m[i * 4 + 1][k] * ray.direction[1] +
+           m[i * 4 + 2][k] * ray.direction[2];
+  }
+}
+
+template <ShapeType Type>
+int ShapeStore::hits(uint32_t k, const float *o, const float *d,
+                     float *ts) const {
+  if constexpr (Type == ShapeType::Sphere) {
+    float center[3] = {spheres_.centerX[k], spheres_.centerY[k],
+                       spheres_.centerZ[k]};
+    return kernels::intersectSphere(o, d, center, spheres_.radius[k], ts);
+  } else if constexpr (Type == ShapeType::Plane) {
+    return kernels::intersectPlane(o, d, ts);
+  } else if constexpr (Type == ShapeType::Cylinder) {
+    return kernels::intersectCylinder(o, d, cylinders_.minimum[k],
+                                      cylinders_.maximum[k],
+                                      cylinders_.isClosed[k], ts);
+  } else if constexpr (Type == ShapeType::Cone) {
+    return kernels::intersectCone(o, d, cones_.minimum[k], cones_.maximum[k],
+                                  cones_.isClosed[k], ts);
+  } else {
+    static_assert(Type == ShapeType::Cube, "no kernel for shape type");
+    return kernels::intersectCube(o, d, ts);
+  }
+}
+
+// with AnyHit the run stops at the first crossing in range
+template <ShapeType Type, bool AnyHit>
+bool ShapeStore::testRunOf(uint32_t first, uint32_t count,
+                           const PackedRay &ray, float tMin, float *tMax,
+                           uint32_t *index) const {
+  const auto &entries = table(Type);
+  auto found = false;
+  for (auto k = first; k < first + count; k++) {
+    float o[3], d[3], ts[MaxShapeHits];
+    toObjectSpace(entries, k, ray, o, d);
+    auto n = hits<Type>(k, o, d, ts);
+    for (int i = 0; i < n; i++) {
+      if (ts[i] >= tMin && ts[i] < *tMax) {
+        *tMax = ts[i];
+        *index = k;
+        found = true;
+      }
+    }
+    if (AnyHit && found) {
+      return true;
+    }
+  }
+  return found;
+}
+
+template <bool AnyHit>
+bool ShapeStore::testRun(ShapeType type, uint32_t first, uint32_t count,
+                         const PackedRay &ray, float tMin, float *tMax,
+                         uint32_t *index) const {
+  switch (type) {
+  case ShapeType::Sphere:
+    return testRunOf<ShapeType::Sphere, AnyHit>(first, count, ray, tMin,
+                                                tMax, index);
+  case ShapeType::Plane:
+    return testRunOf<ShapeType::Plane, AnyHit>(first, count, ray, tMin, tMax,
+                                               index);
+  case ShapeType::Cylinder:
+    return testRunOf<ShapeType::Cylinder, AnyHit>(first, count, ray, tMin,
+                                                  tMax, index);
+  case ShapeType::Cone:
+    return testRunOf<ShapeType::Cone, AnyHit>(first, count, ray, tMin, tMax,
+                                              index);
+  case ShapeType::Cube:
+    return testRunOf<ShapeType::Cube, AnyHit>(first, count, ray, tMin, tMax,
+                                              index);
+  case ShapeType::Virtual:
+    break;
+  }
+
+  auto found = false;
+  for (auto k = first; k < first + count; k++) {
+    if (AnyHit) {
+      // shapes with an early out of their own, such as meshes, use it
+      if (virtual_[k]->occluded(*ray.ray, tMin, *tMax)) {
+        *index = k;
+        return true;
+      }
+    } else if (virtual_[k]->closestHit(*ray.ray, tMin, *tMax, tMax)) {
+      *index = k;
+      found = true;
+    }
+  }
+  return found;
+}
+
+bool ShapeStore::closestHit(ShapeType type, uint32_t first, uint32_t count,
+                            const PackedRay &ray, float tMin, float *tMax,
+                            uint32_t *index) const {
+  return testRun<false>(type, first, count, ray, tMin, tMax, index);
+}
+
+bool ShapeStore::anyHit(ShapeType type, uint32_t first, uint32_t count,
+                        const PackedRay &ray, float tMin, float tMax) const {
+  uint32_t index;
+  return testRun<true>(type, first, count, ray, tMin, &tMax, &index);
+}
+
+template <typename FloatT, ShapeType Type, bool AnyHit>
+typename FloatT::Mask
+ShapeStore::testPacketOf(uint32_t first, uint32_t count,
+                         math::RayPacket<FloatT> &packet,
+                         typename FloatT::Mask active,
+                         uint32_t *index) const {
+  using F = FloatT;
+  const auto &entries = table(Type);
+  const auto *m = entries.inverseRows;
+  auto found = typename F::Mask(false);
+  for (auto k = first; k < first + count; k++) {
+    // move the packet into object space with the stored inverse
+    math::RayPacket<F> local;
+    local.ox = F(m[0][k]) * packet.ox + F(m[1][k]) * packet.oy +
+               F(m[2][k]) * packet.oz + F(m[3][k]);
+    local.oy = F(m[4][k]) * packet.ox + F(m[5][k]) * packet.oy +
+               F(m[6][k]) * packet.oz + F(m[7][k]);
+    local.oz = F(m[8][k]) * packet.ox + F(m[9][k]) * packet.oy +
+               F(m[10][k]) * packet.oz + F(m[11][k]);
+    local.dx = F(m[0][k]) * packet.dx + F(m[1][k]) * packet.dy +
+               F(m[2][k]) * packet.dz;
+    local.dy = F(m[4][k]) * packet.dx + F(m[5][k]) * packet.dy +
+               F(m[6][k]) * packet.dz;
+    local.dz = F(m[8][k]) * packet.dx + F(m[9][k]) * packet.dy +
+               F(m[10][k]) * packet.dz;
+
+    F t0, t1;
+    typename F::Mask crossed;
+    if constexpr (Type == ShapeType::Sphere) {
+      float center[3] = {spheres_.centerX[k], spheres_.centerY[k],
+                         spheres_.centerZ[k]};
+      crossed = kernels::intersectSphere(local, center, spheres_.radius[k],
+                                         &t0, &t1);
+    } else if constexpr (Type == ShapeType::Plane) {
+      crossed = kernels::intersectPlane(local, &t0, &t1);
+    } else {
+      static_assert(Type == ShapeType::Cube, "no packet kernel");
+      crossed = kernels::intersectCube(local, &t0, &t1);
+    }
+    crossed = crossed & active;
+    if (none(crossed)) {
+      continue;
+    }
+
+    // take the far crossing first so the near one wins when both are in
+    // range, as the scalar loop over both distances would
+    auto hit = typename F::Mask(false);
+    for (auto t : {t1, t0}) {
+      auto inRange = crossed & (t >= packet.tMin) & (t < packet.tMax);
+      packet.tMax = select(inRange, t, packet.tMax);
+      hit = hit | inRange;
+    }
+    for (int lane = 0, bits = hit.bits(); bits; lane++, bits >>= 1) {
+      if (bits & 1) {
+        index[lane] = k;
+      }
+    }
+    found = found | hit;
+    if (AnyHit) {
+      active = andNot(active, hit);
+      if (none(active)) {
+        break;
+      }
+    }
+  }
+  return found;
+}
+
+template <typename FloatT, bool AnyHit>
+typename FloatT::Mask
+ShapeStore::testPacket(ShapeType type, uint32_t first, uint32_t count,
+                       math::RayPacket<FloatT> &packet,
+                       typename FloatT::Mask active, uint32_t *index) const {
+  using F = FloatT;
+  switch (type) {
+  case ShapeType::Sphere:
+    return testPacketOf<F, ShapeType::Sphere, AnyHit>(first, count, packet,
+                                                      active, index);
+  case ShapeType::Plane:
+    return testPacketOf<F, ShapeType::Plane, AnyHit>(first, count, packet,
+                                                     active, index);
+  case ShapeType::Cube:
+    return testPacketOf<F, ShapeType::Cube, AnyHit>(first, count, packet,
+                                                    active, index);
+  default:
+    break;
+  }
+
+  // no packet kernel; run the scalar test on each active lane
+  alignas(32) float tMin[F::Width];
+  alignas(32) float tMax[F::Width];
+  packet.tMin.store(tMin);
+  packet.tMax.store(tMax);
+  auto hits = 0;
+  for (int lane = 0; lane < F::Width; lane++) {
+    if (!active[lane]) {
+      continue;
+    }
+    math::Ray ray(packet.origin(lane), packet.direction(lane));
+    if (testRun<AnyHit>(type, first, count, PackedRay(ray), tMin[lane],
+                        &tMax[lane], &index[lane])) {
+      hits |= 1 << lane;
+    }
+  }
+  packet.tMax = F::load(tMax);
+  return math::lanesFromBits<F>(hits);
+}
+
+template <typename FloatT>
+typename FloatT::Mask
+ShapeStore::closestHit(ShapeType type, uint32_t first, uint32_t count,
+                       math::RayPacket<FloatT> &packet,
+                       typename FloatT::Mask active, uint32_t *index) const {
+  return testPacket<FloatT, false>(type, first, count, packet, active, index);
+}
+
+template <typename FloatT>
+typename FloatT::Mask
+ShapeStore::anyHit(ShapeType type, uint32_t first, uint32_t count,
+                   const math::RayPacket<FloatT> &packet,
+                   typename FloatT::Mask active) const {
+  auto scratch = packet;
+  uint32_t index[FloatT::Width];
+  return testPacket<FloatT, true>(type, first, count, scratch, active, index);
+}
+
+template math::simd::Mask4
+ShapeStore::closestHit(ShapeType, uint32_t, uint32_t, math::RayPacket4 &,
+                       math::simd::Mask4, uint32_t *) const;
+template math::simd::Mask8
+ShapeStore::closestHit(ShapeType, uint32_t, uint32_t, math::RayPacket8 &,
+                       math::simd::Mask8, uint32_t *) const;
+template math::simd::Mask4
+ShapeStore::anyHit(ShapeType, uint32_t, uint32_t, const math::RayPacket4 &,
+                   math::simd::Mask4) const;
+template math::simd::Mask8
+ShapeStore::anyHit(ShapeType, uint32_t, uint32_t, const math::RayPacket8 &,
+                   math::simd::Mask8) const;
+
+int ShapeStore::intersect(Ref ref, const PackedRay &ray, float *ts) const {
+  if (ref.type == ShapeType::Virtual) {
+    return virtual_[ref.index]->intersect(*ray.ray, ts);
+  }
+  float o[3], d[3];
+  toObjectSpace(table(ref.type), ref.index, ray, o, d);
+  switch (ref.type) {
+  case ShapeType::Sphere:
+    return hits<ShapeType::Sphere>(ref.index, o, d, ts);
+  case ShapeType::Plane:
+    return hits<ShapeType::Plane>(ref.index, o, d, ts);
+  case ShapeType::Cylinder:
+    return hits<ShapeType::Cylinder>(ref.index, o, d, ts);
+  case ShapeType::Cone:
+    return hits<ShapeType::Cone>(ref.index, o, d, ts);
+  default:
+    return hits<ShapeType::Cube>(ref.index, o, d, ts);
+  }
+}
+
+const Shape *ShapeStore::getShape(Ref ref) const {
+  switch (ref.type) {
+  case ShapeType::Sphere:
+    return spheres_.shapes[ref.index];
+  case ShapeType::Plane:
+    return planes_.shapes[ref.index];
+  case ShapeType::Cylinder:
+    return cylinders_.shapes[ref.index];
+  case ShapeType::Cone:
+    return cones_.shapes[ref.index];
+  case ShapeType::Cube:
+    return cubes_.shapes[ref.index];
+  case ShapeType::Virtual:
+    break;
+  }
+  return virtual_[ref.index];
+}
+
+size_t ShapeStore::size(void) const {
+  return spheres_.size() + planes_.size() + cylinders_.size() +
+         cones_.size() + cubes_.size() + virtual_.size();
+}
+} // namespace raytracer
+} // namespace liby
@@ -0,0 +1,175 @@
+#pragma once
+
+#include "ray.hpp"
+#include "rayPacket.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace liby {
+namespace raytracer {
+class Shape;
+
+enum class ShapeStorage {
+  // every test goes through Shape::intersect and its ShapeManager
+  Virtual,
+  // built-in shapes are copied into per-type arrays and tested without
+  // virtual calls; anything else falls back to Virtual
+  Packed,
+};
+
+enum class ShapeType : uint8_t {
+  Sphere,
+  Plane,
+  Cylinder,
+  Cone,
+  Cube,
+  // any other shape or manager; tested through its virtual functions
+  Virtual,
+};
+
+/**
+ * @brief Ray in the flat form the packed kernels read, set up once per ray.
+ */
+struct PackedRay {
+  explicit PackedRay(const math::Ray &ray);
+
+  const math::Ray *ray;
+  float origin[3];
+  float direction[3];
+};
+
+/**
+ * @brief Intersection-only copy of a set of shapes, sorted by type into
+ * structure-of-arrays tables: the inverse transform one coefficient per
+ * array, then the per-type parameters (sphere center and radius, cylinder
+ * and cone extent). Consecutive entries of one type are tested by a loop
+ * over contiguous floats with the shape's kernel inlined, instead of two
+ * virtual calls through scattered heap objects.
+ *
+ * The store is a snapshot: shapes that are moved, or whose extent changes,
+ * need it rebuilt. Each entry keeps a pointer back to its Shape for shading.
+ */
+class ShapeStore {
+public:
+  struct Ref {
+    ShapeType type;
+    uint32_t index;
+  };
+
+  /**
+   * @brief Returns the table shape would be packed into; ShapeType::Virtual
+   * if it is not exactly one of the built-in shape and manager types.
+   */
+  static ShapeType classify(const Shape &shape);
+
+  void clear(void);
+
+  /**
+   * @brief Appends shape to the end of its type's table. Entries of one type
+   * added one after the other can be tested as a run by closestHit().
+   */
+  Ref add(const Shape &shape, ShapeStorage storage);
+
+  /**
+   * @brief Tests the count entries of type starting at first, keeping the
+   * nearest crossing with t in [tMin, tMax). On a hit tMax is lowered to it,
+   * index is set to the entry that was hit and true is returned.
+   */
+  bool closestHit(ShapeType type, uint32_t first, uint32_t count,
+                  const PackedRay &ray, float tMin, float *tMax,
+                  uint32_t *index) const;
+
+  /**
+   * @brief Returns true as soon as one of the count entries of type starting
+   * at first is crossed with t in [tMin, tMax); which one is not reported.
+   */
+  bool anyHit(ShapeType type, uint32_t first, uint32_t count,
+              const PackedRay &ray, float tMin, float tMax) const;
+
+  /**
+   * @brief Packet form of closestHit(): tests the run against the lanes in
+   * active, each against its own [tMin, tMax) range. Lanes that hit get
+   * their packet.tMax lowered and index[lane] set, and are returned.
+   * Spheres, planes and cubes are tested on all lanes at once; other types
+   * fall back to the scalar test lane by lane.
+   */
+  template <typename FloatT>
+  typename FloatT::Mask closestHit(ShapeType type, uint32_t first,
+                                   uint32_t count,
+                                   math::RayPacket<FloatT> &packet,
+                                   typename FloatT::Mask active,
+                                   uint32_t *index) const;
+
+  /**
+   * @brief Packet form of anyHit(); returns the lanes in active that are
+   * blocked by some entry of the run.
+   */
+  template <typename FloatT>
+  typename FloatT::Mask anyHit(ShapeType type, uint32_t first, uint32_t count,
+                               const math::RayPacket<FloatT> &packet,
+                               typename FloatT::Mask active) const;
+
+  /**
+   * @brief Same contract as Shape::intersect() for one entry.
+   */
+  int intersect(Ref ref, const PackedRay &ray, float *ts) const;
+
+  const Shape *getShape(Ref ref) const;
+  size_t size(void) const;
+
+private:
+  struct Table {
+    void add(const Shape &shape);
+    size_t size(void) const;
+
+    // row-major top three rows of the inverse transform, one array each
+    std::vector<float> inverseRows[12];
+    std::vector<const Shape *> shapes;
+  };
+
+  struct SphereTable : Table {
+    std::vector<float> centerX;
+    std::vector<float> centerY;
+    std::vector<float> centerZ;
+    std::vector<float> radius;
+  };
+
+  struct CylinderTable : Table {
+    std::vector<float> minimum;
+    std::vector<float> maximum;
+    std::vector<uint8_t> isClosed;
+  };
+
+  const Table &table(ShapeType type) const;
+  static void toObjectSpace(const Table &table, uint32_t k,
+                            const PackedRay &ray, float *o, float *d);
+  template <ShapeType Type>
+  int hits(uint32_t k, const float *o, const float *d, float *ts) const;
+  template <ShapeType Type, bool AnyHit>
+  bool testRunOf(uint32_t first, uint32_t count, const PackedRay &ray,
+                 float tMin, float *tMax, uint32_t *index) const;
+  template <bool AnyHit>
+  bool testRun(ShapeType type, uint32_t first, uint32_t count,
+               const PackedRay &ray, float tMin, float *tMax,
+               uint32_t *index) const;
+  template <typename FloatT, ShapeType Type, bool AnyHit>
+  typename FloatT::Mask testPacketOf(uint32_t first, uint32_t count,
+                                     math::RayPacket<FloatT> &packet,
+                                     typename FloatT::Mask active,
+                                     uint32_t *index) const;
+  template <typename FloatT, bool AnyHit>
+  typename FloatT::Mask testPacket(ShapeType type, uint32_t first,
+                                   uint32_t count,
+                                   math::RayPacket<FloatT> &packet,
+                                   typename FloatT::Mask active,
+                                   uint32_t *index) const;
+
+  SphereTable spheres_;
+  Table planes_;
+  CylinderTable cylinders_;
+  CylinderTable cones_;
+  Table cubes_;
+  std::vector<const Shape *> virtual_;
+};
+} // namespace raytracer
+} // namespace liby
@@ -0,0 +1,317 @@
+#include "threadPool.hpp"
+#include <algorithm>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace liby {
+namespace raytracer {
+namespace {
+thread_local const ThreadPool *currentPool = nullptr;
+thread_local unsigned int currentWorker = 0;
+
+/**
+ * @brief Moves the newest or oldest job of jobs that belongs to group, or
+ * any job if group is nullptr, into job.
+ */
+template <typename Job, typename Group>
+bool take(std::deque<Job> &jobs, const Group *group, bool newest, Job *job) {
+  auto matches = [group](const Job &j) {
+    return group == nullptr || j.group == group;
+  };
+  if (newest) {
+    auto found = std::find_if(jobs.rbegin(), jobs.rend(), matches);
+    if (found == jobs.rend()) {
+      return false;
+    }
+    *job = std::move(*found);
+    jobs.erase(std::next(found).base());
+    return true;
+  }
+  auto found = std::find_if(jobs.begin(), jobs.end(), matches);
+  if (found == jobs.end()) {
+    return false;
+  }
+  *job = std::move(*found);
+  jobs.erase(found);
+  return true;
+}
+
+#ifdef __linux__
+bool pin(pthread_t thread, unsigned int core) {
+  if (core >= CPU_SETSIZE) {
+    return false;
+  }
+  cpu_set_t cores;
+  CPU_ZERO(&cores);
+  CPU_SET(core, &cores);
+  return pthread_setaffinity_np(thread, sizeof(cores), &cores) == 0;
+}
+#endif
+} // namespace
+
+TaskGroup::TaskGroup(ThreadPool &pool) : pool_(pool) {}
+
+TaskGroup::~TaskGroup() {
+  try {
+    wait();
+  } catch (...) {
+  }
+}
+
+void TaskGroup::run(std::function<void()> job) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_++;
+  }
+  pool_.push({std::move(job), this});
+}
+
+void TaskGroup::wait(void) {
+  ThreadPool::Job job;
+  while (pool_.find(this, &job)) {
+    pool_.execute(job);
+  }
+  // the rest are running elsewhere; whatever they add to the group is
+  // picked up by the workers
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_.wait(lock, [this] { return pending_ == 0; });
+  if (error_) {
+    auto error = error_;
+    error_ = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+void TaskGroup::finish(std::exception_ptr error) {
+  // notified under the lock: the group may be destroyed as soon as its
+  // waiter gets the mutex
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (error && !error_) {
+    error_ = error;
+  }
+  if (--pending_ == 0) {
+    done_.notify_all();
+  }
+}
+
+ThreadPool::ThreadPool(unsigned int threads) {
+  if (threads == 0) {
+    threads = std::max(1U, std::thread::hardware_concurrency());
+  }
+  workers_.reserve(threads);
+  for (unsigned int i = 0; i < threads; i++) {
+    workers_.push_back(std::make_unique<Worker>());
+  }
+  // every deque exists before any worker starts looking for jobs to steal
+  for (unsigned int i = 0; i < threads; i++) {
+    workers_[i]->thread = std::thread([this, i] { work(i); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  jobReady_.notify_all();
+  for (auto &worker : workers_) {
+    worker->thread.join();
+  }
+}
+
+void ThreadPool::submit(std::function<void()> job) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_++;
+  }
+  push({std::move(job), nullptr});
+}
+
+void ThreadPool::parallelFor(size_t count,
+                             const std::function<void(size_t)> &body) {
+  parallelFor(0, count, 1, [&body](size_t first, size_t last) {
+    for (auto i = first; i < last; i++) {
+      body(i);
+    }
+  });
+}
+
+void ThreadPool::parallelFor(
+    size_t begin, size_t end, size_t grain,
+    const std::function<void(size_t, size_t)> &body) {
+  grain = std::max<size_t>(grain, 1);
+  if (end <= begin) {
+    return;
+  }
+  if (end - begin <= grain) {
+    body(begin, end);
+    return;
+  }
+  TaskGroup group(*this);
+  // keeps the first half and leaves the second for others, down to grain
+  std::function<void(size_t, size_t)> split = [&](size_t first,
+                                                  size_t last) {
+    while (last - first > grain) {
+      auto middle = first + (last - first) / 2;
+      group.run([&split, middle, last] { split(middle, last); });
+      last = middle;
+    }
+    body(first, last);
+  };
+  try {
+    split(begin, end);
+  } catch (...) {
+    // the queued halves still refer to split and body
+    try {
+      group.wait();
+    } catch (...) {
+    }
+    throw;
+  }
+  group.wait();
+}
+
+void ThreadPool::wait(void) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_.wait(lock, [this] { return pending_ == 0; });
+  if (error_) {
+    auto error = error_;
+    error_ = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+unsigned int ThreadPool::size(void) const {
+  return static_cast<unsigned int>(workers_.size());
+}
+
+bool ThreadPool::isWorkerThread(void) const { return currentPool == this; }
+
+bool ThreadPool::pinWorker(unsigned int worker, unsigned int core) {
+#ifdef __linux__
+  return worker < workers_.size() &&
+         pin(workers_[worker]->thread.native_handle(), core);
+#else
+  (void)worker;
+  (void)core;
+  return false;
+#endif
+}
+
+bool ThreadPool::pinWorkers(void) {
+  auto cores = std::max(1U, std::thread::hardware_concurrency());
+  auto pinned = true;
+  for (unsigned int i = 0; i < size(); i++) {
+    pinned = pinWorker(i, i % cores) && pinned;
+  }
+  return pinned;
+}
+
+bool ThreadPool::pinCurrentThread(unsigned int core) {
+#ifdef __linux__
+  return pin(pthread_self(), core);
+#else
+  (void)core;
+  return false;
+#endif
+}
+
+ThreadPool &ThreadPool::getDefault(void) {
+  static ThreadPool pool;
+  return pool;
+}
+
+void ThreadPool::push(Job job) {
+  if (isWorkerThread()) {
+    auto &worker = *workers_[currentWorker];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    worker.jobs.push_back(std::move(job));
+  } else {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shared_.push_back(std::move(job));
+  }
+  queued_++;
+  // taking the lock orders this against a worker between checking for
+  // jobs and going to sleep
+  { std::lock_guard<std::mutex> lock(mutex_); }
+  jobReady_.notify_one();
+}
+
+bool ThreadPool::find(const TaskGroup *group, Job *job) {
+  if (queued_ == 0) {
+    return false;
+  }
+  auto count = static_cast<unsigned int>(workers_.size());
+  auto self = isWorkerThread() ? currentWorker : count;
+  if (self < count) {
+    auto &worker = *workers_[self];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (take(worker.jobs, group, true, job)) {
+      queued_--;
+      return true;
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (take(shared_, group, false, job)) {
+      queued_--;
+      return true;
+    }
+  }
+  // victims are tried starting after the thief so thieves spread out
+  for (unsigned int i = 1; i <= count; i++) {
+    auto victim = (self + i) % count;
+    if (victim == self) {
+      continue;
+    }
+    auto &worker = *workers_[victim];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (take(worker.jobs, group, false, job)) {
+      queued_--;
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::execute(Job &job) {
+  std::exception_ptr error;
+  try {
+    job.run();
+  } catch (...) {
+    error = std::current_exception();
+  }
+  job.run = nullptr;
+  if (job.group) {
+    job.group->finish(error);
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (error && !error_) {
+    error_ = error;
+  }
+  if (--pending_ == 0) {
+    idle_.notify_all();
+  }
+}
+
+void ThreadPool::work(unsigned int index) {
+  currentPool = this;
+  currentWorker = index;
+  for (;;) {
+    Job job;
+    if (find(nullptr, &job)) {
+      execute(job);
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    jobReady_.wait(lock, [this] { return stopping_ || queued_ > 0; });
+    if (stopping_ && queued_ == 0) {
+      return;
+    }
+  }
+}
+} // namespace raytracer
+} // namespace liby
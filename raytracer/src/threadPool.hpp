@@ -0,0 +1,165 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace liby {
+namespace raytracer {
+class ThreadPool;
+
+/**
+ * @brief Jobs run on a ThreadPool that can be waited on together, apart
+ * from anything else the pool is running. Jobs may add further jobs to
+ * their own group or start and wait on groups of their own.
+ */
+class TaskGroup {
+public:
+  explicit TaskGroup(ThreadPool &pool);
+  /**
+   * @brief Waits for the group's jobs; an exception one of them threw is
+   * dropped.
+   */
+  ~TaskGroup();
+  TaskGroup(const TaskGroup &) = delete;
+  TaskGroup &operator=(const TaskGroup &) = delete;
+
+  void run(std::function<void()> job);
+
+  /**
+   * @brief Returns once every job of the group has finished, running the
+   * group's queued jobs on the calling thread meanwhile so that a worker
+   * waiting here does not sit idle or deadlock. Rethrows the first
+   * exception a job threw since the last wait().
+   */
+  void wait(void);
+
+private:
+  friend class ThreadPool;
+  void finish(std::exception_ptr error);
+
+  ThreadPool &pool_;
+  std::mutex mutex_;
+  std::condition_variable done_;
+  size_t pending_ = 0;
+  std::exception_ptr error_;
+};
+
+/**
+ * @brief Fixed set of worker threads with a deque of jobs each. A worker
+ * takes the newest job from its own deque, whose data is likely still in
+ * its cache, and when that is empty takes the oldest from the queue of
+ * jobs submitted from outside the pool or steals the oldest from another
+ * worker, which for split ranges is the largest piece left.
+ */
+class ThreadPool {
+public:
+  /**
+   * @brief Starts threads workers, or one per hardware thread when threads
+   * is zero.
+   */
+  explicit ThreadPool(unsigned int threads = 0);
+  ~ThreadPool();
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  void submit(std::function<void()> job);
+
+  /**
+   * @brief Runs body(i) for every i in [0, count) on the workers and returns
+   * once all of them have finished.
+   */
+  void parallelFor(size_t count, const std::function<void(size_t)> &body);
+
+  /**
+   * @brief Runs body(first, last) over pieces of [begin, end) at most grain
+   * long and returns once all of them have finished. The range is halved
+   * recursively, leaving one half for idle workers to steal, so the pieces
+   * spread out without one job per piece being queued up front. May be
+   * called from the pool's own workers.
+   */
+  void parallelFor(size_t begin, size_t end, size_t grain,
+                   const std::function<void(size_t, size_t)> &body);
+
+  /**
+   * @brief Blocks until every job passed to submit() has finished.
+   * Rethrows the first exception such a job threw since the last wait().
+   */
+  void wait(void);
+  unsigned int size(void) const;
+
+  /**
+   * @brief Returns true when called from one of this pool's workers.
+   */
+  bool isWorkerThread(void) const;
+
+  /**
+   * @brief Restricts worker to run on core. Returns false if the platform
+   * does not support it or the core does not exist.
+   */
+  bool pinWorker(unsigned int worker, unsigned int core);
+
+  /**
+   * @brief Pins worker i to core i, wrapping around when there are more
+   * workers than cores. Returns false if any of them failed.
+   */
+  bool pinWorkers(void);
+
+  /**
+   * @brief Restricts the calling thread to core, see pinWorker().
+   */
+  static bool pinCurrentThread(unsigned int core);
+
+  /**
+   * @brief Returns a process-wide pool sized to the hardware.
+   */
+  static ThreadPool &getDefault(void);
+
+private:
+  friend class TaskGroup;
+
+  struct Job {
+    std::function<void()> run;
+    // nullptr for jobs from submit()
+    TaskGroup *group;
+  };
+
+  struct Worker {
+    std::mutex mutex;
+    std::deque<Job> jobs;
+    std::thread thread;
+  };
+
+  /**
+   * @brief Queues job on the calling worker's deque, or on the shared
+   * queue when called from outside the pool.
+   */
+  void push(Job job);
+
+  /**
+   * @brief Takes a queued job, only one of group's unless group is
+   * nullptr. Returns false if there is none.
+   */
+  bool find(const TaskGroup *group, Job *job);
+  void execute(Job &job);
+  void work(unsigned int index);
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  // jobs queued from outside the pool
+  std::deque<Job> shared_;
+  std::atomic<size_t> queued_{0};
+  std::mutex mutex_;
+  std::condition_variable jobReady_;
+  std::condition_variable idle_;
+  size_t pending_ = 0;
+  bool stopping_ = false;
+  std::exception_ptr error_;
+};
+} // namespace raytracer
+} // namespace liby
@@ -0,0 +1,78 @@
+#include "tiling.hpp"
+#include <algorithm>
+#include <numeric>
+
+namespace liby {
+namespace raytracer {
+namespace {
+uint64_t spreadBits(uint32_t v) {
+  uint64_t x = v;
+  x = (x | (x << 16)) & 0x0000ffff0000ffffULL;
+  x = (x | (x << 8)) & 0x00ff00ff00ff00ffULL;
+  x = (x | (x << 4)) & 0x0f0f0f0f0f0f0f0fULL;
+  x = (x | (x << 2)) & 0x3333333333333333ULL;
+  x = (x | (x << 1)) & 0x5555555555555555ULL;
+  return x;
+}
+
+uint64_t mortonCode(uint32_t x, uint32_t y) {
+  return spreadBits(x) | (spreadBits(y) << 1);
+}
+
+/**
+ * @brief Distance of (x, y) along the Hilbert curve filling a side by side
+ * grid, side a power of two.
+ */
+uint64_t hilbertDistance(uint32_t side, uint32_t x, uint32_t y) {
+  uint64_t distance = 0;
+  for (auto s = side / 2; s > 0; s /= 2) {
+    uint32_t rx = (x & s) != 0;
+    uint32_t ry = (y & s) != 0;
+    distance += static_cast<uint64_t>(s) * s * ((3 * rx) ^ ry);
+    // rotate the quadrant so the curve inside it starts where the previous
+    // one ended
+    if (ry == 0) {
+      if (rx == 1) {
+        x = side - 1 - x;
+        y = side - 1 - y;
+      }
+      std::swap(x, y);
+    }
+  }
+  return distance;
+}
+} // namespace
+
+std::vector<uint32_t> tileOrder(int tilesX, int tilesY, TileOrder order) {
+  auto count = static_cast<size_t>(std::max(tilesX, 0)) *
+               static_cast<size_t>(std::max(tilesY, 0));
+  std::vector<uint32_t> tiles(count);
+  std::iota(tiles.begin(), tiles.end(), 0);
+  if (order == TileOrder::Scanline || count == 0) {
+    return tiles;
+  }
+  uint32_t side = 1;
+  while (side < static_cast<uint32_t>(std::max(tilesX, tilesY))) {
+    side *= 2;
+  }
+  std::vector<uint64_t> keys(count);
+  for (size_t i = 0; i < count; i++) {
+    auto x = static_cast<uint32_t>(i % tilesX);
+    auto y = static_cast<uint32_t>(i / tilesX);
+    keys[i] = order == TileOrder::Morton ? mortonCode(x, y)
+                                         : hilbertDistance(side, x, y);
+  }
+  std::sort(tiles.begin(), tiles.end(),
+            [&](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+  return tiles;
+}
+
+BlockLayout::BlockLayout(int width, int height)
+    : blocksX_(static_cast<size_t>((width + BlockSize - 1) / BlockSize)),
+      blocksY_(static_cast<size_t>((height + BlockSize - 1) / BlockSize)) {}
+
+size_t BlockLayout::getSize(void) const {
+  return blocksX_ * blocksY_ * BlockSize * BlockSize;
+}
+} // namespace raytracer
+} // namespace liby
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace liby {
+namespace raytracer {
+enum class TileOrder {
+  // row by row, left to right
+  Scanline,
+  // Z-order: sorted by the interleaved bits of the tile coordinates
+  Morton,
+  // along a Hilbert curve, so consecutive tiles always share an edge
+  Hilbert,
+};
+
+/**
+ * @brief Returns the row-major indices of the tiles of a tilesX by tilesY
+ * grid in the given order. A grid that is not a square power of two
+ * follows the curve over the smallest one enclosing it, skipping the tiles
+ * outside. Neighbouring tiles see much of the same geometry and textures,
+ * so taking them one after another keeps that data in cache.
+ */
+std::vector<uint32_t> tileOrder(int tilesX, int tilesY, TileOrder order);
+
+/**
+ * @brief Where the pixels of a framebuffer are stored: in blocks of 8x8,
+ * block rows top to bottom and blocks left to right, each block row-major.
+ * Edge blocks are padded out to full size. A tile made of whole blocks is
+ * one run of memory, so workers writing neighbouring tiles never share a
+ * cache line.
+ */
+class BlockLayout {
+public:
+  static constexpr int BlockSize = 8;
+
+  BlockLayout(int width, int height);
+
+  /**
+   * @brief Entries needed to hold the whole image, padding included.
+   */
+  size_t getSize(void) const;
+
+  size_t index(int x, int y) const {
+    auto block = static_cast<size_t>(y / BlockSize) * blocksX_ +
+                 static_cast<size_t>(x / BlockSize);
+    return block * BlockSize * BlockSize +
+           static_cast<size_t>(y % BlockSize) * BlockSize + x % BlockSize;
+  }
+
+private:
+  size_t blocksX_;
+  size_t blocksY_;
+};
+} // namespace raytracer
+} // namespace liby
@@ -0,0 +1,572 @@
+#include "triangleMesh.hpp"
+#include "simd.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace liby {
+namespace raytracer {
+namespace {
+// floats per block: three corners of three coordinates, a lane each
+constexpr int BlockFloats = 9 * TriangleMesh::BlockSize;
+
+// a slab test in float can put the far side of a box a few ulps short of
+// a triangle lying in its face; widening it by 2 * gamma(3) (Ize) keeps
+// rays along an edge from missing both leaves around it
+constexpr float FarPadding = 4.0e-7F;
+
+alignas(32) const float LaneIndex[TriangleMesh::BlockSize] = {
+    0.0F, 1.0F, 2.0F, 3.0F, 4.0F, 5.0F, 6.0F, 7.0F};
+
+// the edge functions lie on one side of zero for a ray inside the
+// triangle; det is zero only for a triangle seen edge-on or of zero area
+template <typename T>
+bool finishHit(T u, T v, T w, const float *z, float tMin, float tMax,
+               float *t) {
+  if ((u < 0 || v < 0 || w < 0) && (u > 0 || v > 0 || w > 0)) {
+    return false;
+  }
+  auto det = u + v + w;
+  if (det == 0) {
+    return false;
+  }
+  auto d = static_cast<float>((u * z[0] + v * z[1] + w * z[2]) / det);
+  if (!(d >= tMin && d < tMax)) {
+    return false;
+  }
+  *t = d;
+  return true;
+}
+
+/**
+ * @brief Watertight test of one triangle whose corners have been sheared
+ * into the ray's frame: x and y across the ray, z along it scaled so the
+ * ray reaches z = 1 at t = 1. An edge function that comes out exactly zero
+ * in float is redone, with the others, in double.
+ */
+bool hitSheared(const float *x, const float *y, const float *z, float tMin,
+                float tMax, float *t) {
+  auto u = x[2] * y[1] - y[2] * x[1];
+  auto v = x[0] * y[2] - y[0] * x[2];
+  auto w = x[1] * y[0] - y[1] * x[0];
+  if (u == 0.0F || v == 0.0F || w == 0.0F) {
+    auto ud = static_cast<double>(x[2]) * y[1] -
+              static_cast<double>(y[2]) * x[1];
+    auto vd = static_cast<double>(x[0]) * y[2] -
+              static_cast<double>(y[0]) * x[2];
+    auto wd = static_cast<double>(x[1]) * y[0] -
+              static_cast<double>(y[1]) * x[0];
+    return finishHit(ud, vd, wd, z, tMin, tMax, t);
+  }
+  return finishHit(u, v, w, z, tMin, tMax, t);
+}
+
+// a ray through an edge or vertex hits every triangle around it at the
+// same distance, give or take rounding; that is one crossing
+bool isRepeat(const float *ts, int count, float t) {
+  for (int i = 0; i < count; i++) {
+    if (std::fabs(ts[i] - t) <= 1.0e-5F * std::max(1.0F, std::fabs(t))) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// whether crossing a is kept over crossing b when only one fits: those in
+// front of the origin come first, then the nearer of two on the same side
+bool keepBefore(float a, float b) {
+  if ((a >= 0.0F) != (b >= 0.0F)) {
+    return a >= 0.0F;
+  }
+  return std::fabs(a) < std::fabs(b);
+}
+
+float distanceSquared(const math::Bounds3D &b, const float *p) {
+  auto sum = 0.0F;
+  for (int axis = 0; axis < 3; axis++) {
+    auto d = std::max(b.lo[axis] - p[axis], p[axis] - b.hi[axis]);
+    if (d > 0.0F) {
+      sum += d * d;
+    }
+  }
+  return sum;
+}
+
+/**
+ * @brief Squared distance from p to the nearest point of the triangle abc
+ * (Ericson, Real-Time Collision Detection 5.1.5).
+ */
+float distanceSquared(const math::Point3D &p, const math::Point3D &a,
+                      const math::Point3D &b, const math::Point3D &c) {
+  auto ab = b - a;
+  auto ac = c - a;
+  auto ap = p - a;
+  auto d1 = dot(ab, ap);
+  auto d2 = dot(ac, ap);
+  if (d1 <= 0.0F && d2 <= 0.0F) {
+    return dot(ap, ap);
+  }
+  auto bp = p - b;
+  auto d3 = dot(ab, bp);
+  auto d4 = dot(ac, bp);
+  if (d3 >= 0.0F && d4 <= d3) {
+    return dot(bp, bp);
+  }
+  auto vc = d1 * d4 - d3 * d2;
+  if (vc <= 0.0F && d1 >= 0.0F && d3 <= 0.0F) {
+    auto q = ap - ab * (d1 / (d1 - d3));
+    return dot(q, q);
+  }
+  auto cp = p - c;
+  auto d5 = dot(ab, cp);
+  auto d6 = dot(ac, cp);
+  if (d6 >= 0.0F && d5 <= d6) {
+    return dot(cp, cp);
+  }
+  auto vb = d5 * d2 - d1 * d6;
+  if (vb <= 0.0F && d2 >= 0.0F && d6 <= 0.0F) {
+    auto q = ap - ac * (d2 / (d2 - d6));
+    return dot(q, q);
+  }
+  auto va = d3 * d6 - d5 * d4;
+  if (va <= 0.0F && d4 - d3 >= 0.0F && d5 - d6 >= 0.0F) {
+    auto q = bp - (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    return dot(q, q);
+  }
+  auto denominator = 1.0F / (va + vb + vc);
+  auto q = ap - ab * (vb * denominator) - ac * (vc * denominator);
+  return dot(q, q);
+}
+} // namespace
+
+/**
+ * @brief An object-space ray with what the watertight test needs: kz is
+ * the axis the direction is largest along, kx and ky the other two in an
+ * order that keeps the frame right-handed, and sx, sy, sz the shear that
+ * maps the direction onto (0, 0, 1).
+ */
+struct TriangleMesh::WatertightRay {
+  explicit WatertightRay(const math::Ray &ray) {
+    const auto &o = ray.getOrigin();
+    const auto &d = ray.getDirection();
+    float direction[3] = {d.x(), d.y(), d.z()};
+    origin[0] = o.x();
+    origin[1] = o.y();
+    origin[2] = o.z();
+    kz = 0;
+    for (int axis = 0; axis < 3; axis++) {
+      invDirection[axis] = 1.0F / direction[axis];
+      if (std::fabs(direction[axis]) > std::fabs(direction[kz])) {
+        kz = axis;
+      }
+    }
+    kx = (kz + 1) % 3;
+    ky = (kx + 1) % 3;
+    if (direction[kz] < 0.0F) {
+      std::swap(kx, ky);
+    }
+    sx = direction[kx] / direction[kz];
+    sy = direction[ky] / direction[kz];
+    sz = 1.0F / direction[kz];
+  }
+
+  float origin[3];
+  float invDirection[3];
+  int kx;
+  int ky;
+  int kz;
+  float sx;
+  float sy;
+  float sz;
+};
+
+TriangleMeshManager::TriangleMeshManager() {}
+
+math::Vector3D TriangleMeshManager::normal(const Shape &shape,
+                                           const math::Point3D &p) {
+  return static_cast<const TriangleMesh &>(shape).localNormal(p);
+}
+
+int TriangleMeshManager::intersect(const Shape &shape, const math::Ray &ray,
+                                   float *ts) {
+  return static_cast<const TriangleMesh &>(shape).localIntersect(ray, ts);
+}
+
+math::Bounds3D TriangleMeshManager::bounds(const Shape &shape) {
+  return static_cast<const TriangleMesh &>(shape).getLocalBounds();
+}
+
+TriangleMesh::TriangleMesh(Material material,
+                           std::unique_ptr<math::Transform4D> matrix,
+                           std::unique_ptr<TriangleMeshManager> manager,
+                           const std::vector<math::Point3D> &vertices,
+                           const std::vector<uint32_t> &indices,
+                           const MeshSettings &settings)
+    : Shape(nextId(), 1.0F, std::move(material), std::move(matrix),
+            math::Point3D(0.0F, 0.0F, 0.0F), std::move(manager)),
+      indices_(indices), simd_(settings.simd) {
+  if (settings.maxLeafSize < 1 || settings.maxLeafSize > BlockSize) {
+    throw std::runtime_error("Invalid mesh settings");
+  }
+  if (indices.size() % 3 != 0) {
+    throw std::runtime_error("Mesh indices must come in threes");
+  }
+  for (auto index : indices) {
+    if (index >= vertices.size()) {
+      throw std::runtime_error("Mesh index out of range");
+    }
+  }
+  x_.reserve(vertices.size());
+  y_.reserve(vertices.size());
+  z_.reserve(vertices.size());
+  for (const auto &v : vertices) {
+    x_.push_back(v.x());
+    y_.push_back(v.y());
+    z_.push_back(v.z());
+    bounds_.expand(v);
+  }
+
+  // triangles of zero area can never be hit and stay out of the tree
+  auto triangles = getTriangleCount();
+  normals_.reserve(triangles);
+  std::vector<math::Bounds3D> boxes;
+  std::vector<uint32_t> kept;
+  for (size_t i = 0; i < triangles; i++) {
+    auto a = getVertex(indices_[3 * i]);
+    auto b = getVertex(indices_[3 * i + 1]);
+    auto c = getVertex(indices_[3 * i + 2]);
+    auto n = cross(b - a, c - a);
+    auto length = magnitude(n);
+    if (!(length > 0.0F)) {
+      normals_.push_back(math::Vector3D(0.0F, 0.0F, 0.0F));
+      continue;
+    }
+    normals_.push_back(n / length);
+    math::Bounds3D box;
+    box.expand(a);
+    box.expand(b);
+    box.expand(c);
+    boxes.push_back(box);
+    kept.push_back(static_cast<uint32_t>(i));
+  }
+
+  BVHSettings bvh;
+  bvh.method = settings.method;
+  bvh.threads = settings.threads;
+  bvh.maxLeafSize = settings.maxLeafSize;
+  bvh.traversalCost = settings.traversalCost;
+  auto order = BVH::buildNodes(boxes, bvh, nodes_);
+
+  // copy each leaf's corners into blocks of its own, one after another when
+  // the depth cap left it more triangles than a block holds; unused lanes
+  // of the last block repeat the leaf's first triangle so they hold
+  // ordinary numbers
+  for (auto &node : nodes_) {
+    if (node.count == 0) {
+      continue;
+    }
+    auto block = static_cast<uint32_t>(blockTriangles_.size() / BlockSize);
+    for (uint32_t first = 0; first < node.count; first += BlockSize) {
+      auto *corners = &*blocks_.insert(blocks_.end(), BlockFloats, 0.0F);
+      for (int lane = 0; lane < BlockSize; lane++) {
+        auto slot = node.offset +
+                    (first + lane < node.count ? first + lane : 0);
+        auto triangle = kept[order[slot]];
+        blockTriangles_.push_back(triangle);
+        for (int corner = 0; corner < 3; corner++) {
+          auto vertex = indices_[3 * triangle + corner];
+          corners[(3 * corner) * BlockSize + lane] = x_[vertex];
+          corners[(3 * corner + 1) * BlockSize + lane] = y_[vertex];
+          corners[(3 * corner + 2) * BlockSize + lane] = z_[vertex];
+        }
+      }
+    }
+    node.offset = block;
+  }
+}
+
+math::Vector3D TriangleMesh::normal(const math::Point3D &p) const {
+  return Shape::normal(p);
+}
+
+int TriangleMesh::intersect(const math::Ray &ray, float *ts) const {
+  return Shape::intersect(ray, ts);
+}
+
+bool TriangleMesh::closestHit(const math::Ray &ray, float tMin, float tMax,
+                              float *t) const {
+  WatertightRay local(transform(ray, inverse_));
+  auto found = false;
+  auto test = [&](uint32_t block, uint32_t count) {
+    float ts[BlockSize];
+    auto hits = testBlock(local, block, count, tMin, tMax, ts);
+    for (int lane = 0; hits != 0; lane++, hits >>= 1) {
+      if ((hits & 1) != 0 && ts[lane] < tMax) {
+        tMax = ts[lane];
+        found = true;
+      }
+    }
+    return false;
+  };
+  traverse(local, tMin, &tMax, test);
+  if (found) {
+    *t = tMax;
+  }
+  return found;
+}
+
+bool TriangleMesh::occluded(const math::Ray &ray, float tMin,
+                            float tMax) const {
+  WatertightRay local(transform(ray, inverse_));
+  auto test = [&](uint32_t block, uint32_t count) {
+    float ts[BlockSize];
+    return testBlock(local, block, count, tMin, tMax, ts) != 0;
+  };
+  return traverse(local, tMin, &tMax, test);
+}
+
+size_t TriangleMesh::getVertexCount(void) const { return x_.size(); }
+size_t TriangleMesh::getTriangleCount(void) const {
+  return indices_.size() / 3;
+}
+
+math::Point3D TriangleMesh::getVertex(size_t i) const {
+  return math::Point3D(x_[i], y_[i], z_[i]);
+}
+
+const std::vector<uint32_t> &TriangleMesh::getIndices(void) const {
+  return indices_;
+}
+
+const math::Bounds3D &TriangleMesh::getLocalBounds(void) const {
+  return bounds_;
+}
+
+template <typename Test>
+bool TriangleMesh::traverse(const WatertightRay &ray, float tMin,
+                            const float *tMax, Test &test) const {
+  if (nodes_.empty()) {
+    return false;
+  }
+  const auto *origin = ray.origin;
+  const auto *invDirection = ray.invDirection;
+  uint32_t stack[BVH::StackSize];
+  int size = 0;
+  uint32_t index = 0;
+  for (;;) {
+    const auto &node = nodes_[index];
+    auto near = tMin;
+    auto far = *tMax;
+    for (int i = 0; i < 3; i++) {
+      auto t0 = (node.bounds.lo[i] - origin[i]) * invDirection[i];
+      auto t1 = (node.bounds.hi[i] - origin[i]) * invDirection[i];
+      if (t0 > t1) {
+        std::swap(t0, t1);
+      }
+      t1 += std::fabs(t1) * FarPadding;
+      near = t0 > near ? t0 : near;
+      far = t1 < far ? t1 : far;
+    }
+    if (near <= far) {
+      if (node.count > 0) {
+        for (uint32_t first = 0; first < node.count; first += BlockSize) {
+          auto block = node.offset + first / BlockSize;
+          auto count = std::min<uint32_t>(node.count - first, BlockSize);
+          if (test(block, count)) {
+            return true;
+          }
+        }
+      } else {
+        // descend into the child on the near side of the split axis first
+        if (invDirection[node.axis] < 0.0F) {
+          stack[size++] = index + 1;
+          index = node.offset;
+        } else {
+          stack[size++] = node.offset;
+          index = index + 1;
+        }
+        continue;
+      }
+    }
+    if (size == 0) {
+      break;
+    }
+    index = stack[--size];
+  }
+  return false;
+}
+
+int TriangleMesh::testBlock(const WatertightRay &ray, uint32_t block,
+                            uint32_t count, float tMin, float tMax,
+                            float *ts) const {
+  return simd_ ? testBlockSimd(ray, block, count, tMin, tMax, ts)
+               : testBlockScalar(ray, block, count, tMin, tMax, ts);
+}
+
+int TriangleMesh::testBlockScalar(const WatertightRay &ray, uint32_t block,
+                                  uint32_t count, float tMin, float tMax,
+                                  float *ts) const {
+  const auto *corners = &blocks_[block * BlockFloats];
+  auto hits = 0;
+  for (uint32_t lane = 0; lane < count; lane++) {
+    float x[3], y[3], z[3];
+    for (int c = 0; c < 3; c++) {
+      const auto *corner = corners + 3 * c * BlockSize + lane;
+      auto ax = corner[ray.kx * BlockSize] - ray.origin[ray.kx];
+      auto ay = corner[ray.ky * BlockSize] - ray.origin[ray.ky];
+      auto az = corner[ray.kz * BlockSize] - ray.origin[ray.kz];
+      x[c] = ax - ray.sx * az;
+      y[c] = ay - ray.sy * az;
+      z[c] = ray.sz * az;
+    }
+    if (hitSheared(x, y, z, tMin, tMax, &ts[lane])) {
+      hits |= 1 << lane;
+    }
+  }
+  return hits;
+}
+
+int TriangleMesh::testBlockSimd(const WatertightRay &ray, uint32_t block,
+                                uint32_t count, float tMin, float tMax,
+                                float *ts) const {
+  using math::simd::Float8;
+  using math::simd::Mask8;
+  const auto *corners = &blocks_[block * BlockFloats];
+  Float8 x[3], y[3], z[3];
+  for (int c = 0; c < 3; c++) {
+    const auto *corner = corners + 3 * c * BlockSize;
+    auto ax = Float8::load(corner + ray.kx * BlockSize) -
+              Float8(ray.origin[ray.kx]);
+    auto ay = Float8::load(corner + ray.ky * BlockSize) -
+              Float8(ray.origin[ray.ky]);
+    auto az = Float8::load(corner + ray.kz * BlockSize) -
+              Float8(ray.origin[ray.kz]);
+    x[c] = ax - Float8(ray.sx) * az;
+    y[c] = ay - Float8(ray.sy) * az;
+    z[c] = Float8(ray.sz) * az;
+  }
+  auto u = x[2] * y[1] - y[2] * x[1];
+  auto v = x[0] * y[2] - y[0] * x[2];
+  auto w = x[1] * y[0] - y[1] * x[0];
+
+  Float8 zero(0.0F);
+  auto valid = Float8::load(LaneIndex) < Float8(static_cast<float>(count));
+  auto negative = (u < zero) | (v < zero) | (w < zero);
+  auto positive = (u > zero) | (v > zero) | (w > zero);
+  auto isZero = [zero](Float8 e) { return ~((e < zero) | (e > zero)); };
+  auto onEdge = valid & (isZero(u) | isZero(v) | isZero(w));
+  auto t = (u * z[0] + v * z[1] + w * z[2]) / (u + v + w);
+  Mask8 hit = andNot(valid, onEdge | (negative & positive)) &
+              (t >= Float8(tMin)) & (t < Float8(tMax));
+  t.store(ts);
+  auto hits = hit.bits();
+
+  // lanes with an edge function of zero go through the scalar test, which
+  // settles them in double precision
+  auto edges = onEdge.bits();
+  if (edges != 0) {
+    alignas(32) float lanes[9][BlockSize];
+    for (int c = 0; c < 3; c++) {
+      x[c].store(lanes[c]);
+      y[c].store(lanes[3 + c]);
+      z[c].store(lanes[6 + c]);
+    }
+    for (int lane = 0; edges != 0; lane++, edges >>= 1) {
+      if ((edges & 1) == 0) {
+        continue;
+      }
+      float lx[3], ly[3], lz[3];
+      for (int c = 0; c < 3; c++) {
+        lx[c] = lanes[c][lane];
+        ly[c] = lanes[3 + c][lane];
+        lz[c] = lanes[6 + c][lane];
+      }
+      if (hitSheared(lx, ly, lz, tMin, tMax, &ts[lane])) {
+        hits |= 1 << lane;
+      }
+    }
+  }
+  return hits;
+}
+
+int TriangleMesh::localIntersect(const math::Ray &ray, float *ts) const {
+  WatertightRay local(ray);
+  auto count = 0;
+  auto tMax = INFINITY;
+  // when there are too many crossings, keeps the nearest in front of the
+  // origin and fills what room is left with the nearest behind it
+  auto test = [&](uint32_t block, uint32_t triangles) {
+    float hits[BlockSize];
+    auto mask = testBlock(local, block, triangles, -INFINITY, tMax, hits);
+    for (int lane = 0; mask != 0; lane++, mask >>= 1) {
+      if ((mask & 1) == 0 || isRepeat(ts, count, hits[lane])) {
+        continue;
+      }
+      if (count < MaxShapeHits) {
+        ts[count++] = hits[lane];
+        continue;
+      }
+      auto worst = 0;
+      for (int i = 1; i < count; i++) {
+        if (keepBefore(ts[worst], ts[i])) {
+          worst = i;
+        }
+      }
+      if (keepBefore(hits[lane], ts[worst])) {
+        ts[worst] = hits[lane];
+      }
+    }
+    return false;
+  };
+  traverse(local, -INFINITY, &tMax, test);
+  return count;
+}
+
+math::Vector3D TriangleMesh::localNormal(const math::Point3D &p) const {
+  // branch and bound: subtrees whose box is farther than the nearest
+  // triangle found so far are skipped
+  float point[3] = {p.x(), p.y(), p.z()};
+  auto best = INFINITY;
+  uint32_t nearest = 0;
+  // a pop and two pushes per level of the tree
+  uint32_t stack[BVH::StackSize + 1];
+  int size = 0;
+  if (!nodes_.empty()) {
+    stack[size++] = 0;
+  }
+  while (size > 0) {
+    auto index = stack[--size];
+    const auto &node = nodes_[index];
+    if (distanceSquared(node.bounds, point) >= best) {
+      continue;
+    }
+    if (node.count == 0) {
+      // the nearer child goes on top of the stack
+      auto first = index + 1;
+      auto second = node.offset;
+      if (distanceSquared(nodes_[first].bounds, point) <
+          distanceSquared(nodes_[second].bounds, point)) {
+        std::swap(first, second);
+      }
+      stack[size++] = first;
+      stack[size++] = second;
+      continue;
+    }
+    for (uint32_t lane = 0; lane < node.count; lane++) {
+      auto triangle = blockTriangles_[node.offset * BlockSize + lane];
+      auto d = distanceSquared(p, getVertex(indices_[3 * triangle]),
+                               getVertex(indices_[3 * triangle + 1]),
+                               getVertex(indices_[3 * triangle + 2]));
+      if (d < best) {
+        best = d;
+        nearest = triangle;
+      }
+    }
+  }
+  if (best == INFINITY) {
+    return math::Vector3D(0.0F, 1.0F, 0.0F);
+  }
+  return normals_[nearest];
+}
+} // namespace raytracer
+} // namespace liby
@@ -0,0 +1,145 @@
+#pragma once
+
+#include "bvh.hpp"
+#include "shape.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace liby {
+namespace raytracer {
+struct MeshSettings {
+  BVHBuildMethod method = BVHBuildMethod::BinnedSAH;
+  // triangles per leaf, from 1 to TriangleMesh::BlockSize; a leaf is tested
+  // as one block however many it holds, and the rare leaf left larger at
+  // the BVH's depth cap as several
+  int maxLeafSize = 8;
+  // cost of visiting a node relative to testing one triangle; a leaf costs
+  // one block test however full it is, so the default leans towards full
+  // leaves
+  float traversalCost = 8.0F;
+  // test a leaf's triangles side by side in SIMD lanes rather than one after
+  // another; both give the same hits
+  bool simd = true;
+  // worker threads used for the build, as in BVHSettings
+  unsigned int threads = 0;
+};
+
+class TriangleMesh;
+
+/**
+ * @brief Object-space queries of a TriangleMesh, for the generic Shape
+ * paths such as intersect() and normal().
+ */
+class TriangleMeshManager : public ShapeManager {
+public:
+  TriangleMeshManager();
+  math::Vector3D normal(const Shape &, const math::Point3D &);
+
+  /**
+   * @brief Reports the ray's crossings of the mesh, in front of its origin
+   * and behind. When there are more than MaxShapeHits, the nearest ones in
+   * front are kept first and any room left goes to the nearest behind, so
+   * the hit closestHit() finds is always among them. A crossing through an
+   * edge or vertex is reported once.
+   */
+  int intersect(const Shape &, const math::Ray &, float *ts);
+  math::Bounds3D bounds(const Shape &);
+};
+
+/**
+ * @brief Triangles sharing one list of vertices. The vertices are stored a
+ * coordinate per array and each triangle as three indices into them. For
+ * ray queries the triangles are grouped into leaves of a BVH of the mesh's
+ * own, and each leaf's corners are copied into a block laid out coordinate
+ * by coordinate, BlockSize lanes wide, that the SIMD test reads with one
+ * load per coordinate: one AVX register, or two SSE ones.
+ *
+ * The ray-triangle test is the watertight one of Woop, Benthin and Wald:
+ * corners are sheared into the ray's frame and the edge functions, redone
+ * in double precision when one comes out zero, give the same answer for
+ * an edge from either side. A ray through a shared edge or vertex always
+ * hits one of the triangles around it. Triangles count as hit from both
+ * sides; those of zero area are never hit.
+ */
+class TriangleMesh : public Shape {
+public:
+  static constexpr int BlockSize = 8;
+
+  /**
+   * @brief indices holds three entries per triangle, each a position in
+   * vertices. Throws std::runtime_error if an index is out of range or the
+   * settings are invalid.
+   */
+  TriangleMesh(Material material, std::unique_ptr<math::Transform4D> matrix,
+               std::unique_ptr<TriangleMeshManager> manager,
+               const std::vector<math::Point3D> &vertices,
+               const std::vector<uint32_t> &indices,
+               const MeshSettings &settings = MeshSettings());
+
+  /**
+   * @brief Returns the normal of the triangle nearest p.
+   */
+  math::Vector3D normal(const math::Point3D &) const;
+  int intersect(const math::Ray &, float *ts) const;
+  bool closestHit(const math::Ray &ray, float tMin, float tMax,
+                  float *t) const;
+  bool occluded(const math::Ray &ray, float tMin, float tMax) const;
+
+  size_t getVertexCount(void) const;
+  size_t getTriangleCount(void) const;
+  math::Point3D getVertex(size_t) const;
+  const std::vector<uint32_t> &getIndices(void) const;
+
+  /**
+   * @brief Returns the bounds of the vertices before transformation.
+   */
+  const math::Bounds3D &getLocalBounds(void) const;
+
+private:
+  friend class TriangleMeshManager;
+  struct WatertightRay;
+
+  /**
+   * @brief Walks the nodes the object-space ray crosses in [tMin, *tMax)
+   * front to back and hands each of a leaf's blocks, with the triangles it
+   * holds, to test, which may lower *tMax. Stops and returns true as soon
+   * as test does.
+   */
+  template <typename Test>
+  bool traverse(const WatertightRay &ray, float tMin, const float *tMax,
+                Test &test) const;
+
+  /**
+   * @brief Tests the first count triangles of block against the ray and
+   * returns a bit per lane hit with t in [tMin, tMax), its distance in
+   * ts[lane].
+   */
+  int testBlock(const WatertightRay &ray, uint32_t block, uint32_t count,
+                float tMin, float tMax, float *ts) const;
+  int testBlockScalar(const WatertightRay &ray, uint32_t block,
+                      uint32_t count, float tMin, float tMax,
+                      float *ts) const;
+  int testBlockSimd(const WatertightRay &ray, uint32_t block, uint32_t count,
+                    float tMin, float tMax, float *ts) const;
+
+  int localIntersect(const math::Ray &ray, float *ts) const;
+  math::Vector3D localNormal(const math::Point3D &p) const;
+
+  std::vector<float> x_;
+  std::vector<float> y_;
+  std::vector<float> z_;
+  std::vector<uint32_t> indices_;
+  // unit normal per triangle, zero for those of zero area
+  std::vector<math::Vector3D> normals_;
+  math::Bounds3D bounds_;
+  // leaves refer to blocks: offset is the first block, count the leaf's
+  // triangles, in ceil(count / BlockSize) consecutive blocks
+  std::vector<BVH::Node> nodes_;
+  // per block, for each corner and then each axis, BlockSize floats
+  std::vector<float> blocks_;
+  // per block, the triangle in each lane
+  std::vector<uint32_t> blockTriangles_;
+  bool simd_;
+};
+} // namespace raytracer
+} // namespace liby
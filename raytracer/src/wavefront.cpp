@@ -0,0 +1,337 @@
+#include "wavefront.hpp"
+#include "shading.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <typeindex>
+#include <vector>
+
+namespace liby {
+namespace raytracer {
+namespace {
+#ifdef LIBY_SIMD_AVX
+using Packet = math::RayPacket8;
+#else
+using Packet = math::RayPacket4;
+#endif
+
+// pixel block whose camera rays fill one packet, as in render()
+constexpr int BlockWidth = Packet::Width / 2;
+constexpr int BlockHeight = 2;
+
+const math::RGBA Black(0.0F, 0.0F, 0.0F);
+
+// queue entries handed to a worker at a time; a multiple of the packet
+// width so that no packet straddles two chunks
+constexpr size_t ChunkSize = 1024;
+
+// bounce waiting to be traced and the pixel its color goes to
+struct PathRay {
+  Bounce bounce;
+  uint32_t pixel;
+};
+
+struct ShadowRay {
+  math::Point3D origin;
+  math::Vector3D direction;
+  float distance;
+};
+
+// path ray that hit something, with the key the hits are shaded in order of
+struct Hit {
+  uint32_t path;
+  const Material *material;
+  std::type_index pattern;
+};
+
+void forChunks(ThreadPool &pool, size_t count,
+               const std::function<void(size_t, size_t)> &body) {
+  auto chunks = (count + ChunkSize - 1) / ChunkSize;
+  pool.parallelFor(chunks, [&](size_t chunk) {
+    auto begin = chunk * ChunkSize;
+    body(begin, std::min(begin + ChunkSize, count));
+  });
+}
+
+std::type_index patternType(const Material &material) {
+  auto pattern = material.getPattern();
+  if (!pattern || !pattern->getManager()) {
+    return typeid(void);
+  }
+  return typeid(*pattern->getManager());
+}
+
+void extend(const World &world, bool packets, const PathRay *paths,
+            size_t count, Intersection *hits, uint8_t *found) {
+  if (!packets) {
+    for (size_t i = 0; i < count; i++) {
+      found[i] = world.closestHit(paths[i].bounce.ray, 0.0F, INFINITY,
+                                  &hits[i]);
+    }
+    return;
+  }
+  for (size_t i = 0; i < count; i += Packet::Width) {
+    auto n = static_cast<int>(std::min<size_t>(Packet::Width, count - i));
+    math::Point3D origins[Packet::Width];
+    math::Vector3D directions[Packet::Width];
+    for (int k = 0; k < n; k++) {
+      origins[k] = paths[i + k].bounce.ray.getOrigin();
+      directions[k] = paths[i + k].bounce.ray.getDirection();
+    }
+    auto mask = world.closestHit(Packet::fromRays(origins, directions, n),
+                                 hits + i);
+    for (int k = 0; k < n; k++) {
+      found[i + k] = mask[k];
+    }
+  }
+}
+
+void traceShadows(const World &world, bool packets, const ShadowRay *rays,
+                  size_t count, uint8_t *blocked) {
+  if (!packets) {
+    for (size_t i = 0; i < count; i++) {
+      blocked[i] = world.occluded(math::Ray(rays[i].origin, rays[i].direction),
+                                  0.0F, rays[i].distance);
+    }
+    return;
+  }
+  for (size_t i = 0; i < count; i += Packet::Width) {
+    auto n = static_cast<int>(std::min<size_t>(Packet::Width, count - i));
+    math::Point3D origins[Packet::Width];
+    math::Vector3D directions[Packet::Width];
+    alignas(32) float tMax[Packet::Width];
+    for (int k = 0; k < Packet::Width; k++) {
+      if (k < n) {
+        origins[k] = rays[i + k].origin;
+        directions[k] = rays[i + k].direction;
+      }
+      tMax[k] = k < n ? rays[i + k].distance : 0.0F;
+    }
+    auto packet = Packet::fromRays(origins, directions, n);
+    packet.tMax = Packet::Float::load(tMax);
+    auto mask = world.occluded(packet);
+    for (int k = 0; k < n; k++) {
+      blocked[i + k] = mask[k];
+    }
+  }
+}
+
+} // namespace
+
+void renderWavefront(const Camera &camera, const World &world,
+                     const RenderSettings &settings, ThreadPool &pool,
+                     Canvas &image) {
+  if (settings.waveSize <= 0) {
+    throw std::runtime_error("Wave size must be positive");
+  }
+  auto width = camera.getHsize();
+  auto height = camera.getVsize();
+  // whole bands of block rows, about waveSize pixels each
+  auto bandHeight = std::max(settings.waveSize / width / BlockHeight, 1) *
+                    BlockHeight;
+  auto maxDepth = std::min(settings.bounces.maxDepth, MaxBounceDepth);
+  const auto &lights = world.getLights();
+  auto everyLight = world.getLightSettings().mode == LightSampling::All;
+
+  // queues are kept across waves so that they are allocated once
+  std::vector<PathRay> paths;
+  std::vector<PathRay> bounces;
+  std::vector<uint8_t> bounceCounts;
+  std::vector<Intersection> hits;
+  std::vector<uint8_t> found;
+  std::vector<Hit> shading;
+  std::vector<uint32_t> order;
+  std::vector<Computations> comps;
+  std::vector<ShadowRay> shadows;
+  std::vector<uint8_t> blocked;
+  std::vector<math::RGBA> colors;
+  std::vector<math::RGBA> pixels;
+
+  for (auto y0 = 0; y0 < height; y0 += bandHeight) {
+    auto y1 = std::min(y0 + bandHeight, height);
+    pixels.assign(static_cast<size_t>(y1 - y0) * width, Black);
+
+    // camera rays go out block by block, in the pixel blocks render()
+    // traces as one packet, so that consecutive rays stay neighbours
+    paths.clear();
+    for (auto by = y0; by < y1; by += BlockHeight) {
+      for (auto bx = 0; bx < width; bx += BlockWidth) {
+        for (auto y = by; y < std::min(by + BlockHeight, y1); y++) {
+          for (auto x = bx; x < std::min(bx + BlockWidth, width); x++) {
+            auto pixel = static_cast<uint32_t>((y - y0) * width + x);
+            paths.push_back({{math::Ray(), 1.0F, maxDepth}, pixel});
+          }
+        }
+      }
+    }
+    forChunks(pool, paths.size(), [&](size_t begin, size_t end) {
+      for (auto i = begin; i < end; i++) {
+        auto pixel = static_cast<int>(paths[i].pixel);
+        paths[i].bounce.ray =
+            camera.rayForPixel(pixel % width, y0 + pixel / width);
+      }
+    });
+
+    while (!paths.empty()) {
+      hits.resize(paths.size());
+      found.resize(paths.size());
+      forChunks(pool, paths.size(), [&](size_t begin, size_t end) {
+        extend(world, settings.packets, &paths[begin], end - begin,
+               &hits[begin], &found[begin]);
+      });
+
+      // hits stay in ray order, which keeps neighbouring shadow rays
+      // together; order visits them grouped by pattern type and material
+      shading.clear();
+      for (uint32_t i = 0; i < paths.size(); i++) {
+        if (found[i]) {
+          const auto &material = materialOf(hits[i]);
+          shading.push_back({i, &material, patternType(material)});
+        }
+      }
+      order.resize(shading.size());
+      for (uint32_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+      }
+      std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        const auto &p = shading[a];
+        const auto &q = shading[b];
+        if (p.pattern != q.pattern) {
+          return p.pattern < q.pattern;
+        }
+        if (p.material != q.material) {
+          return std::less<const Material *>()(p.material, q.material);
+        }
+        return a < b;
+      });
+
+      comps.resize(shading.size());
+      forChunks(pool, shading.size(), [&](size_t begin, size_t end) {
+        // refraction needs every hit along the ray to work out n1 and n2
+        thread_local std::vector<Intersection> xs;
+        for (auto i = begin; i < end; i++) {
+          const auto &ray = paths[shading[i].path].bounce.ray;
+          if (shading[i].material->getTransparency() > 0.0F) {
+            world.intersect(ray, xs);
+            comps[i] = prepareRefraction(hits[shading[i].path], ray, xs);
+          } else {
+            comps[i] = prepareComputations(hits[shading[i].path], ray, {});
+          }
+        }
+      });
+
+      // one queue of shadow rays per light, each in hit order; when hits
+      // pick lights of their own, directLight() traces them instead
+      auto queues = everyLight ? lights.size() : 0;
+      shadows.resize(shading.size() * queues);
+      blocked.resize(shadows.size());
+      forChunks(pool, shading.size(), [&](size_t begin, size_t end) {
+        for (size_t l = 0; l < queues; l++) {
+          for (auto i = begin; i < end; i++) {
+            auto v = lights[l].getPosition() - comps[i].overPoint;
+            auto distance = magnitude(v);
+            shadows[l * shading.size() + i] = {comps[i].overPoint,
+                                               v / distance, distance};
+          }
+        }
+      });
+      forChunks(pool, shadows.size(), [&](size_t begin, size_t end) {
+        traceShadows(world, settings.packets, &shadows[begin], end - begin,
+                     &blocked[begin]);
+      });
+
+      colors.resize(shading.size());
+      bounces.resize(shading.size() * 2);
+      bounceCounts.resize(shading.size());
+      forChunks(pool, order.size(), [&](size_t begin, size_t end) {
+        thread_local std::vector<math::Point3D> points;
+        thread_local std::vector<math::RGBA> albedo;
+        thread_local std::vector<const Material *> materials;
+        thread_local ShadingBatch batch;
+        thread_local std::vector<math::RGBA> lit;
+        materials.clear();
+        batch.clear();
+        for (auto run = begin; run < end;) {
+          // a run of hits on one material has its pattern evaluated over
+          // all of their points in one call
+          const auto &material = *shading[order[run]].material;
+          auto runEnd = run + 1;
+          while (runEnd < end && shading[order[runEnd]].material == &material) {
+            runEnd++;
+          }
+          albedo.resize(runEnd - run);
+          if (material.getPattern()) {
+            points.resize(runEnd - run);
+            for (auto k = run; k < runEnd; k++) {
+              points[k - run] = comps[order[k]].objectPoint;
+            }
+            material.getPatternProgram().at(points.data(), points.size(),
+                                            albedo.data());
+          } else {
+            std::fill(albedo.begin(), albedo.end(), material.getColor());
+          }
+          auto index = static_cast<uint32_t>(materials.size());
+          materials.push_back(&material);
+          for (auto k = run; k < runEnd; k++) {
+            const auto &c = comps[order[k]];
+            batch.push(c.overPoint, c.normal, c.eye, albedo[k - run], index);
+          }
+          run = runEnd;
+        }
+
+        auto count = end - begin;
+        lit.resize(count);
+        if (everyLight) {
+          // every light against the whole chunk at once
+          batch.inShadow.resize(lights.size() * count);
+          for (size_t l = 0; l < lights.size(); l++) {
+            for (auto k = begin; k < end; k++) {
+              batch.inShadow[l * count + k - begin] =
+                  blocked[l * shading.size() + order[k]];
+            }
+          }
+          shadeBatch(batch, materials.data(), lights, lit.data());
+        } else {
+          for (size_t k = 0; k < count; k++) {
+            math::RGBA color(batch.color[0][k], batch.color[1][k],
+                             batch.color[2][k]);
+            lit[k] = world.directLight(comps[order[begin + k]], color);
+          }
+        }
+
+        for (auto k = begin; k < end; k++) {
+          auto i = order[k];
+          const auto &path = paths[shading[i].path];
+          colors[i] = lit[k - begin] * path.bounce.weight;
+          Bounce spawned[2];
+          bounceCounts[i] = static_cast<uint8_t>(
+              spawnBounces(comps[i], path.bounce, settings.bounces, spawned));
+          for (int b = 0; b < bounceCounts[i]; b++) {
+            bounces[2 * i + b] = {spawned[b], path.pixel};
+          }
+        }
+      });
+
+      // gather serially, in ray order, so the image does not depend on the
+      // thread count
+      for (size_t i = 0; i < shading.size(); i++) {
+        pixels[paths[shading[i].path].pixel] += colors[i];
+      }
+      paths.clear();
+      for (size_t i = 0; i < shading.size(); i++) {
+        for (int b = 0; b < bounceCounts[i]; b++) {
+          paths.push_back(bounces[2 * i + b]);
+        }
+      }
+    }
+
+    for (size_t i = 0; i < pixels.size(); i++) {
+      auto pixel = static_cast<int>(i);
+      image.writePixel(pixel % width, y0 + pixel / width, pixels[i]);
+    }
+  }
+}
+} // namespace raytracer
+} // namespace liby
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "render.hpp"
+#include "threadPool.hpp"
+
+namespace liby {
+namespace raytracer {
+/**
+ * @brief Renders into image breadth first. Camera rays are started for bands
+ * of about settings.waveSize pixels at a time and each wave runs as a chain of
+ * passes over flat queues: every ray is extended to its closest hit, the
+ * hits are binned by pattern type and material, shadow rays towards every
+ * light are queued and traced, each material's pattern is evaluated over
+ * its whole run of hits at once, shadeBatch() lights the hits in SIMD
+ * batches, and the reflection and refraction rays they spawn form the next
+ * wave.
+ * Each ray carries the weight its color is scaled by on the way back to the
+ * pixel, so nothing recurses.
+ *
+ * The result matches render() in RenderMode::Tiled up to rounding, since
+ * the bounces of a pixel are summed in a different order.
+ */
+void renderWavefront(const Camera &camera, const World &world,
+                     const RenderSettings &settings, ThreadPool &pool,
+                     Canvas &image);
+} // namespace raytracer
+} // namespace liby
@@ -0,0 +1,603 @@
+#include "world.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+namespace liby {
+namespace raytracer {
+namespace {
+const math::RGBA Black(0.0F, 0.0F, 0.0F);
+
+// uniform in [0, 1), hashed from the bits of ray
+float rouletteSample(const math::Ray &ray) {
+  const auto &o = ray.getOrigin();
+  const auto &d = ray.getDirection();
+  float values[6] = {o.x(), o.y(), o.z(), d.x(), d.y(), d.z()};
+  uint32_t h = 2166136261U;
+  for (auto value : values) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    h = (h ^ bits) * 16777619U;
+  }
+  h ^= h >> 16;
+  h *= 0x7feb352dU;
+  h ^= h >> 15;
+  h *= 0x846ca68bU;
+  h ^= h >> 16;
+  return static_cast<float>(h >> 8) * (1.0F / 16777216.0F);
+}
+} // namespace
+
+void World::addShape(std::unique_ptr<Shape> shape) {
+  shapes_.push_back(std::move(shape));
+  invalidateBVH();
+}
+
+void World::addLight(const PointLight &light) {
+  lights_.push_back(light);
+  lightTreeValid_.store(false, std::memory_order_release);
+}
+
+void World::addInstance(const Instance &instance) {
+  instances_.push_back(instance);
+  invalidateBVH();
+}
+
+const std::vector<std::unique_ptr<Shape>> &World::getShapes(void) const {
+  return shapes_;
+}
+
+const std::vector<PointLight> &World::getLights(void) const { return lights_; }
+
+const std::vector<Instance> &World::getInstances(void) const {
+  return instances_;
+}
+
+const BVH &World::getBVH(void) const {
+  buildBVH();
+  return bvh_;
+}
+
+const InstanceBVH &World::getInstanceBVH(void) const {
+  buildBVH();
+  return instanceBVH_;
+}
+
+void World::buildBVH(void) const {
+  if (bvhValid_.load(std::memory_order_acquire)) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(bvhMutex_);
+  if (!bvhValid_.load(std::memory_order_relaxed)) {
+    std::vector<const Shape *> shapes;
+    shapes.reserve(shapes_.size());
+    for (const auto &shape : shapes_) {
+      shapes.push_back(shape.get());
+    }
+    bvh_.build(shapes);
+    instanceBVH_.build(instances_);
+    bvhValid_.store(true, std::memory_order_release);
+  }
+}
+
+bool World::closestHit(const math::Ray &ray, float tMin, float tMax,
+                       Intersection *hit) const {
+  auto found = getBVH().closestHit(ray, tMin, tMax, hit);
+  if (found) {
+    tMax = hit->t;
+  }
+  return getInstanceBVH().closestHit(ray, tMin, tMax, hit) || found;
+}
+
+bool World::occluded(const math::Ray &ray, float tMin, float tMax) const {
+  return getBVH().occluded(ray, tMin, tMax) ||
+         getInstanceBVH().occluded(ray, tMin, tMax);
+}
+
+void World::invalidateBVH(void) {
+  bvhValid_.store(false, std::memory_order_release);
+}
+
+void World::setLightSettings(const LightSettings &settings) {
+  if (settings.samples < 1 || !(settings.clusterRatio >= 0.0F)) {
+    throw std::runtime_error("Invalid light settings");
+  }
+  lightSettings_ = settings;
+}
+
+const LightSettings &World::getLightSettings(void) const {
+  return lightSettings_;
+}
+
+const LightTree &World::getLightTree(void) const {
+  buildLightTree();
+  return lightTree_;
+}
+
+void World::buildLightTree(void) const {
+  if (lightTreeValid_.load(std::memory_order_acquire)) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(bvhMutex_);
+  if (!lightTreeValid_.load(std::memory_order_relaxed)) {
+    lightTree_.build(lights_);
+    lightTreeValid_.store(true, std::memory_order_release);
+  }
+}
+
+std::vector<Intersection> World::intersect(const math::Ray &ray) const {
+  std::vector<Intersection> xs;
+  intersect(ray, xs);
+  return xs;
+}
+
+void World::intersect(const math::Ray &ray,
+                      std::vector<Intersection> &xs) const {
+  xs.clear();
+  getBVH().intersectAll(ray, xs);
+  getInstanceBVH().intersectAll(ray, xs);
+  std::sort(xs.begin(), xs.end(),
+            [](const Intersection &a, const Intersection &b) {
+              return a.t < b.t;
+            });
+}
+
+bool World::isShadowed(const PointLight &light,
+                       const math::Point3D &point) const {
+  auto v = light.getPosition() - point;
+  auto distance = magnitude(v);
+  return occluded(math::Ray(point, v / distance), 0.0F, distance);
+}
+
+math::RGBA World::colorAt(const math::Ray &ray, int remaining) const {
+  BounceSettings settings;
+  settings.maxDepth = remaining;
+  return colorAt(ray, settings);
+}
+
+math::RGBA World::colorAt(const math::Ray &ray,
+                          const BounceSettings &settings) const {
+  Bounce first{ray, 1.0F, std::min(settings.maxDepth, MaxBounceDepth)};
+  return traceBounces(Black, &first, 1, settings);
+}
+
+bool World::prepareHit(const math::Ray &ray, Computations *comps) const {
+  Intersection closest;
+  if (!closestHit(ray, 0.0F, INFINITY, &closest)) {
+    return false;
+  }
+  if (materialOf(closest).getTransparency() > 0.0F) {
+    // refraction needs every hit along the ray to work out n1 and n2
+    thread_local std::vector<Intersection> xs;
+    intersect(ray, xs);
+    *comps = prepareRefraction(closest, ray, xs);
+    return true;
+  }
+  *comps = prepareComputations(closest, ray, {});
+  return true;
+}
+
+math::RGBA World::traceBounces(math::RGBA color, const Bounce *bounces,
+                               int count,
+                               const BounceSettings &settings) const {
+  // depth first: a bounce is replaced by at most two with one level less to
+  // go, so each level leaves at most one sibling waiting on the stack
+  Bounce stack[MaxBounceDepth + 2];
+  std::copy(bounces, bounces + count, stack);
+  auto size = count;
+  while (size > 0) {
+    auto bounce = stack[--size];
+    Computations comps;
+    if (!prepareHit(bounce.ray, &comps)) {
+      continue;
+    }
+    color += directLight(comps) * bounce.weight;
+    size += spawnBounces(comps, bounce, settings, stack + size);
+  }
+  return color;
+}
+
+template <typename FloatT>
+typename FloatT::Mask World::closestHit(const math::RayPacket<FloatT> &packet,
+                                        Intersection *hits) const {
+  auto found = getBVH().closestHit(packet, hits);
+  if (instances_.empty()) {
+    return found;
+  }
+  auto valid = packet.valid();
+  auto bits = 0;
+  for (int lane = 0; lane < FloatT::Width; lane++) {
+    if (!valid[lane]) {
+      continue;
+    }
+    auto tMax = found[lane] ? hits[lane].t : packet.tMax[lane];
+    math::Ray ray(packet.origin(lane), packet.direction(lane));
+    if (getInstanceBVH().closestHit(ray, packet.tMin[lane], tMax,
+                                    &hits[lane])) {
+      bits |= 1 << lane;
+    }
+  }
+  return found | math::lanesFromBits<FloatT>(bits);
+}
+
+template <typename FloatT>
+typename FloatT::Mask
+World::occluded(const math::RayPacket<FloatT> &packet) const {
+  auto blocked = getBVH().occluded(packet);
+  if (instances_.empty()) {
+    return blocked;
+  }
+  auto open = andNot(packet.valid(), blocked);
+  auto bits = 0;
+  for (int lane = 0; lane < FloatT::Width; lane++) {
+    if (!open[lane]) {
+      continue;
+    }
+    math::Ray ray(packet.origin(lane), packet.direction(lane));
+    if (getInstanceBVH().occluded(ray, packet.tMin[lane],
+                                  packet.tMax[lane])) {
+      bits |= 1 << lane;
+    }
+  }
+  return blocked | math::lanesFromBits<FloatT>(bits);
+}
+
+template <typename FloatT>
+void World::colorAt(const math::RayPacket<FloatT> &packet,
+                    const BounceSettings &settings,
+                    math::RGBA *colors) const {
+  constexpr int Width = FloatT::Width;
+  Intersection hits[Width];
+  auto found = closestHit(packet, hits);
+  auto valid = packet.valid();
+
+  Computations comps[Width];
+  math::RGBA surface[Width];
+  auto shaded = 0;
+  for (int lane = 0; lane < Width; lane++) {
+    if (!valid[lane]) {
+      continue;
+    }
+    if (!found[lane]) {
+      colors[lane] = Black;
+      continue;
+    }
+    math::Ray ray(packet.origin(lane), packet.direction(lane));
+    if (materialOf(hits[lane]).getTransparency() > 0.0F) {
+      // refraction needs every hit along the ray; leave it to colorAt()
+      colors[lane] = colorAt(ray, settings);
+      continue;
+    }
+    comps[lane] = prepareComputations(hits[lane], ray, {});
+    surface[lane] = Black;
+    shaded |= 1 << lane;
+  }
+  if (shaded == 0) {
+    return;
+  }
+
+  if (lightSettings_.mode != LightSampling::All) {
+    // every hit picks lights of its own, so shadow rays go one at a time
+    for (int lane = 0; lane < Width; lane++) {
+      if ((shaded >> lane) & 1) {
+        surface[lane] = directLight(comps[lane]);
+      }
+    }
+  } else {
+    // shadow rays from neighbouring hits to one light are about as
+    // coherent as the camera rays were; unshaded lanes get an empty range
+    for (const auto &light : lights_) {
+      math::Point3D origins[Width];
+      math::Vector3D directions[Width];
+      alignas(32) float tMin[Width];
+      alignas(32) float tMax[Width];
+      for (int lane = 0; lane < Width; lane++) {
+        if ((shaded >> lane) & 1) {
+          auto v = light.getPosition() - comps[lane].overPoint;
+          auto distance = magnitude(v);
+          origins[lane] = comps[lane].overPoint;
+          directions[lane] = v / distance;
+          tMin[lane] = 0.0F;
+          tMax[lane] = distance;
+        } else {
+          origins[lane] = math::Point3D(0.0F, 0.0F, 0.0F);
+          directions[lane] = math::Vector3D(0.0F, 1.0F, 0.0F);
+          tMin[lane] = 1.0F;
+          tMax[lane] = 0.0F;
+        }
+      }
+      auto shadow =
+          math::RayPacket<FloatT>::fromRays(origins, directions, Width);
+      shadow.tMin = FloatT::load(tMin);
+      shadow.tMax = FloatT::load(tMax);
+      auto blocked = occluded(shadow);
+      for (int lane = 0; lane < Width; lane++) {
+        if ((shaded >> lane) & 1) {
+          const auto &c = comps[lane];
+          surface[lane] +=
+              lighting(*c.material, c.material->colorAt(c.objectPoint), light,
+                       c.overPoint, c.eye, c.normal, blocked[lane]);
+        }
+      }
+    }
+  }
+
+  Bounce first{math::Ray(), 1.0F,
+               std::min(settings.maxDepth, MaxBounceDepth)};
+  for (int lane = 0; lane < Width; lane++) {
+    if ((shaded >> lane) & 1) {
+      Bounce bounces[2];
+      auto count = spawnBounces(comps[lane], first, settings, bounces);
+      colors[lane] = traceBounces(surface[lane], bounces, count, settings);
+    }
+  }
+}
+
+template math::simd::Mask4
+World::closestHit(const math::RayPacket4 &, Intersection *) const;
+template math::simd::Mask8
+World::closestHit(const math::RayPacket8 &, Intersection *) const;
+template math::simd::Mask4 World::occluded(const math::RayPacket4 &) const;
+template math::simd::Mask8 World::occluded(const math::RayPacket8 &) const;
+template void World::colorAt(const math::RayPacket4 &,
+                             const BounceSettings &, math::RGBA *) const;
+template void World::colorAt(const math::RayPacket8 &,
+                             const BounceSettings &, math::RGBA *) const;
+
+math::RGBA World::shadeHit(const Computations &comps, int remaining) const {
+  BounceSettings settings;
+  settings.maxDepth = std::min(remaining, MaxBounceDepth);
+  Bounce from{math::Ray(), 1.0F, settings.maxDepth};
+  Bounce bounces[2];
+  auto count = spawnBounces(comps, from, settings, bounces);
+  return traceBounces(directLight(comps), bounces, count, settings);
+}
+
+math::RGBA World::directLight(const Computations &comps) const {
+  return directLight(comps, comps.material->colorAt(comps.objectPoint));
+}
+
+math::RGBA World::directLight(const Computations &comps,
+                              const math::RGBA &color) const {
+  const auto &material = *comps.material;
+  auto surface = Black;
+  if (lightSettings_.mode == LightSampling::All) {
+    for (const auto &light : lights_) {
+      surface += lighting(material, color, light, comps.overPoint, comps.eye,
+                          comps.normal, isShadowed(light, comps.overPoint));
+    }
+    return surface;
+  }
+  if (lights_.empty()) {
+    return surface;
+  }
+
+  // ambient does not depend on where a light is, so all of it is added at
+  // once from the summed intensity
+  PointLight total(comps.overPoint, getLightTree().getIntensity());
+  surface += lighting(material, color, total, comps.overPoint, comps.eye,
+                      comps.normal, true);
+  thread_local std::vector<LightSample> samples;
+  selectLights(comps, samples);
+  for (const auto &sample : samples) {
+    if (isShadowed(sample.light, comps.overPoint)) {
+      continue;
+    }
+    auto lit = lighting(material, color, sample.light, comps.overPoint,
+                        comps.eye, comps.normal, false);
+    auto ambient = lighting(material, color, sample.light, comps.overPoint,
+                            comps.eye, comps.normal, true);
+    surface += (lit - ambient) * sample.weight;
+  }
+  return surface;
+}
+
+void World::selectLights(const Computations &comps,
+                         std::vector<LightSample> &samples) const {
+  samples.clear();
+  const auto &tree = getLightTree();
+  if (lightSettings_.mode == LightSampling::Clustered) {
+    tree.cluster(comps.overPoint, comps.normal, lightSettings_.clusterRatio,
+                 samples);
+    return;
+  }
+  // stratified over [0, 1) from one hashed offset, so a hit draws the same
+  // lights whichever thread shades it
+  auto count = lightSettings_.samples;
+  auto offset = rouletteSample(math::Ray(comps.overPoint, comps.eye));
+  for (int s = 0; s < count; s++) {
+    auto u = (static_cast<float>(s) + offset) / static_cast<float>(count);
+    float pmf;
+    auto index = tree.sample(comps.overPoint, comps.normal, u, &pmf);
+    // a sample that finds no light adds nothing; the others keep their
+    // weights, so the estimate stays unbiased
+    if (index < 0) {
+      continue;
+    }
+    samples.push_back(
+        {lights_[index], 1.0F / (pmf * static_cast<float>(count))});
+  }
+}
+
+math::RGBA World::reflectedColor(const Computations &comps,
+                                 int remaining) const {
+  auto reflective = comps.material->getReflective();
+  if (remaining <= 0 || reflective == 0.0F) {
+    return Black;
+  }
+  return colorAt(math::Ray(comps.overPoint, comps.reflect), remaining - 1) *
+         reflective;
+}
+
+math::RGBA World::refractedColor(const Computations &comps,
+                                 int remaining) const {
+  auto transparency = comps.material->getTransparency();
+  if (remaining <= 0 || transparency == 0.0F) {
+    return Black;
+  }
+
+  math::Ray ray;
+  if (!refractedRay(comps, &ray)) {
+    return Black;
+  }
+  return colorAt(ray, remaining - 1) * transparency;
+}
+
+const Intersection *hit(const std::vector<Intersection> &xs) {
+  for (const auto &x : xs) {
+    if (x.t >= 0.0F) {
+      return &x;
+    }
+  }
+  return nullptr;
+}
+
+const Material &materialOf(const Intersection &x) {
+  if (x.instance && x.instance->getMaterial()) {
+    return *x.instance->getMaterial();
+  }
+  return x.object->getMaterial();
+}
+
+Computations prepareComputations(const Intersection &hit, const math::Ray &ray,
+                                 const std::vector<Intersection> &xs) {
+  Computations comps;
+  comps.t = hit.t;
+  comps.object = hit.object;
+  comps.instance = hit.instance;
+  comps.material = &materialOf(hit);
+  comps.point = ray.position(hit.t);
+  const auto direction = ray.getDirection();
+  comps.eye = -direction;
+  if (hit.instance) {
+    auto local = hit.instance->getInverse() * comps.point;
+    comps.normal = hit.instance->normalToWorld(hit.object->normal(local));
+  } else {
+    comps.normal = hit.object->normal(comps.point);
+  }
+  comps.inside = dot(comps.normal, comps.eye) < 0.0F;
+  if (comps.inside) {
+    comps.normal = comps.normal * -1.0F;
+  }
+  comps.reflect = reflect(direction, comps.normal);
+  comps.overPoint = comps.point + comps.normal * Epsilon;
+  comps.underPoint = comps.point - comps.normal * Epsilon;
+  auto prototypePoint = hit.instance
+                            ? hit.instance->getInverse() * comps.overPoint
+                            : comps.overPoint;
+  comps.objectPoint = hit.object->getInverse() * prototypePoint;
+
+  // walk the sorted hits keeping track of which objects the ray is inside,
+  // so n1 and n2 are the indices of the media on either side of the hit
+  comps.n1 = 1.0F;
+  comps.n2 = 1.0F;
+  // the same shape placed by two instances is two different objects
+  std::vector<const Intersection *> containers;
+  auto same = [](const Intersection *a, const Intersection &b) {
+    return a->object == b.object && a->instance == b.instance;
+  };
+  for (const auto &x : xs) {
+    auto isHit = &x == &hit;
+    if (isHit && !containers.empty()) {
+      comps.n1 = materialOf(*containers.back()).getRefractiveIndex();
+    }
+    auto it = std::find_if(
+        containers.begin(), containers.end(),
+        [&](const Intersection *c) { return same(c, x); });
+    if (it != containers.end()) {
+      containers.erase(it);
+    } else {
+      containers.push_back(&x);
+    }
+    if (isHit) {
+      if (!containers.empty()) {
+        comps.n2 = materialOf(*containers.back()).getRefractiveIndex();
+      }
+      break;
+    }
+  }
+  return comps;
+}
+
+Computations prepareRefraction(const Intersection &closest,
+                               const math::Ray &ray,
+                               const std::vector<Intersection> &xs) {
+  const auto *first = hit(xs);
+  if (!first || first->object != closest.object ||
+      first->instance != closest.instance) {
+    return prepareComputations(closest, ray, {});
+  }
+  return prepareComputations(*first, ray, xs);
+}
+
+float schlick(const Computations &comps) {
+  auto cosine = dot(comps.eye, comps.normal);
+  if (comps.n1 > comps.n2) {
+    auto ratio = comps.n1 / comps.n2;
+    auto sin2T = ratio * ratio * (1.0F - cosine * cosine);
+    if (sin2T > 1.0F) {
+      return 1.0F;
+    }
+    // use cos(theta_t) when going from the denser medium
+    cosine = std::sqrt(1.0F - sin2T);
+  }
+  auto r0 = (comps.n1 - comps.n2) / (comps.n1 + comps.n2);
+  r0 = r0 * r0;
+  return r0 + (1.0F - r0) * std::pow(1.0F - cosine, 5.0F);
+}
+
+bool refractedRay(const Computations &comps, math::Ray *ray) {
+  auto ratio = comps.n1 / comps.n2;
+  auto cosI = dot(comps.eye, comps.normal);
+  auto sin2T = ratio * ratio * (1.0F - cosI * cosI);
+  if (sin2T > 1.0F) {
+    return false;
+  }
+  auto cosT = std::sqrt(1.0F - sin2T);
+  auto direction = comps.normal * (ratio * cosI - cosT) - comps.eye * ratio;
+  *ray = math::Ray(comps.underPoint, direction);
+  return true;
+}
+
+int spawnBounces(const Computations &comps, const Bounce &from,
+                 const BounceSettings &settings, Bounce *bounces) {
+  if (from.remaining <= 0) {
+    return 0;
+  }
+  auto reflective = comps.material->getReflective();
+  auto transparency = comps.material->getTransparency();
+  auto reflectWeight = reflective;
+  auto refractWeight = transparency;
+  if (reflective > 0.0F && transparency > 0.0F) {
+    auto reflectance = schlick(comps);
+    reflectWeight *= reflectance;
+    refractWeight *= 1.0F - reflectance;
+  }
+
+  auto count = 0;
+  auto spawn = [&](const math::Ray &ray, float weight) {
+    weight *= from.weight;
+    if (weight < settings.minWeight) {
+      return;
+    }
+    if (weight < settings.rouletteWeight) {
+      if (rouletteSample(ray) * settings.rouletteWeight >= weight) {
+        return;
+      }
+      weight = settings.rouletteWeight;
+    }
+    bounces[count++] = {ray, weight, from.remaining - 1};
+  };
+  if (reflective != 0.0F) {
+    spawn(math::Ray(comps.overPoint, comps.reflect), reflectWeight);
+  }
+  math::Ray refracted;
+  if (transparency != 0.0F && refractedRay(comps, &refracted)) {
+    spawn(refracted, refractWeight);
+  }
+  return count;
+}
+} // namespace raytracer
+} // namespace liby
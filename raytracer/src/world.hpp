@@ -0,0 +1,282 @@
+#pragma once
+
+#include "bvh.hpp"
+#include "instance.hpp"
+#include "light.hpp"
+#include "lightTree.hpp"
+#include "ray.hpp"
+#include "rayPacket.hpp"
+#include "rgba.hpp"
+#include "shape.hpp"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace liby {
+namespace raytracer {
+struct Intersection {
+  float t;
+  const Shape *object;
+  // set when object was reached through an instance; object's transform
+  // then maps to the instance's prototype space rather than to world space
+  const Instance *instance = nullptr;
+};
+
+/**
+ * @brief Everything shading needs to know about a hit, computed once.
+ * overPoint and underPoint are nudged off the surface along the normal so
+ * that shadow and refraction rays do not hit the surface they start on.
+ * objectPoint is overPoint taken back through the instance's and the
+ * shape's transforms, where the shape's pattern is laid out, so patterns
+ * move with their shapes.
+ */
+struct Computations {
+  float t;
+  const Shape *object;
+  const Instance *instance;
+  const Material *material;
+  math::Point3D point;
+  math::Point3D overPoint;
+  math::Point3D underPoint;
+  math::Point3D objectPoint;
+  math::Vector3D eye;
+  math::Vector3D normal;
+  math::Vector3D reflect;
+  bool inside;
+  float n1;
+  float n2;
+};
+
+// deepest bounce chain a BounceSettings may ask for
+constexpr int MaxBounceDepth = 32;
+
+/**
+ * @brief How far reflection and refraction are followed. The weight of a
+ * bounce is the factor its color is scaled by on the way back to the pixel.
+ */
+struct BounceSettings {
+  // reflection and refraction bounces per camera ray, up to MaxBounceDepth
+  int maxDepth = 5;
+  // bounces weighing less than this are dropped
+  float minWeight = 0.0F;
+  // bounces weighing less than this are kept with probability
+  // weight / rouletteWeight and then weigh rouletteWeight, which culls
+  // faint chains without darkening the image on average; zero turns this
+  // Russian roulette off
+  float rouletteWeight = 0.0F;
+};
+
+/**
+ * @brief Ray still to be traced, with its weight and the number of bounces
+ * it may still take.
+ */
+struct Bounce {
+  math::Ray ray;
+  float weight;
+  int remaining;
+};
+
+class World {
+public:
+  World() = default;
+
+  void addShape(std::unique_ptr<Shape> shape);
+  void addLight(const PointLight &light);
+
+  /**
+   * @brief Places a copy of a prototype. Any number of instances can share
+   * the same prototype and override material.
+   */
+  void addInstance(const Instance &instance);
+  const std::vector<std::unique_ptr<Shape>> &getShapes(void) const;
+  const std::vector<PointLight> &getLights(void) const;
+  const std::vector<Instance> &getInstances(void) const;
+
+  /**
+   * @brief Returns the hierarchy over the world's own shapes, building it
+   * and the one over instances on first use. Shapes or instances that are
+   * moved after that need invalidateBVH().
+   */
+  const BVH &getBVH(void) const;
+  const InstanceBVH &getInstanceBVH(void) const;
+  void invalidateBVH(void);
+
+  /**
+   * @brief How hits are lit when there are many lights. The default lights
+   * every hit with every light.
+   */
+  void setLightSettings(const LightSettings &settings);
+  const LightSettings &getLightSettings(void) const;
+
+  /**
+   * @brief Returns the hierarchy over the world's lights, building it on
+   * first use; addLight() rebuilds it.
+   */
+  const LightTree &getLightTree(void) const;
+
+  /**
+   * @brief Returns every intersection of ray with the world, sorted by t.
+   */
+  std::vector<Intersection> intersect(const math::Ray &ray) const;
+
+  /**
+   * @brief Replaces the contents of xs with every intersection of ray,
+   * sorted by t. Reusing xs across calls avoids allocating per ray.
+   */
+  void intersect(const math::Ray &ray, std::vector<Intersection> &xs) const;
+
+  /**
+   * @brief Finds the closest intersection with t in [tMin, tMax) without
+   * allocating. Returns false, leaving hit alone, if nothing was hit.
+   */
+  bool closestHit(const math::Ray &ray, float tMin, float tMax,
+                  Intersection *hit) const;
+
+  /**
+   * @brief Returns true if anything blocks ray with t in [tMin, tMax),
+   * stopping at the first blocker found rather than the closest one.
+   */
+  bool occluded(const math::Ray &ray, float tMin, float tMax) const;
+
+  /**
+   * @brief Packet forms of closestHit() and occluded(), see BVH. Instances
+   * are searched lane by lane since each maps the rays into its own space.
+   */
+  template <typename FloatT>
+  typename FloatT::Mask closestHit(const math::RayPacket<FloatT> &packet,
+                                   Intersection *hits) const;
+  template <typename FloatT>
+  typename FloatT::Mask occluded(const math::RayPacket<FloatT> &packet) const;
+  bool isShadowed(const PointLight &light, const math::Point3D &point) const;
+
+  /**
+   * @brief Returns the color seen along ray. remaining bounds the number of
+   * reflection and refraction bounces still allowed.
+   */
+  math::RGBA colorAt(const math::Ray &ray, int remaining) const;
+
+  /**
+   * @brief Returns the color seen along ray, following bounces as settings
+   * allows. Bounces are traced depth first from a fixed-size stack rather
+   * than by recursion, so the call depth does not grow with maxDepth.
+   */
+  math::RGBA colorAt(const math::Ray &ray,
+                     const BounceSettings &settings) const;
+
+  /**
+   * @brief Writes colorAt() of every valid lane of packet to colors[lane].
+   * The packet is traced together, and so are the shadow rays from its hits
+   * towards each light under LightSampling::All; bounces are then followed
+   * one ray at a time.
+   */
+  template <typename FloatT>
+  void colorAt(const math::RayPacket<FloatT> &packet,
+               const BounceSettings &settings, math::RGBA *colors) const;
+  math::RGBA shadeHit(const Computations &comps, int remaining) const;
+
+  /**
+   * @brief Returns the direct lighting at the hit with color as the surface
+   * color, tracing a shadow ray towards every light the light settings
+   * pick. Except in LightSampling::All, the ambient term of all lights is
+   * added in one go and only the picked lights add diffuse and specular.
+   */
+  math::RGBA directLight(const Computations &comps,
+                         const math::RGBA &color) const;
+  math::RGBA reflectedColor(const Computations &comps, int remaining) const;
+  math::RGBA refractedColor(const Computations &comps, int remaining) const;
+
+private:
+  void buildBVH(void) const;
+  void buildLightTree(void) const;
+
+  /**
+   * @brief Finds what ray hits first and prepares it for shading. Returns
+   * false if ray hits nothing.
+   */
+  bool prepareHit(const math::Ray &ray, Computations *comps) const;
+
+  /**
+   * @brief directLight() with the material's own color at the hit.
+   */
+  math::RGBA directLight(const Computations &comps) const;
+
+  /**
+   * @brief Replaces the contents of samples with the lights that stand in
+   * for all of them at the hit under LightSampling::Sampled or Clustered.
+   */
+  void selectLights(const Computations &comps,
+                    std::vector<LightSample> &samples) const;
+
+  /**
+   * @brief Adds to color the direct lighting seen along each of the count
+   * bounces, and along every bounce they spawn in turn, each scaled by its
+   * weight.
+   */
+  math::RGBA traceBounces(math::RGBA color, const Bounce *bounces, int count,
+                          const BounceSettings &settings) const;
+
+  std::vector<std::unique_ptr<Shape>> shapes_;
+  std::vector<PointLight> lights_;
+  std::vector<Instance> instances_;
+  mutable BVH bvh_;
+  mutable InstanceBVH instanceBVH_;
+  mutable std::atomic<bool> bvhValid_{false};
+  mutable std::mutex bvhMutex_;
+  LightSettings lightSettings_;
+  mutable LightTree lightTree_;
+  mutable std::atomic<bool> lightTreeValid_{false};
+};
+
+/**
+ * @brief Returns the closest intersection in front of the ray origin, or
+ * nullptr. xs must be sorted by t.
+ */
+const Intersection *hit(const std::vector<Intersection> &xs);
+
+/**
+ * @brief Returns the material that applies at x: the instance's override if
+ * it has one, the shape's own material otherwise.
+ */
+const Material &materialOf(const Intersection &x);
+
+/**
+ * @brief Prepares shading data for hit. xs is the full sorted list the hit
+ * came from and is used to find the refractive indices on both sides.
+ */
+Computations prepareComputations(const Intersection &hit, const math::Ray &ray,
+                                 const std::vector<Intersection> &xs);
+
+/**
+ * @brief Prepares shading data for closest, the hit closestHit() found, with
+ * xs the ray's full sorted intersect() list for the refractive indices.
+ * When the first hit in xs is missing or on another object or instance, as
+ * when the two searches round differently, closest is shaded on its own.
+ */
+Computations prepareRefraction(const Intersection &closest,
+                               const math::Ray &ray,
+                               const std::vector<Intersection> &xs);
+
+/**
+ * @brief Schlick's approximation of the Fresnel reflectance at the hit.
+ */
+float schlick(const Computations &comps);
+
+/**
+ * @brief Sets ray to the ray refracted into the surface at the hit, by
+ * Snell's law. Returns false under total internal reflection.
+ */
+bool refractedRay(const Computations &comps, math::Ray *ray);
+
+/**
+ * @brief Writes the reflection and refraction rays leaving the hit to
+ * bounces, at most two, and returns how many there are. Each weighs from's
+ * weight times the material's reflectivity or transparency, split by
+ * schlick() when the material has both. Bounces are cut as settings asks;
+ * the roulette draw is a hash of the bounce ray, so the image does not
+ * depend on thread count or order.
+ */
+int spawnBounces(const Computations &comps, const Bounce &from,
+                 const BounceSettings &settings, Bounce *bounces);
+} // namespace raytracer
+} // namespace liby